@@ -0,0 +1,114 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "cdk_error.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+#define NOINLINE __attribute__((noinline))
+
+#define ROUNDS 20000
+#define BATCH 16
+#define DUMP_ROUNDS 2000
+
+#ifdef CDK_ERROR_BTRACE_FP
+#define BENCH_BUILD "frame pointers, CDK_ERROR_BTRACE_FP"
+#define BENCH_FP CDK_ERROR_BTRACE_FP
+#else
+#define BENCH_BUILD "default"
+#define BENCH_FP 0
+#endif
+
+/*
+ * An error raised at the bottom of a call chain of `depth` functions and
+ * passed up to the top. In `plain` no function wraps, so only a native
+ * backtrace records the chain; in `wrap` every level adds a manual frame.
+ * Build with and without CDK_ERROR_BTRACE_FP to compare a native backtrace
+ * with manual wraps of equal depth. `dump` is the time of cdk_error_dumps of
+ * the wrapped error, where native addresses are symbolized.
+ */
+static NOINLINE int plain(int depth) {
+  if (depth <= 1) {
+    cdk_errno = cdk_errnoi(EIO);
+    return -1;
+  }
+  if (plain(depth - 1)) {
+    return -1;
+  }
+  return 0;
+}
+
+static NOINLINE int wrap(int depth) {
+  if (depth <= 1) {
+    cdk_errno = cdk_errnoi(EIO);
+    return -1;
+  }
+  if (wrap(depth - 1)) {
+    return cdk_ereturn(-1);
+  }
+  return 0;
+}
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static double best_ns(int (*call)(int), int depth) {
+  uint64_t best = UINT64_MAX;
+  int sink = 0;
+
+  for (int r = 0; r < ROUNDS; r++) {
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BATCH; i++) {
+      sink += call(depth);
+    }
+    uint64_t dt = now_ns() - t0;
+    best = dt < best ? dt : best;
+  }
+
+  if (sink == 42) {
+    puts("");
+  }
+  return (double)best / BATCH;
+}
+
+static double dump_ns(int depth) {
+  static char buf[8192];
+  uint64_t best = UINT64_MAX;
+
+  wrap(depth);
+  for (int r = 0; r < DUMP_ROUNDS; r++) {
+    uint64_t t0 = now_ns();
+    cdk_edumps(sizeof(buf), buf);
+    uint64_t dt = now_ns() - t0;
+    best = dt < best ? dt : best;
+  }
+  return (double)best;
+}
+
+int main(void) {
+  static const int depths[] = {1, 4, 8, 16};
+
+  printf("build: %s=%d CDK_ERROR_BTRACE_MAX=%d\n", BENCH_BUILD, BENCH_FP,
+         CDK_ERROR_BTRACE_MAX);
+  printf("%5s %8s %8s %8s %10s\n", "depth", "plain", "wrap", "frames",
+         "dump");
+
+  for (size_t i = 0; i < sizeof(depths) / sizeof(*depths); i++) {
+    int depth = depths[i];
+    double plain_ns = best_ns(plain, depth);
+    double wrap_ns = best_ns(wrap, depth);
+    int frames = cdk_errno->eframes_len;
+
+    printf("%5d %8.1f %8.1f %8d %10.0f\n", depth, plain_ns, wrap_ns, frames,
+           dump_ns(depth));
+  }
+
+  return 0;
+}
@@ -0,0 +1,120 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "cdk_error.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+#define NOINLINE __attribute__((noinline))
+
+#define ROUNDS 200000
+#define BATCH 16
+
+/*
+ * Handing an error to a task resumed on another thread: the error is copied
+ * out on the old worker and into the errno slot on the new one. Both ways are
+ * timed as one operation, against the same round trip through a full struct
+ * copy.
+ */
+static _Alignas(64) unsigned char snap_buf[CDK_ESNAPSHOT_MAX];
+static struct cdk_ESnapshot *snap = (struct cdk_ESnapshot *)snap_buf;
+static struct cdk_Error full_copy;
+static struct cdk_Error target;
+
+enum Kind {
+  KIND_INT,
+  KIND_FSTR,
+  KIND_DFSTR,
+};
+
+static const char *kind_names[] = {"int", "fstr", "dfstr"};
+
+static NOINLINE void raise_kind(enum Kind kind, int depth) {
+  switch (kind) {
+  case KIND_INT:
+    cdk_errno = cdk_errnoi(ECONNRESET);
+    break;
+#ifndef CDK_ERROR_OPTIMIZE
+  case KIND_FSTR:
+    cdk_errno = cdk_errnof(ECONNRESET, "Peer %s:%d reset", "10.0.0.1", 443);
+    break;
+  case KIND_DFSTR:
+    cdk_errno = cdk_errnod(ECONNRESET, "Peer %s:%d reset", "10.0.0.1", 443);
+    break;
+#endif
+  default:
+    cdk_errno = cdk_errnoi(ECONNRESET);
+  }
+  for (int i = 1; i < depth; i++) {
+    cdk_ewrap();
+  }
+}
+
+static NOINLINE void handoff_memcpy(void) {
+  memcpy(&full_copy, &cdk_hidden_errno, sizeof(full_copy));
+  memcpy(&target, &full_copy, sizeof(target));
+#ifndef CDK_ERROR_OPTIMIZE
+  if (target.type == cdk_ErrorType_FSTR) {
+    target.msg = target._msg_buf;
+  }
+#endif
+}
+
+static NOINLINE void handoff_snapshot(void) {
+  cdk_error_capture(&cdk_hidden_errno, sizeof(snap_buf), snap);
+  cdk_error_restore(&target, snap);
+}
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static double best_ns(void (*handoff)(void)) {
+  uint64_t best = UINT64_MAX;
+
+  for (int r = 0; r < ROUNDS; r++) {
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BATCH; i++) {
+      handoff();
+    }
+    uint64_t dt = now_ns() - t0;
+    best = dt < best ? dt : best;
+  }
+
+  return (double)best / BATCH;
+}
+
+int main(void) {
+  static const int depths[] = {1, 5, CDK_ERROR_BTRACE_MAX};
+
+  printf("config: CDK_ERROR_BTRACE_MAX=%d CDK_ERROR_FSTR_MAX=%d "
+         "sizeof(struct cdk_Error)=%zu\n",
+         CDK_ERROR_BTRACE_MAX, CDK_ERROR_FSTR_MAX, sizeof(struct cdk_Error));
+  printf("%-6s %6s %10s %12s %12s\n", "type", "depth", "snap B",
+         "memcpy ns", "snapshot ns");
+
+  for (int k = KIND_INT; k <= KIND_DFSTR; k++) {
+#ifdef CDK_ERROR_OPTIMIZE
+    if (k != KIND_INT) {
+      continue;
+    }
+#endif
+    for (size_t d = 0; d < sizeof(depths) / sizeof(*depths); d++) {
+      size_t size;
+
+      raise_kind(k, depths[d]);
+      size = cdk_error_capture(&cdk_hidden_errno, sizeof(snap_buf), snap);
+      printf("%-6s %6d %10zu %12.1f %12.1f\n", kind_names[k], depths[d], size,
+             best_ns(handoff_memcpy), best_ns(handoff_snapshot));
+    }
+  }
+
+  return 0;
+}
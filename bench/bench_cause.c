@@ -0,0 +1,121 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "cdk_error.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+#define NOINLINE __attribute__((noinline))
+
+#define ROUNDS 200000
+#define BATCH 16
+
+/*
+ * A storage layer fails with ENOENT and the service layer reports EIO. The
+ * service either raises a fresh error, losing the storage trace, or translates
+ * the storage error, keeping it as a cause. The storage error is raised again
+ * before each service step, its cost is measured alone and subtracted.
+ */
+enum Kind {
+  KIND_INT,
+  KIND_STR,
+  KIND_FSTR,
+};
+
+static const char *kind_names[] = {"int", "str", "fstr"};
+
+static NOINLINE void storage_fail(enum Kind kind) {
+  switch (kind) {
+  case KIND_STR:
+    cdk_errno = cdk_errnos(ENOENT, "Block not found");
+    break;
+#ifndef CDK_ERROR_OPTIMIZE
+  case KIND_FSTR:
+    cdk_errno = cdk_errnof(ENOENT, "Block %d of %s not found", 42, "disk0");
+    break;
+#endif
+  default:
+    cdk_errno = cdk_errnoi(ENOENT);
+  }
+  cdk_ewrap();
+}
+
+static NOINLINE void service_raise(enum Kind kind) {
+  switch (kind) {
+  case KIND_STR:
+    cdk_errno = cdk_errnos(EIO, "Read failed");
+    break;
+#ifndef CDK_ERROR_OPTIMIZE
+  case KIND_FSTR:
+    cdk_errno = cdk_errnof(EIO, "Read of %s failed", "disk0");
+    break;
+#endif
+  default:
+    cdk_errno = cdk_errnoi(EIO);
+  }
+}
+
+static NOINLINE void service_translate(enum Kind kind) {
+  switch (kind) {
+  case KIND_STR:
+    cdk_ewraps(EIO, "Read failed");
+    break;
+#ifndef CDK_ERROR_OPTIMIZE
+  case KIND_FSTR:
+    cdk_ewrapf(EIO, "Read of %s failed", "disk0");
+    break;
+#endif
+  default:
+    cdk_ewrapi(EIO);
+  }
+}
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static NOINLINE void service_none(enum Kind kind) { (void)kind; }
+
+static double best_ns(void (*service)(enum Kind), enum Kind kind) {
+  uint64_t best = UINT64_MAX;
+
+  for (int r = 0; r < ROUNDS; r++) {
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BATCH; i++) {
+      storage_fail(kind);
+      service(kind);
+    }
+    uint64_t dt = now_ns() - t0;
+    best = dt < best ? dt : best;
+  }
+
+  return (double)best / BATCH;
+}
+
+int main(void) {
+  printf("config: CDK_ECAUSE_MAX=%d CDK_ECAUSE_BUF=%d "
+         "sizeof(struct cdk_Error)=%zu\n",
+         CDK_ECAUSE_MAX, CDK_ECAUSE_BUF, sizeof(struct cdk_Error));
+  printf("%-6s %10s %14s\n", "type", "raise ns", "translate ns");
+
+  for (int k = KIND_INT; k <= KIND_FSTR; k++) {
+#ifdef CDK_ERROR_OPTIMIZE
+    if (k == KIND_FSTR) {
+      continue;
+    }
+#endif
+    double base = best_ns(service_none, k);
+
+    printf("%-6s %10.1f %14.1f\n", kind_names[k],
+           best_ns(service_raise, k) - base,
+           best_ns(service_translate, k) - base);
+  }
+
+  return 0;
+}
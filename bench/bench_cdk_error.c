@@ -0,0 +1,499 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "cdk_error.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+#define NOINLINE __attribute__((noinline))
+
+// Operations timed together, amortizes clock overhead
+#define BATCH 64
+#define WARMUP 1000
+#define LIST_MAX 16
+#define THREADS_MAX 128
+
+/******************************************************************************
+ *                                 Scenarios                                  *
+ ******************************************************************************/
+enum Type {
+  TYPE_RET, // plain int return, the baseline
+  TYPE_INT,
+  TYPE_STR,
+  TYPE_FSTR,
+  TYPE_DFSTR,
+  TYPE_MAX,
+};
+
+static const char *type_names[TYPE_MAX] = {"ret", "int", "str", "fstr",
+                                           "dfstr"};
+
+static NOINLINE int raise_type(enum Type type) {
+  switch (type) {
+  case TYPE_RET:
+    return -EINVAL;
+  case TYPE_INT:
+    cdk_errno = cdk_errnoi(EINVAL);
+    break;
+  case TYPE_STR:
+    cdk_errno = cdk_errnos(EINVAL, "Invalid argument");
+    break;
+#ifndef CDK_ERROR_OPTIMIZE
+  case TYPE_FSTR:
+    cdk_errno = cdk_errnof(EINVAL, "Invalid argument %d of %s", 3, "open");
+    break;
+  case TYPE_DFSTR:
+    cdk_errno = cdk_errnod(EINVAL, "Invalid argument %d of %s", 3, "open");
+    break;
+#endif
+  default:
+    break;
+  }
+
+  return -1;
+}
+
+// Error raised `depth` calls down, wrapped on the way up
+static NOINLINE int trace(enum Type type, int depth) {
+  int ret;
+
+  if (depth <= 1) {
+    return raise_type(type);
+  }
+
+  ret = trace(type, depth - 1);
+  if (ret < 0) {
+    return type == TYPE_RET ? ret : cdk_ereturn(ret);
+  }
+
+  return ret;
+}
+
+static int type_supported(enum Type type) {
+#ifdef CDK_ERROR_OPTIMIZE
+  return type != TYPE_FSTR && type != TYPE_DFSTR;
+#else
+  (void)type;
+  return 1;
+#endif
+}
+
+/******************************************************************************
+ *                                  Counters                                  *
+ ******************************************************************************/
+/*
+ * Cycles and instructions of the measuring thread through perf_event_open,
+ * user space only. Not available when perf is restricted, e.g. by
+ * perf_event_paranoid or in containers.
+ */
+struct Perf {
+  int fd; // group leader, -1 if not available
+  int fd_instructions;
+};
+
+#ifdef __linux__
+static int perf_open(uint64_t config, int group) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = group == -1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static void perf_start(struct Perf *perf) {
+  perf->fd = perf_open(PERF_COUNT_HW_CPU_CYCLES, -1);
+  perf->fd_instructions = -1;
+  if (perf->fd < 0) {
+    return;
+  }
+
+  perf->fd_instructions = perf_open(PERF_COUNT_HW_INSTRUCTIONS, perf->fd);
+  if (perf->fd_instructions < 0) {
+    close(perf->fd);
+    perf->fd = -1;
+    return;
+  }
+
+  ioctl(perf->fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(perf->fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+static int perf_stop(struct Perf *perf, uint64_t *cycles,
+                     uint64_t *instructions) {
+  uint64_t values[3];
+  int ok;
+
+  if (perf->fd < 0) {
+    return 0;
+  }
+
+  ioctl(perf->fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  ok = read(perf->fd, values, sizeof(values)) == sizeof(values) &&
+       values[0] == 2;
+  close(perf->fd_instructions);
+  close(perf->fd);
+
+  if (ok) {
+    *cycles = values[1];
+    *instructions = values[2];
+  }
+  return ok;
+}
+#else
+static void perf_start(struct Perf *perf) { perf->fd = -1; }
+
+static int perf_stop(struct Perf *perf, uint64_t *cycles,
+                     uint64_t *instructions) {
+  (void)perf;
+  (void)cycles;
+  (void)instructions;
+  return 0;
+}
+#endif
+
+/******************************************************************************
+ *                                   Runner                                   *
+ ******************************************************************************/
+struct Case {
+  enum Type type;
+  int depth;
+  int threads;
+  size_t samples; // per thread
+};
+
+struct Worker {
+  const struct Case *c;
+  atomic_int *ready;
+  double *ns; // per-op latency of each sample
+  uint64_t cycles;
+  uint64_t instructions;
+  int perf;
+  double elapsed_ns;
+};
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static int worker_main(void *arg) {
+  struct Worker *w = arg;
+  const struct Case *c = w->c;
+  volatile int sink = 0;
+  struct Perf perf;
+  uint64_t start;
+
+  for (int i = 0; i < WARMUP; i++) {
+    sink ^= trace(c->type, c->depth);
+  }
+
+  // Start all threads together
+  atomic_fetch_sub(w->ready, 1);
+  while (atomic_load(w->ready) > 0) {
+  }
+
+  perf_start(&perf);
+  start = now_ns();
+  for (size_t s = 0; s < c->samples; s++) {
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BATCH; i++) {
+      sink ^= trace(c->type, c->depth);
+    }
+    w->ns[s] = (double)(now_ns() - t0) / BATCH;
+  }
+  w->elapsed_ns = (double)(now_ns() - start);
+  w->perf = perf_stop(&perf, &w->cycles, &w->instructions);
+
+  (void)sink;
+  return 0;
+}
+
+struct Result {
+  struct Case c;
+  double mean, p50, p90, p99, p999, max;
+  double mops; // all threads
+  int perf;
+  double cycles, instructions; // per op
+};
+
+static int cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, size_t len, double p) {
+  size_t i = (size_t)(p * (double)(len - 1) + 0.5);
+  return sorted[i < len ? i : len - 1];
+}
+
+static int run_case(const struct Case *c, struct Result *r) {
+  size_t len = c->samples * c->threads;
+  struct Worker workers[THREADS_MAX];
+  thrd_t threads[THREADS_MAX];
+  atomic_int ready = c->threads;
+  double *ns = malloc(len * sizeof(*ns));
+  double sum = 0, elapsed = 0;
+  uint64_t cycles = 0, instructions = 0;
+
+  if (!ns) {
+    return ENOMEM;
+  }
+
+  for (int t = 0; t < c->threads; t++) {
+    workers[t] = (struct Worker){
+        .c = c, .ready = &ready, .ns = ns + t * c->samples};
+    if (thrd_create(&threads[t], worker_main, &workers[t]) != thrd_success) {
+      fprintf(stderr, "Unable to start thread %d\n", t);
+      exit(1);
+    }
+  }
+
+  *r = (struct Result){.c = *c, .perf = 1};
+  for (int t = 0; t < c->threads; t++) {
+    thrd_join(threads[t], NULL);
+    r->perf &= workers[t].perf;
+    cycles += workers[t].cycles;
+    instructions += workers[t].instructions;
+    if (workers[t].elapsed_ns > elapsed) {
+      elapsed = workers[t].elapsed_ns;
+    }
+  }
+
+  for (size_t i = 0; i < len; i++) {
+    sum += ns[i];
+  }
+  qsort(ns, len, sizeof(*ns), cmp_double);
+
+  r->mean = sum / len;
+  r->p50 = percentile(ns, len, 0.50);
+  r->p90 = percentile(ns, len, 0.90);
+  r->p99 = percentile(ns, len, 0.99);
+  r->p999 = percentile(ns, len, 0.999);
+  r->max = ns[len - 1];
+  r->mops = (double)len * BATCH / elapsed * 1e3;
+  if (r->perf) {
+    r->cycles = (double)cycles / ((double)len * BATCH);
+    r->instructions = (double)instructions / ((double)len * BATCH);
+  }
+
+  free(ns);
+  return 0;
+}
+
+/******************************************************************************
+ *                                   Output                                   *
+ ******************************************************************************/
+static void print_text(const struct Result *results, size_t len) {
+  printf("config: CDK_ERROR_BTRACE_MAX=%d CDK_ERROR_FSTR_MAX=%d optimize=%d "
+         "sizeof(struct cdk_Error)=%zu\n",
+         CDK_ERROR_BTRACE_MAX, CDK_ERROR_FSTR_MAX,
+#ifdef CDK_ERROR_OPTIMIZE
+         1,
+#else
+         0,
+#endif
+         sizeof(struct cdk_Error));
+  printf("%-6s %5s %7s %8s %8s %8s %8s %8s %8s %8s %8s\n", "type", "depth",
+         "threads", "mean", "p50", "p90", "p99", "p99.9", "Mops/s", "cyc/op",
+         "ins/op");
+
+  for (size_t i = 0; i < len; i++) {
+    const struct Result *r = &results[i];
+    printf("%-6s %5d %7d %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f",
+           type_names[r->c.type], r->c.depth, r->c.threads, r->mean, r->p50,
+           r->p90, r->p99, r->p999, r->mops);
+    if (r->perf) {
+      printf(" %8.1f %8.1f\n", r->cycles, r->instructions);
+    } else {
+      printf(" %8s %8s\n", "-", "-");
+    }
+  }
+}
+
+static void print_json(FILE *fp, const struct Result *results, size_t len) {
+  fprintf(fp, "{\n  \"config\": {\"btrace_max\": %d, \"fstr_max\": %d, "
+              "\"optimize\": %s, \"sizeof_error\": %zu, \"batch\": %d},\n",
+          CDK_ERROR_BTRACE_MAX, CDK_ERROR_FSTR_MAX,
+#ifdef CDK_ERROR_OPTIMIZE
+          "true",
+#else
+          "false",
+#endif
+          sizeof(struct cdk_Error), BATCH);
+  fprintf(fp, "  \"results\": [\n");
+
+  for (size_t i = 0; i < len; i++) {
+    const struct Result *r = &results[i];
+    fprintf(fp,
+            "    {\"type\": \"%s\", \"depth\": %d, \"threads\": %d, "
+            "\"samples\": %zu, \"ns_per_op\": {\"mean\": %.2f, \"p50\": %.2f, "
+            "\"p90\": %.2f, \"p99\": %.2f, \"p999\": %.2f, \"max\": %.2f}, "
+            "\"mops\": %.2f, ",
+            type_names[r->c.type], r->c.depth, r->c.threads,
+            r->c.samples * r->c.threads, r->mean, r->p50, r->p90, r->p99,
+            r->p999, r->max, r->mops);
+    if (r->perf) {
+      fprintf(fp, "\"cycles_per_op\": %.2f, \"instructions_per_op\": %.2f}",
+              r->cycles, r->instructions);
+    } else {
+      fprintf(fp, "\"cycles_per_op\": null, \"instructions_per_op\": null}");
+    }
+    fprintf(fp, "%s\n", i + 1 < len ? "," : "");
+  }
+
+  fprintf(fp, "  ]\n}\n");
+}
+
+/******************************************************************************
+ *                                    Main                                    *
+ ******************************************************************************/
+static size_t parse_list(const char *arg, int *out) {
+  size_t len = 0;
+  char *end;
+
+  while (len < LIST_MAX) {
+    long value = strtol(arg, &end, 10);
+    if (end == arg) {
+      break;
+    }
+    out[len++] = (int)value;
+    if (*end != ',') {
+      break;
+    }
+    arg = end + 1;
+  }
+
+  return len;
+}
+
+static size_t parse_types(const char *arg, int *out) {
+  size_t len = 0;
+
+  while (*arg && len < LIST_MAX) {
+    size_t name_len = strcspn(arg, ",");
+    for (int t = 0; t < TYPE_MAX; t++) {
+      if (strlen(type_names[t]) == name_len &&
+          !strncmp(arg, type_names[t], name_len)) {
+        out[len++] = t;
+      }
+    }
+    arg += name_len + (arg[name_len] == ',');
+  }
+
+  return len;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [--depth 1,5,16] [--threads 1,4] [--types ret,int,...]\n"
+          "          [--samples N] [--json FILE|-]\n",
+          prog);
+}
+
+int main(int argc, char **argv) {
+  int depths[LIST_MAX] = {1, 5, 16, 64}, threads[LIST_MAX] = {1, 4};
+  int types[LIST_MAX] = {TYPE_RET, TYPE_INT, TYPE_STR, TYPE_FSTR, TYPE_DFSTR};
+  size_t depths_len = 4, threads_len = 2, types_len = 5;
+  size_t samples = 20000, results_len = 0;
+  const char *json = NULL;
+  struct Result *results;
+
+  for (int i = 1; i < argc; i++) {
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (!value) {
+      usage(argv[0]);
+      return 2;
+    }
+    if (!strcmp(argv[i], "--depth")) {
+      depths_len = parse_list(value, depths);
+    } else if (!strcmp(argv[i], "--threads")) {
+      threads_len = parse_list(value, threads);
+    } else if (!strcmp(argv[i], "--types")) {
+      types_len = parse_types(value, types);
+    } else if (!strcmp(argv[i], "--samples")) {
+      samples = strtoul(value, NULL, 10);
+    } else if (!strcmp(argv[i], "--json")) {
+      json = value;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+    i++;
+  }
+
+  for (size_t t = 0; t < threads_len; t++) {
+    if (threads[t] < 1 || threads[t] > THREADS_MAX) {
+      fprintf(stderr, "Thread count must be in 1..%d\n", THREADS_MAX);
+      return 2;
+    }
+  }
+  if (!samples) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  results = calloc(depths_len * threads_len * types_len, sizeof(*results));
+  if (!results) {
+    return 1;
+  }
+
+  for (size_t ty = 0; ty < types_len; ty++) {
+    if (!type_supported(types[ty])) {
+      continue;
+    }
+    for (size_t d = 0; d < depths_len; d++) {
+      for (size_t t = 0; t < threads_len; t++) {
+        struct Case c = {.type = types[ty],
+                         .depth = depths[d],
+                         .threads = threads[t],
+                         .samples = samples};
+        if (run_case(&c, &results[results_len])) {
+          return 1;
+        }
+        results_len++;
+      }
+    }
+  }
+
+  if (!json) {
+    print_text(results, results_len);
+  } else if (!strcmp(json, "-")) {
+    print_json(stdout, results, results_len);
+  } else {
+    FILE *fp = fopen(json, "w");
+    if (!fp) {
+      fprintf(stderr, "Unable to open %s: %s\n", json, strerror(errno));
+      return 1;
+    }
+    print_json(fp, results, results_len);
+    fclose(fp);
+    print_text(results, results_len);
+  }
+
+  free(results);
+  return 0;
+}
@@ -0,0 +1,176 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <expected>
+#include <system_error>
+
+#include "cdk_error.hpp"
+
+thread_local cdk_error_t cdk_errno = nullptr;
+thread_local struct cdk_Error cdk_hidden_errno = {};
+
+#define NOINLINE __attribute__((noinline))
+
+#define ROUNDS 20000
+#define BATCH 16
+
+/*
+ * A call chain of `depth` functions, each adding one to the value its callee
+ * returned, the innermost fails on the error path. Errors are reported with
+ * cdk::result, the C errno macros, exceptions, an std::error_code out
+ * parameter and std::expected. Only the cdk ones collect a trace, every
+ * level of the chain adds a frame.
+ */
+static volatile bool fail_flag;
+
+static NOINLINE cdk::result<int> via_result(int depth, bool fail) {
+  if (depth <= 1) {
+    if (fail) {
+      return cdk::fail(EINVAL);
+    }
+    return 1;
+  }
+  auto r = via_result(depth - 1, fail);
+  if (!r) {
+    return r.wrap();
+  }
+  return *r + 1;
+}
+
+static NOINLINE int via_errno(int depth, bool fail, int *out) {
+  if (depth <= 1) {
+    if (fail) {
+      cdk_errno = cdk_errnoi(EINVAL);
+      return -1;
+    }
+    *out = 1;
+    return 0;
+  }
+  if (via_errno(depth - 1, fail, out)) {
+    return cdk_ereturn(-1);
+  }
+  *out += 1;
+  return 0;
+}
+
+static NOINLINE int via_exception(int depth, bool fail) {
+  if (depth <= 1) {
+    if (fail) {
+      throw std::system_error(EINVAL, std::generic_category());
+    }
+    return 1;
+  }
+  return via_exception(depth - 1, fail) + 1;
+}
+
+static NOINLINE int via_error_code(int depth, bool fail, std::error_code &ec) {
+  if (depth <= 1) {
+    if (fail) {
+      ec = std::error_code(EINVAL, std::generic_category());
+      return 0;
+    }
+    return 1;
+  }
+  int value = via_error_code(depth - 1, fail, ec);
+  if (ec) {
+    return 0;
+  }
+  return value + 1;
+}
+
+static NOINLINE std::expected<int, std::error_code> via_expected(int depth,
+                                                                 bool fail) {
+  if (depth <= 1) {
+    if (fail) {
+      return std::unexpected(std::error_code(EINVAL, std::generic_category()));
+    }
+    return 1;
+  }
+  auto r = via_expected(depth - 1, fail);
+  if (!r) {
+    return std::unexpected(r.error());
+  }
+  return *r + 1;
+}
+
+/*
+ * Entry points return the value, or -1 on error, so every approach does the
+ * same work at the top.
+ */
+static NOINLINE int call_result(int depth) {
+  auto r = via_result(depth, fail_flag);
+  return r ? *r : -1;
+}
+
+static NOINLINE int call_errno(int depth) {
+  int value;
+  return via_errno(depth, fail_flag, &value) ? -1 : value;
+}
+
+static NOINLINE int call_exception(int depth) {
+  try {
+    return via_exception(depth, fail_flag);
+  } catch (const std::system_error &) {
+    return -1;
+  }
+}
+
+static NOINLINE int call_error_code(int depth) {
+  std::error_code ec;
+  int value = via_error_code(depth, fail_flag, ec);
+  return ec ? -1 : value;
+}
+
+static NOINLINE int call_expected(int depth) {
+  auto r = via_expected(depth, fail_flag);
+  return r ? *r : -1;
+}
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static double best_ns(int (*call)(int), int depth) {
+  uint64_t best = UINT64_MAX;
+  int sink = 0;
+
+  for (int r = 0; r < ROUNDS; r++) {
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BATCH; i++) {
+      sink += call(depth);
+    }
+    uint64_t dt = now_ns() - t0;
+    best = dt < best ? dt : best;
+  }
+
+  if (sink == 42) {
+    std::puts("");
+  }
+  return (double)best / BATCH;
+}
+
+int main(void) {
+  static const int depths[] = {1, 4, 16};
+  static int (*const calls[])(int) = {call_result, call_errno, call_exception,
+                                      call_error_code, call_expected};
+
+  std::printf("config: CDK_ERROR_BTRACE_MAX=%d\n", CDK_ERROR_BTRACE_MAX);
+  std::printf("%-5s %5s %10s %10s %10s %10s %10s\n", "path", "depth",
+              "result", "errno", "exception", "error_code", "expected");
+
+  for (int fail = 0; fail < 2; fail++) {
+    fail_flag = fail;
+    for (int depth : depths) {
+      std::printf("%-5s %5d", fail ? "error" : "ok", depth);
+      for (auto call : calls) {
+        std::printf(" %10.1f", best_ns(call, depth));
+      }
+      std::printf("\n");
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,87 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "cdk_error.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+#define NOINLINE __attribute__((noinline))
+
+#define ROUNDS 200000
+#define BATCH 16
+
+/*
+ * A failed read reports its descriptor, offset and peer. The context is put in
+ * a formatted message, a deferred one, or typed fields. Raising the error is
+ * timed alone and together with a dump, like an error that is logged.
+ */
+enum Kind {
+  KIND_FSTR,
+  KIND_DFSTR,
+  KIND_FIELDS,
+};
+
+static const char *kind_names[] = {"fstr", "dfstr", "fields"};
+
+static char dump_buf[1024];
+
+static NOINLINE int read_at(enum Kind kind, int fd, uint64_t offset,
+                            const char *peer) {
+  switch (kind) {
+  case KIND_FSTR:
+    cdk_errno = cdk_errnof(EIO, "Short read fd=%d offset=%llu peer=%s", fd,
+                           (unsigned long long)offset, peer);
+    break;
+  case KIND_DFSTR:
+    cdk_errno = cdk_errnod(EIO, "Short read fd=%d offset=%llu peer=%s", fd,
+                           (unsigned long long)offset, peer);
+    break;
+  default:
+    cdk_errno = cdk_errnos(EIO, "Short read");
+    cdk_efield("fd", fd);
+    cdk_efield("offset", offset);
+    cdk_efield("peer", peer);
+  }
+  return -1;
+}
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static double best_ns(enum Kind kind, int dump) {
+  uint64_t best = UINT64_MAX;
+
+  for (int r = 0; r < ROUNDS; r++) {
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BATCH; i++) {
+      read_at(kind, 7, 4096 + i, "10.0.0.1:443");
+      if (dump) {
+        cdk_edumps(sizeof(dump_buf), dump_buf);
+      }
+    }
+    uint64_t dt = now_ns() - t0;
+    best = dt < best ? dt : best;
+  }
+
+  return (double)best / BATCH;
+}
+
+int main(void) {
+  printf("config: CDK_EFIELDS_MAX=%d sizeof(struct cdk_Error)=%zu\n",
+         CDK_EFIELDS_MAX, sizeof(struct cdk_Error));
+  printf("%-7s %10s %14s\n", "context", "raise ns", "raise+dump ns");
+
+  for (int k = KIND_FSTR; k <= KIND_FIELDS; k++) {
+    printf("%-7s %10.1f %14.1f\n", kind_names[k], best_ns(k, 0),
+           best_ns(k, 1));
+  }
+
+  return 0;
+}
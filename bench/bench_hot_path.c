@@ -0,0 +1,172 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cdk_error.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+#define NOINLINE __attribute__((noinline))
+
+#define RECORDS 4096
+#define ROUNDS 2000
+
+/******************************************************************************
+ *                                  Workload                                  *
+ ******************************************************************************/
+/*
+ * A record parser with an error check after every step, the shape of most
+ * code using cdk_errno. Whether raising is inlined into it or not decides how
+ * much of the parser is error handling that the fast path has to jump over.
+ */
+struct Record {
+  uint8_t magic;
+  uint8_t version;
+  uint16_t kind;
+  uint32_t len;
+  uint32_t crc;
+  uint32_t value;
+};
+
+struct Totals {
+  uint64_t values;
+  uint32_t kinds[8];
+};
+
+static int check_header(const struct Record *r) {
+  if (r->magic != 0xCD) {
+    cdk_errno = cdk_errnof(EBADMSG, "Bad magic 0x%02x", r->magic);
+    return -1;
+  }
+  if (r->version > 2) {
+    cdk_errno = cdk_errnof(EPROTO, "Unsupported version %d", r->version);
+    return -1;
+  }
+  if (r->kind >= 8) {
+    cdk_errno = cdk_errnos(EINVAL, "Unknown record kind");
+    return -1;
+  }
+  return 0;
+}
+
+static int check_body(const struct Record *r) {
+  if (r->len > 1 << 20) {
+    cdk_errno = cdk_errnof(EMSGSIZE, "Record of %u bytes", r->len);
+    return -1;
+  }
+  if ((r->value ^ r->len ^ r->kind) != r->crc) {
+    cdk_errno = cdk_errnoi(EILSEQ);
+    return -1;
+  }
+  return 0;
+}
+
+static int apply(struct Totals *t, const struct Record *r) {
+  if (t->values + r->value < t->values) {
+    cdk_errno = cdk_errnos(EOVERFLOW, "Totals overflow");
+    return -1;
+  }
+  t->values += r->value;
+  t->kinds[r->kind]++;
+  return 0;
+}
+
+static NOINLINE int parse_record(struct Totals *t, const struct Record *r) {
+  if (check_header(r) < 0) {
+    return cdk_ereturn(-1);
+  }
+  if (check_body(r) < 0) {
+    return cdk_ereturn(-1);
+  }
+  if (apply(t, r) < 0) {
+    return cdk_ereturn(-1);
+  }
+  return 0;
+}
+
+static NOINLINE int parse_all(struct Totals *t, const struct Record *records,
+                              size_t len, size_t *failed) {
+  for (size_t i = 0; i < len; i++) {
+    if (parse_record(t, &records[i]) < 0) {
+      cdk_ewrap();
+      (*failed)++;
+    }
+  }
+  return 0;
+}
+
+/******************************************************************************
+ *                                   Runner                                   *
+ ******************************************************************************/
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Every `bad_every`-th record is corrupted, 0 keeps all records valid
+static void fill(struct Record *records, size_t len, size_t bad_every) {
+  for (size_t i = 0; i < len; i++) {
+    struct Record *r = &records[i];
+    r->magic = 0xCD;
+    r->version = 1;
+    r->kind = i % 8;
+    r->len = 64 + i % 512;
+    r->value = (uint32_t)i * 2654435761u;
+    r->crc = r->value ^ r->len ^ r->kind;
+    if (bad_every && i % bad_every == bad_every - 1) {
+      r->crc ^= 1;
+    }
+  }
+}
+
+static double run(const struct Record *records, size_t *failed) {
+  struct Totals t = {0};
+  uint64_t best = UINT64_MAX;
+
+  *failed = 0;
+  for (int round = 0; round < ROUNDS; round++) {
+    uint64_t t0 = now_ns();
+    parse_all(&t, records, RECORDS, failed);
+    uint64_t dt = now_ns() - t0;
+    best = dt < best ? dt : best;
+  }
+  *failed /= ROUNDS;
+
+  return (double)best / RECORDS;
+}
+
+int main(void) {
+  static const size_t bad_every[] = {0, 1000, 100, 10, 1};
+  static struct Record records[RECORDS];
+
+#ifdef CDK_ERROR_NO_OUTLINE
+  printf("mode: inlined (CDK_ERROR_NO_OUTLINE)\n");
+#else
+  printf("mode: outlined\n");
+#endif
+  printf("%-10s %8s %12s\n", "errors", "failed", "ns/record");
+
+  for (size_t i = 0; i < sizeof(bad_every) / sizeof(*bad_every); i++) {
+    size_t failed;
+    double ns;
+    char label[32];
+
+    fill(records, RECORDS, bad_every[i]);
+    ns = run(records, &failed);
+
+    if (bad_every[i]) {
+      snprintf(label, sizeof(label), "1/%zu", bad_every[i]);
+    } else {
+      snprintf(label, sizeof(label), "none");
+    }
+    printf("%-10s %8zu %12.2f\n", label, failed, ns);
+  }
+
+  return 0;
+}
@@ -0,0 +1,225 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "cdk_error.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+#ifdef CDK_ERROR_FSTR_INLINE
+_Thread_local struct cdk_EMsgSpill cdk_emsg_spill = {0};
+#endif
+
+#define NOINLINE __attribute__((noinline))
+
+#define FOOTPRINT (64u << 20)
+#define PASSES 20
+#define CACHELINE 64
+
+/*
+ * Errors of many requests in flight, each raised, wrapped and checked in a
+ * random order, so every error starts out of cache like one kept in a
+ * connection or task struct. Reports how many cachelines a raise with `wraps`
+ * wraps touches, averaged over the 8-byte aligned placements of the error,
+ * and the measured time and cache misses per error.
+ */
+static struct cdk_Error *errs;
+static uint32_t *order;
+static size_t errs_len;
+
+static NOINLINE void handle(struct cdk_Error *err, int wraps) {
+  cdk_errori(err, EIO);
+  for (int i = 0; i < wraps; i++) {
+    cdk_error_wrap(err);
+  }
+}
+
+static size_t lines_touched(int wraps) {
+  size_t total = 0;
+
+  for (size_t start = 0; start < CACHELINE; start += 8) {
+    uint64_t touched = 0;
+    size_t offsets[] = {
+        offsetof(struct cdk_Error, type),
+        offsetof(struct cdk_Error, code),
+        offsetof(struct cdk_Error, msg),
+        offsetof(struct cdk_Error, eframes_len),
+    };
+
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(*offsets); i++) {
+      touched |= 1ull << ((start + offsets[i]) / CACHELINE);
+    }
+    for (int i = 0; i <= wraps && i < CDK_ERROR_BTRACE_MAX; i++) {
+      size_t first = start + offsetof(struct cdk_Error, eframes) +
+                     i * sizeof(struct cdk_EFrame);
+      size_t last = first + sizeof(struct cdk_EFrame) - 1;
+      touched |= 1ull << (first / CACHELINE);
+      touched |= 1ull << (last / CACHELINE);
+    }
+    total += (size_t)__builtin_popcountll(touched);
+  }
+
+  return total;
+}
+
+struct Perf {
+  int fd; // group leader, -1 if not available
+  int fd_llc;
+};
+
+#ifdef __linux__
+static int perf_open(uint32_t type, uint64_t config, int group) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = group == -1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static void perf_start(struct Perf *perf) {
+  perf->fd = perf_open(PERF_TYPE_HW_CACHE,
+                       PERF_COUNT_HW_CACHE_L1D |
+                           PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                           PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+                       -1);
+  perf->fd_llc = -1;
+  if (perf->fd < 0) {
+    return;
+  }
+
+  perf->fd_llc =
+      perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, perf->fd);
+  if (perf->fd_llc < 0) {
+    close(perf->fd);
+    perf->fd = -1;
+    return;
+  }
+
+  ioctl(perf->fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(perf->fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+static int perf_stop(struct Perf *perf, uint64_t *l1d, uint64_t *llc) {
+  uint64_t values[3];
+  int ok;
+
+  if (perf->fd < 0) {
+    return 0;
+  }
+
+  ioctl(perf->fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  ok = read(perf->fd, values, sizeof(values)) == sizeof(values) &&
+       values[0] == 2;
+  close(perf->fd_llc);
+  close(perf->fd);
+
+  if (ok) {
+    *l1d = values[1];
+    *llc = values[2];
+  }
+  return ok;
+}
+#else
+static void perf_start(struct Perf *perf) { perf->fd = -1; }
+
+static int perf_stop(struct Perf *perf, uint64_t *l1d, uint64_t *llc) {
+  (void)perf, (void)l1d, (void)llc;
+  return 0;
+}
+#endif
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void run(int wraps) {
+  uint64_t best = UINT64_MAX, l1d = 0, llc = 0;
+  int have_perf = 0;
+
+  for (int pass = 0; pass < PASSES; pass++) {
+    struct Perf perf;
+    uint64_t pass_l1d, pass_llc;
+
+    // Evict the errors between passes.
+    memset(errs, 0, errs_len * sizeof(*errs));
+
+    perf_start(&perf);
+    uint64_t t0 = now_ns();
+    for (size_t i = 0; i < errs_len; i++) {
+      handle(&errs[order[i]], wraps);
+    }
+    uint64_t dt = now_ns() - t0;
+    if (perf_stop(&perf, &pass_l1d, &pass_llc) && dt < best) {
+      l1d = pass_l1d;
+      llc = pass_llc;
+      have_perf = 1;
+    }
+    best = dt < best ? dt : best;
+  }
+
+  printf("%5d %8.2f %8.1f", wraps, lines_touched(wraps) / 8.0,
+         (double)best / errs_len);
+  if (have_perf) {
+    printf(" %8.2f %8.2f\n", (double)l1d / errs_len, (double)llc / errs_len);
+  } else {
+    printf(" %8s %8s\n", "n/a", "n/a");
+  }
+}
+
+int main(void) {
+  static const int wraps[] = {0, 2, 6};
+
+  errs_len = FOOTPRINT / sizeof(struct cdk_Error);
+  errs = aligned_alloc(CACHELINE, errs_len * sizeof(*errs));
+  order = malloc(errs_len * sizeof(*order));
+  if (!errs || !order) {
+    perror("malloc");
+    return 1;
+  }
+
+  srand(1);
+  for (size_t i = 0; i < errs_len; i++) {
+    order[i] = (uint32_t)i;
+  }
+  for (size_t i = errs_len - 1; i > 0; i--) {
+    size_t j = (size_t)rand() % (i + 1);
+    uint32_t tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+  }
+
+  printf("config: CDK_ERROR_BTRACE_MAX=%d CDK_ERROR_FSTR_MAX=%d "
+         "sizeof(struct cdk_Error)=%zu errors=%zu\n",
+         CDK_ERROR_BTRACE_MAX, CDK_ERROR_FSTR_MAX, sizeof(struct cdk_Error),
+         errs_len);
+  printf("%5s %8s %8s %8s %8s\n", "wraps", "lines", "ns", "L1D miss",
+         "LLC miss");
+  for (size_t i = 0; i < sizeof(wraps) / sizeof(*wraps); i++) {
+    run(wraps[i]);
+  }
+
+  free(order);
+  free(errs);
+  return 0;
+}
@@ -0,0 +1,222 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cdk_error.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+#ifdef CDK_ERROR_LAZY
+struct cdk_ELazy cdk_elazy = {0};
+_Thread_local struct cdk_Error *cdk_lazy_errno = NULL;
+#define BENCH_MODE "lazy"
+#else
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+#define BENCH_MODE "eager"
+#endif
+
+#define NOINLINE __attribute__((noinline))
+
+#define THREADS_MAX 1024
+#define STACK_SIZE (64u << 10)
+#define SPAWN_ROUNDS 2000
+#define RAISE_ROUNDS 200
+
+#ifdef CDK_ERROR_LAZY
+static struct cdk_EPoolSlot pool_slots[THREADS_MAX];
+#endif
+
+/*
+ * A pool of blocking threads with small stacks, as a server keeps for its
+ * connections. Reports the resident memory each parked thread adds when none
+ * of them, or every one, raised an error, the cost of creating and joining a
+ * thread, and the latency of the first error of a thread against a later one.
+ * Build with and without CDK_ERROR_LAZY to compare.
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static int parked;
+
+static NOINLINE int read_sector(int sector) {
+  cdk_errno = cdk_errnof(EIO, "Read of sector %d failed", sector);
+  return -1;
+}
+
+static NOINLINE int read_block(int block) {
+  if (read_sector(block * 8)) {
+    return cdk_ereturn(-1);
+  }
+  return 0;
+}
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static size_t rss_bytes(void) {
+  FILE *f = fopen("/proc/self/statm", "r");
+  unsigned long size, resident = 0;
+
+  if (!f) {
+    return 0;
+  }
+  if (fscanf(f, "%lu %lu", &size, &resident) != 2) {
+    resident = 0;
+  }
+  fclose(f);
+  return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static void *park(void *arg) {
+  if (arg) {
+    read_block(1);
+  }
+
+  pthread_mutex_lock(&lock);
+  parked++;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+  pause();
+  return NULL;
+}
+
+static void spawn(pthread_t *threads, int len, void *(*main)(void *),
+                  void *arg) {
+  pthread_attr_t attr;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, STACK_SIZE);
+  for (int i = 0; i < len; i++) {
+    if (pthread_create(&threads[i], &attr, main, arg)) {
+      perror("pthread_create");
+      exit(1);
+    }
+  }
+  pthread_attr_destroy(&attr);
+}
+
+// Measured in a child process, glibc keeps stacks of joined threads for reuse.
+static double rss_per_thread(int len, int raise) {
+  static pthread_t threads[THREADS_MAX];
+  double per_thread = 0;
+  int fds[2];
+  pid_t pid;
+
+  if (pipe(fds) || (pid = fork()) < 0) {
+    perror("fork");
+    exit(1);
+  }
+
+  if (pid == 0) {
+    size_t before = rss_bytes();
+
+    spawn(threads, len, park, raise ? (void *)1 : NULL);
+    pthread_mutex_lock(&lock);
+    while (parked < len) {
+      pthread_cond_wait(&cond, &lock);
+    }
+    per_thread = ((double)rss_bytes() - (double)before) / len / 1024;
+    pthread_mutex_unlock(&lock);
+
+    if (write(fds[1], &per_thread, sizeof(per_thread)) < 0) {
+      _exit(1);
+    }
+    _exit(0);
+  }
+
+  close(fds[1]);
+  if (read(fds[0], &per_thread, sizeof(per_thread)) != sizeof(per_thread)) {
+    per_thread = 0;
+  }
+  close(fds[0]);
+  waitpid(pid, NULL, 0);
+  return per_thread;
+}
+
+static void *quit(void *arg) {
+  if (arg) {
+    read_block(1);
+  }
+  return NULL;
+}
+
+static double spawn_ns(int raise) {
+  uint64_t start = now_ns();
+
+  for (int i = 0; i < SPAWN_ROUNDS; i++) {
+    pthread_t thread;
+
+    spawn(&thread, 1, quit, raise ? (void *)1 : NULL);
+    pthread_join(thread, NULL);
+  }
+  return (double)(now_ns() - start) / SPAWN_ROUNDS;
+}
+
+struct Latency {
+  uint64_t first, later;
+};
+
+static void *time_raises(void *arg) {
+  struct Latency *lat = arg;
+  uint64_t t0 = now_ns();
+
+  read_block(1);
+  uint64_t t1 = now_ns();
+  read_block(2);
+  uint64_t t2 = now_ns();
+
+  lat->first = t1 - t0;
+  lat->later = t2 - t1;
+  return NULL;
+}
+
+static void raise_latency(double *first, double *later) {
+  uint64_t best_first = UINT64_MAX, best_later = UINT64_MAX;
+
+  for (int i = 0; i < RAISE_ROUNDS; i++) {
+    struct Latency lat;
+    pthread_t thread;
+
+    spawn(&thread, 1, time_raises, &lat);
+    pthread_join(thread, NULL);
+    best_first = lat.first < best_first ? lat.first : best_first;
+    best_later = lat.later < best_later ? lat.later : best_later;
+  }
+  *first = (double)best_first;
+  *later = (double)best_later;
+}
+
+int main(void) {
+  double first, later;
+
+#ifdef CDK_ERROR_LAZY
+  cdk_elazy_init(THREADS_MAX, pool_slots);
+#endif
+
+  printf("mode: %s CDK_ERROR_BTRACE_MAX=%d CDK_ERROR_FSTR_MAX=%d "
+         "sizeof(struct cdk_Error)=%zu stack=%u KiB\n",
+         BENCH_MODE, CDK_ERROR_BTRACE_MAX, CDK_ERROR_FSTR_MAX,
+         sizeof(struct cdk_Error), STACK_SIZE >> 10);
+
+  printf("%-8s %14s %14s\n", "threads", "KiB/thread", "raised KiB/t");
+  for (int len = 64; len <= THREADS_MAX; len *= 4) {
+    double idle = rss_per_thread(len, 0);
+    double raised = rss_per_thread(len, 1);
+
+    printf("%-8d %14.1f %14.1f\n", len, idle, raised);
+  }
+
+  printf("spawn+join ns: %.0f idle, %.0f raising\n", spawn_ns(0),
+         spawn_ns(1));
+
+  raise_latency(&first, &later);
+  printf("raise ns: %.0f first, %.0f later\n", first, later);
+  return 0;
+}
@@ -0,0 +1,138 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+#include <time.h>
+
+#include "cdk_error.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+#define NOINLINE __attribute__((noinline))
+
+#define ERRORS_PER_THREAD 200000
+#define THREADS_MAX 64
+#define CAPACITY 4096
+
+/*
+ * Request threads fail with a formatted error five levels deep and log it.
+ * The sync mode dumps the error and writes it to the log descriptor on the
+ * request thread, the async modes push it to a cdk_ELog whose writer thread
+ * does the same. Time is measured on the request threads; the async modes
+ * also report errors dropped because the writer fell behind.
+ */
+enum Mode {
+  MODE_SYNC,
+  MODE_DROP,
+  MODE_OVERWRITE,
+};
+
+static const char *mode_names[] = {"sync", "drop", "overwrite"};
+
+static struct cdk_ELogSlot slots[CAPACITY];
+static struct cdk_ELog log;
+static enum Mode mode;
+static int log_fd;
+
+static NOINLINE int read_block(int depth, int block) {
+  if (depth <= 1) {
+    cdk_errno = cdk_errnof(EIO, "Read of block %d failed", block);
+    return -1;
+  }
+  if (read_block(depth - 1, block)) {
+    return cdk_ereturn(-1);
+  }
+  return 0;
+}
+
+static NOINLINE void log_error(void) {
+  char buf[2048];
+
+  if (mode != MODE_SYNC) {
+    cdk_elog(&log);
+    return;
+  }
+  cdk_edumps(sizeof(buf), buf);
+  if (write(log_fd, buf, strlen(buf)) < 0) {
+    abort();
+  }
+}
+
+static int worker_main(void *arg) {
+  for (int i = 0; i < ERRORS_PER_THREAD; i++) {
+    read_block(5, i);
+    log_error();
+  }
+  (void)arg;
+  return 0;
+}
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+  int threads_len = argc > 1 ? atoi(argv[1]) : 1;
+  const char *path = argc > 2 ? argv[2] : "/dev/null";
+  thrd_t threads[THREADS_MAX];
+
+  if (threads_len < 1 || threads_len > THREADS_MAX) {
+    fprintf(stderr, "usage: %s [threads 1-%d] [log file]\n", argv[0],
+            THREADS_MAX);
+    return 1;
+  }
+  log_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  if (log_fd < 0) {
+    perror(path);
+    return 1;
+  }
+
+  printf("threads: %d queue: %d sizeof(struct cdk_ELogSlot)=%zu log: %s\n",
+         threads_len, CAPACITY, sizeof(struct cdk_ELogSlot), path);
+  printf("%-10s %10s %12s %10s %10s\n", "mode", "ns/error", "errors/s",
+         "written", "dropped");
+
+  for (mode = MODE_SYNC; mode <= MODE_OVERWRITE; mode++) {
+    uint64_t errors = (uint64_t)threads_len * ERRORS_PER_THREAD;
+    uint64_t start, elapsed, written = errors, dropped = 0;
+
+    if (mode != MODE_SYNC) {
+      cdk_elog_init(&log, log_fd,
+                    mode == MODE_DROP ? cdk_ELogPolicy_DROP
+                                      : cdk_ELogPolicy_OVERWRITE,
+                    CAPACITY, slots);
+      cdk_elog_start(&log);
+    }
+
+    start = now_ns();
+    for (int t = 0; t < threads_len; t++) {
+      thrd_create(&threads[t], worker_main, NULL);
+    }
+    for (int t = 0; t < threads_len; t++) {
+      thrd_join(threads[t], NULL);
+    }
+    elapsed = now_ns() - start;
+
+    if (mode != MODE_SYNC) {
+      cdk_elog_stop(&log);
+    }
+
+    if (mode != MODE_SYNC) {
+      written = atomic_load(&log.written);
+      dropped = atomic_load(&log.dropped);
+    }
+    printf("%-10s %10.1f %12.0f %10llu %10llu\n", mode_names[mode],
+           (double)elapsed * threads_len / errors,
+           (double)errors * 1e9 / elapsed, (unsigned long long)written,
+           (unsigned long long)dropped);
+  }
+
+  close(log_fd);
+  return 0;
+}
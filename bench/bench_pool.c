@@ -0,0 +1,166 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+#include <time.h>
+
+#include "cdk_error.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+#define NOINLINE __attribute__((noinline))
+
+#define CONNECTIONS 10000
+#define EVENTS_PER_CONN 2000
+#define THREADS_MAX 64
+
+/*
+ * An event loop over CONNECTIONS connections. An event on a connection without
+ * a pending error fails it one time in four; the error is kept on the
+ * connection until the next event on it runs the handler, which reads and
+ * drops the error. Errors come either from a shared pool or from malloc.
+ */
+struct Conn {
+  cdk_epool_handle_t handle;
+  cdk_error_t err;
+};
+
+struct Worker {
+  int use_pool;
+  size_t conns_len;
+  struct Conn *conns;
+  uint64_t handled;
+  uint64_t exhausted;
+};
+
+static struct cdk_EPool pool;
+
+static NOINLINE int conn_read(cdk_error_t err, uint32_t fd) {
+  cdk_errors(err, ECONNRESET, "Connection reset by peer");
+  (void)fd;
+  return cdk_error_return(-1, err);
+}
+
+static NOINLINE int conn_fail(struct Worker *w, struct Conn *c, uint32_t fd) {
+  if (w->use_pool) {
+    c->handle = cdk_epool_acquire(&pool);
+    if (!c->handle) {
+      w->exhausted++;
+      return -1;
+    }
+    c->err = cdk_epool_get(&pool, c->handle);
+  } else {
+    c->err = malloc(sizeof(struct cdk_Error));
+    if (!c->err) {
+      w->exhausted++;
+      return -1;
+    }
+  }
+
+  conn_read(c->err, fd);
+  cdk_error_wrap(c->err);
+  return 0;
+}
+
+static NOINLINE void conn_handle(struct Worker *w, struct Conn *c) {
+  w->handled += c->err->code;
+  if (w->use_pool) {
+    cdk_epool_release(&pool, c->handle);
+  } else {
+    free(c->err);
+  }
+  c->err = NULL;
+}
+
+static int worker_main(void *arg) {
+  struct Worker *w = arg;
+  uint64_t rng = (uintptr_t)w | 1;
+
+  for (size_t i = 0; i < w->conns_len * EVENTS_PER_CONN; i++) {
+    struct Conn *c;
+
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    c = &w->conns[rng % w->conns_len];
+
+    if (c->err) {
+      conn_handle(w, c);
+    } else if ((rng >> 32 & 3) == 0) {
+      conn_fail(w, c, (uint32_t)(c - w->conns));
+    }
+  }
+
+  for (size_t i = 0; i < w->conns_len; i++) {
+    if (w->conns[i].err) {
+      conn_handle(w, &w->conns[i]);
+    }
+  }
+
+  return 0;
+}
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static double run(int use_pool, int threads_len, uint64_t *exhausted) {
+  static struct Conn conns[CONNECTIONS];
+  struct Worker workers[THREADS_MAX];
+  thrd_t threads[THREADS_MAX];
+  size_t per_thread = CONNECTIONS / threads_len, events = 0;
+  uint64_t start;
+
+  *exhausted = 0;
+  for (int t = 0; t < threads_len; t++) {
+    workers[t] = (struct Worker){
+        .use_pool = use_pool,
+        .conns_len = per_thread,
+        .conns = &conns[t * per_thread],
+    };
+    events += per_thread * EVENTS_PER_CONN;
+  }
+
+  start = now_ns();
+  for (int t = 0; t < threads_len; t++) {
+    thrd_create(&threads[t], worker_main, &workers[t]);
+  }
+  for (int t = 0; t < threads_len; t++) {
+    thrd_join(threads[t], NULL);
+    *exhausted += workers[t].exhausted;
+  }
+
+  return (double)(now_ns() - start) / events;
+}
+
+int main(int argc, char **argv) {
+  static struct cdk_EPoolSlot slots[CONNECTIONS];
+  int threads_len = argc > 1 ? atoi(argv[1]) : 1;
+  uint64_t exhausted;
+
+  if (threads_len < 1 || threads_len > THREADS_MAX) {
+    fprintf(stderr, "usage: %s [threads 1-%d]\n", argv[0], THREADS_MAX);
+    return 1;
+  }
+
+  // One slot per connection, every connection may hold an error.
+  cdk_epool_init(&pool, CONNECTIONS, slots);
+
+  printf("connections: %d threads: %d sizeof(struct cdk_Error)=%zu "
+         "pool=%zu KiB\n",
+         CONNECTIONS, threads_len, sizeof(struct cdk_Error),
+         sizeof(slots) / 1024);
+  printf("%-8s %12s %10s\n", "errors", "ns/event", "exhausted");
+  for (int use_pool = 0; use_pool < 2; use_pool++) {
+    double ns = run(use_pool, threads_len, &exhausted);
+    printf("%-8s %12.2f %10llu\n", use_pool ? "pool" : "malloc", ns,
+           (unsigned long long)exhausted);
+  }
+
+  return 0;
+}
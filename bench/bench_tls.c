@@ -0,0 +1,82 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+#include <time.h>
+
+#include "bench_tls_lib.h"
+
+#define OPS_PER_THREAD 2000000
+#define THREADS_MAX 64
+
+#ifndef BENCH_TLS_BUILD
+#define BENCH_TLS_BUILD "exe"
+#endif
+
+/*
+ * The errno path of bench_tls_lib.c run on 1 to N threads at once. The same
+ * file is linked into the executable or built into a shared library, where
+ * every access to the thread-local error goes through the TLS model of the
+ * build. Each thread runs the path OPS_PER_THREAD times; the time per op is
+ * the wall time of the whole run divided by that.
+ */
+struct Worker {
+  int (*path)(int sector);
+  int sink;
+};
+
+static int worker_main(void *arg) {
+  struct Worker *w = arg;
+  int sink = 0;
+
+  for (int i = 0; i < OPS_PER_THREAD; i++) {
+    sink += w->path(i);
+  }
+  w->sink = sink;
+  return 0;
+}
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static double run(int (*path)(int), int threads_len) {
+  struct Worker workers[THREADS_MAX];
+  thrd_t threads[THREADS_MAX];
+  uint64_t start = now_ns();
+
+  for (int t = 0; t < threads_len; t++) {
+    workers[t] = (struct Worker){.path = path};
+    thrd_create(&threads[t], worker_main, &workers[t]);
+  }
+  for (int t = 0; t < threads_len; t++) {
+    thrd_join(threads[t], NULL);
+  }
+
+  return (double)(now_ns() - start) / OPS_PER_THREAD;
+}
+
+int main(int argc, char **argv) {
+  int threads_max = argc > 1 ? atoi(argv[1]) : 4;
+
+  if (threads_max < 1 || threads_max > THREADS_MAX) {
+    fprintf(stderr, "usage: %s [max threads 1-%d]\n", argv[0], THREADS_MAX);
+    return 1;
+  }
+
+  printf("build: %s\n", BENCH_TLS_BUILD);
+  printf("%-8s %10s %10s %12s %12s\n", "threads", "ns/op", "bound ns",
+         "Mops/s", "bound Mops");
+  for (int threads_len = 1; threads_len <= threads_max; threads_len *= 2) {
+    double ns = run(bench_tls_path, threads_len);
+    double bound = run(bench_tls_path_bound, threads_len);
+
+    printf("%-8d %10.1f %10.1f %12.1f %12.1f\n", threads_len, ns, bound,
+           threads_len * 1e3 / ns, threads_len * 1e3 / bound);
+  }
+
+  return 0;
+}
@@ -0,0 +1,38 @@
+#include <errno.h>
+
+#include "bench_tls_lib.h"
+#include "cdk_error.h"
+
+#define NOINLINE __attribute__((noinline))
+
+// Stack of bench_tls_lib.c, each error branch binds the error once.
+static NOINLINE int read_sector(int sector) {
+  if (sector >= 0) {
+    cdk_ebind();
+    cdk_errno = cdk_errnoi(EIO);
+    return -1;
+  }
+  return 0;
+}
+
+#define LEVEL(name, callee)                                                    \
+  static NOINLINE int name(int sector) {                                       \
+    if (callee(sector)) {                                                      \
+      cdk_ebind();                                                             \
+      cdk_ewrap();                                                             \
+      return cdk_ereturn(-1);                                                  \
+    }                                                                          \
+    return 0;                                                                  \
+  }
+
+LEVEL(read_block, read_sector)
+LEVEL(read_inode, read_block)
+LEVEL(read_dir, read_inode)
+LEVEL(open_path, read_dir)
+
+int bench_tls_path_bound(int sector) {
+  if (open_path(sector)) {
+    return cdk_errno->code;
+  }
+  return 0;
+}
@@ -0,0 +1,44 @@
+#include <errno.h>
+
+#include "bench_tls_lib.h"
+#include "cdk_error.h"
+
+_Thread_local cdk_error_t cdk_errno CDK_ERROR_TLS = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno CDK_ERROR_TLS = {0};
+
+#define NOINLINE __attribute__((noinline))
+
+/*
+ * Five levels of a storage stack. Every level checks the error of the level
+ * below, wraps it and returns, so it reaches the thread-local error twice:
+ * once in cdk_ewrap and once in cdk_ereturn. bench_tls_bound.c has the same
+ * stack with cdk_ebind in each error branch.
+ */
+static NOINLINE int read_sector(int sector) {
+  if (sector >= 0) {
+    cdk_errno = cdk_errnoi(EIO);
+    return -1;
+  }
+  return 0;
+}
+
+#define LEVEL(name, callee)                                                    \
+  static NOINLINE int name(int sector) {                                       \
+    if (callee(sector)) {                                                      \
+      cdk_ewrap();                                                             \
+      return cdk_ereturn(-1);                                                  \
+    }                                                                          \
+    return 0;                                                                  \
+  }
+
+LEVEL(read_block, read_sector)
+LEVEL(read_inode, read_block)
+LEVEL(read_dir, read_inode)
+LEVEL(open_path, read_dir)
+
+int bench_tls_path(int sector) {
+  if (open_path(sector)) {
+    return cdk_errno->code;
+  }
+  return 0;
+}
@@ -0,0 +1,8 @@
+#ifndef BENCH_TLS_LIB_H
+#define BENCH_TLS_LIB_H
+
+// Raise an error five levels deep, without and with cdk_ebind.
+int bench_tls_path(int sector);
+int bench_tls_path_bound(int sector);
+
+#endif
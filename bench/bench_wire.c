@@ -0,0 +1,88 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "cdk_error.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+#define NOINLINE __attribute__((noinline))
+
+#define ROUNDS 100000
+#define BATCH 16
+
+/*
+ * An error shipped to a collector, as dump text or as a binary record. Both
+ * are written to a buffer, the size of the output is what goes on the wire.
+ */
+static char text_buf[16384];
+static unsigned char wire_buf[16384];
+
+static NOINLINE int read_block(int fstr, int depth) {
+  if (depth <= 1) {
+#ifndef CDK_ERROR_OPTIMIZE
+    if (fstr) {
+      cdk_errno = cdk_errnof(EIO, "Read of block %d on %s failed", 42, "sda");
+      return -1;
+    }
+#endif
+    cdk_errno = cdk_errnoi(EIO);
+    return -1;
+  }
+  if (read_block(fstr, depth - 1)) {
+    return cdk_ereturn(-1);
+  }
+  return 0;
+}
+
+static NOINLINE size_t ship_text(void) {
+  cdk_edumps(sizeof(text_buf), text_buf);
+  return strlen(text_buf);
+}
+
+static NOINLINE size_t ship_wire(void) {
+  return cdk_eencode(sizeof(wire_buf), wire_buf);
+}
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static double best_ns(size_t (*ship)(void)) {
+  uint64_t best = UINT64_MAX;
+
+  for (int r = 0; r < ROUNDS; r++) {
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BATCH; i++) {
+      ship();
+    }
+    uint64_t dt = now_ns() - t0;
+    best = dt < best ? dt : best;
+  }
+
+  return (double)best / BATCH;
+}
+
+int main(void) {
+  static const int depths[] = {1, 5, CDK_ERROR_BTRACE_MAX};
+
+  printf("config: CDK_ERROR_BTRACE_MAX=%d\n", CDK_ERROR_BTRACE_MAX);
+  printf("%-5s %6s %8s %8s %9s %9s\n", "type", "depth", "text B", "wire B",
+         "text ns", "wire ns");
+
+  for (int fstr = 0; fstr < 2; fstr++) {
+    for (size_t d = 0; d < sizeof(depths) / sizeof(*depths); d++) {
+      read_block(fstr, depths[d]);
+      printf("%-5s %6d %8zu %8zu %9.1f %9.1f\n", fstr ? "fstr" : "int",
+             depths[d], ship_text(), ship_wire(), best_ns(ship_text),
+             best_ns(ship_wire));
+    }
+  }
+
+  return 0;
+}
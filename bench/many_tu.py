@@ -0,0 +1,229 @@
+#!/usr/bin/env python3
+import argparse
+import os
+import resource
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+ROOT_PATH = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+INCLUDE_PATH = os.path.join(ROOT_PATH, "include")
+LIBRARY_SRC = os.path.join(ROOT_PATH, "src", "cdk_error.c")
+
+# Every unit raises, wraps and dumps errors, like a module of a real project.
+UNIT = """\
+#include <errno.h>
+#include <stdio.h>
+
+#include "cdk_error.h"
+
+static int unit_{n}_open(int fd) {{
+  if (fd < 0) {{
+    cdk_errno = cdk_errnof(EBADF, "Bad descriptor %d in unit {n}", fd);
+    return -1;
+  }}
+  if (fd > 1024) {{
+    cdk_errno = cdk_errnos(EMFILE, "Too many files");
+    return -1;
+  }}
+  return fd;
+}}
+
+static int unit_{n}_read(int fd) {{
+  if (unit_{n}_open(fd) < 0) {{
+    return cdk_ereturn(-1);
+  }}
+  if (fd == 7) {{
+    cdk_errno = cdk_errnoi(EAGAIN);
+    return -1;
+  }}
+  return 0;
+}}
+
+int unit_{n}(int fd) {{
+  char buf[512];
+
+  if (unit_{n}_read(fd) < 0) {{
+    cdk_ewrap();
+    if (cdk_edumps(sizeof(buf), buf) == 0) {{
+      fputs(buf, stderr);
+    }}
+    return -1;
+  }}
+  return 0;
+}}
+"""
+
+MAIN_HEAD = """\
+#include "cdk_error.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+"""
+
+
+def generate(path, units):
+    sources = []
+
+    for n in range(units):
+        source = os.path.join(path, "unit_%u.c" % n)
+        with open(source, "w") as fp:
+            fp.write(UNIT.format(n=n))
+        sources.append(source)
+
+    source = os.path.join(path, "main.c")
+    with open(source, "w") as fp:
+        fp.write(MAIN_HEAD)
+        for n in range(units):
+            fp.write("int unit_%u(int fd);\n" % n)
+        fp.write("\nint main(int argc, char **argv) {\n  int ret = 0;\n")
+        for n in range(units):
+            fp.write("  ret |= unit_%u(argc);\n" % n)
+        fp.write("  (void)argv;\n  return ret;\n}\n")
+    sources.append(source)
+
+    return sources
+
+
+def compile_all(args, sources, flags, path):
+    """Compile `sources` in parallel, return (objects, wall, cpu) seconds."""
+
+    def compile_one(source):
+        obj = os.path.join(path, os.path.basename(source) + ".o")
+        cmd = [args.cc, "-c", source, "-o", obj, "-I" + INCLUDE_PATH]
+        subprocess.run(cmd + args.cflags.split() + flags, check=True)
+        return obj
+
+    before = resource.getrusage(resource.RUSAGE_CHILDREN)
+    start = time.monotonic()
+    with ThreadPoolExecutor(args.jobs) as pool:
+        objects = list(pool.map(compile_one, sources))
+    wall = time.monotonic() - start
+    after = resource.getrusage(resource.RUSAGE_CHILDREN)
+    cpu = (after.ru_utime - before.ru_utime) + (after.ru_stime - before.ru_stime)
+
+    return objects, wall, cpu
+
+
+def text_size(path):
+    out = subprocess.run(
+        ["size", "-A", path], check=True, capture_output=True, text=True
+    ).stdout
+    return sum(
+        int(line.split()[1])
+        for line in out.splitlines()
+        if line.startswith(".text")
+    )
+
+
+def run_mode(args, name, flags, extra_sources, path):
+    os.makedirs(path)
+    sources = generate(path, args.units) + extra_sources
+    objects, wall, cpu = compile_all(args, sources, flags, path)
+
+    exe = os.path.join(path, "many_tu")
+    start = time.monotonic()
+    subprocess.run(
+        [args.cc, "-o", exe] + objects + args.ldflags.split(), check=True
+    )
+    link = time.monotonic() - start
+
+    return {
+        "mode": name,
+        "wall": wall,
+        "cpu": cpu,
+        "link": link,
+        "objects": sum(os.path.getsize(o) for o in objects),
+        "text": text_size(exe),
+        "binary": os.path.getsize(exe),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compare build time and size of header-only and compiled "
+        "library modes on a generated project."
+    )
+
+    parser.add_argument(
+        "-n",
+        "--units",
+        help="Number of generated translation units",
+        type=int,
+        default=2000,
+    )
+    parser.add_argument(
+        "-j",
+        "--jobs",
+        help="Parallel compiler jobs",
+        type=int,
+        default=os.cpu_count(),
+    )
+    parser.add_argument(
+        "--cc",
+        help="C compiler",
+        default=os.environ.get("CC", "cc"),
+    )
+    parser.add_argument(
+        "--cflags",
+        help="Compiler flags of every unit",
+        default="-std=c11 -O2 -g0",
+    )
+    parser.add_argument(
+        "--ldflags",
+        help="Linker flags",
+        default="",
+    )
+    parser.add_argument(
+        "--keep",
+        help="Keep generated project in this directory",
+        default=None,
+    )
+
+    args = parser.parse_args()
+
+    path = args.keep or tempfile.mkdtemp(prefix="cdk_error_many_tu_")
+    try:
+        results = [
+            run_mode(args, "header-only", [], [], os.path.join(path, "header")),
+            run_mode(
+                args,
+                "library",
+                ["-DCDK_ERROR_LIBRARY"],
+                [LIBRARY_SRC],
+                os.path.join(path, "library"),
+            ),
+        ]
+    except (OSError, subprocess.CalledProcessError) as e:
+        print(e, file=sys.stderr)
+        sys.exit(1)
+    finally:
+        if not args.keep:
+            shutil.rmtree(path, ignore_errors=True)
+
+    print("%u units, %u jobs, %s %s" % (args.units, args.jobs, args.cc, args.cflags))
+    print(
+        "%-12s %9s %9s %8s %12s %10s %10s"
+        % ("mode", "wall s", "cpu s", "link s", "objects B", "text B", "binary B")
+    )
+    for r in results:
+        print(
+            "%-12s %9.2f %9.2f %8.2f %12u %10u %10u"
+            % (
+                r["mode"],
+                r["wall"],
+                r["cpu"],
+                r["link"],
+                r["objects"],
+                r["text"],
+                r["binary"],
+            )
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -1,5 +1,8 @@
 #define _POSIX_C_SOURCE 200809L
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "example_2_lib.h" // errno-style wrapper (TLS defined in example_2_lib.c)
@@ -76,6 +79,79 @@ static NOINLINE int errf_l5(void) {
 }
 #endif
 
+// — 5-level deferred formatted-error trace —
+#ifndef CDK_ERROR_OPTIMIZE
+static NOINLINE int errd_l1(void) {
+  cdk_errno = cdk_errnod(1, "Error #%d occurred", 1);
+  return -1;
+}
+static NOINLINE int errd_l2(void) {
+  int r = errd_l1();
+  if (r < 0) {
+    return cdk_ereturn(-1);
+  }
+  return r;
+}
+static NOINLINE int errd_l3(void) {
+  int r = errd_l2();
+  if (r < 0) {
+    return cdk_ereturn(-1);
+  }
+  return r;
+}
+static NOINLINE int errd_l4(void) {
+  int r = errd_l3();
+  if (r < 0) {
+    return cdk_ereturn(-1);
+  }
+  return r;
+}
+static NOINLINE int errd_l5(void) {
+  int r = errd_l4();
+  if (r < 0) {
+    return cdk_ereturn(-1);
+  }
+  return r;
+}
+#endif
+
+// — bare construction, no propagation —
+static NOINLINE void construct_int(void) { cdk_errno = cdk_errnoi(EAGAIN); }
+static NOINLINE void construct_str(void) {
+  cdk_errno = cdk_errnos(EAGAIN, "Try again");
+}
+// Reference: what construction cost when the whole object was zero-filled.
+static NOINLINE void construct_zero_fill(void) {
+  cdk_hidden_errno = (struct cdk_Error){
+      .type = cdk_ErrorType_INT,
+      .code = EAGAIN,
+      .eframes = {CDK_EFRAME_HERE()},
+      .eframes_len = 1,
+  };
+  cdk_errno = &cdk_hidden_errno;
+}
+
+// — dump reference: the snprintf/strerror chain cdk_error_dumps used to be —
+static NOINLINE int snprintf_dumps(cdk_error_t err, size_t buf_size,
+                                   char *buf) {
+  int offset = snprintf(buf, buf_size,
+                        "====== ERROR DUMP ======\n"
+                        "Error code: %d\n"
+                        "Error desc: %s\n"
+                        "------------------------\n"
+                        " Error msg: %s\n"
+                        "------------------------\n"
+                        " Backtrace:\n",
+                        err->code, strerror(err->code), err->msg);
+  for (size_t i = 0; i < err->eframes_len; i++) {
+    offset += snprintf(buf + offset, buf_size - offset, "   [%02d] %s:%s:%d\n",
+                       (int)i, cdk_eframe_file(&err->eframes[i]),
+                       cdk_eframe_func(&err->eframes[i]),
+                       (int)cdk_eframe_line(&err->eframes[i]));
+  }
+  return 0;
+}
+
 // — 5-level plain int return —
 static volatile int __i__ = 0;
 static NOINLINE int int_l1(void) { return __i__++; }
@@ -92,9 +168,23 @@ static inline double ns_since(const struct timespec *a,
 int main(void) {
   const int iters = 1000000;
   struct timespec t0, t1;
-  double ns_err = 0.0, ns_fmt = 0.0, ns_int = 0.0;
+  double ns_err = 0.0, ns_fmt = 0.0, ns_dfmt = 0.0, ns_dread = 0.0,
+         ns_int = 0.0;
+  double ns_cint = 0.0, ns_cstr = 0.0, ns_czero = 0.0;
+  double ns_dump = 0.0, ns_sdump = 0.0, ns_dhash = 0.0;
+  char dump[4096];
   volatile int sink = 0;
 
+#ifdef CDK_ERROR_STATS
+  // Publish live stats, watch them with tools/cdk_error_top.py
+  const char *stats_path = getenv("CDK_ESTATS_PATH");
+  int stats_ret = cdk_estats_open(stats_path ? stats_path : "bench.estats");
+  if (stats_ret) {
+    fprintf(stderr, "cdk_estats_open: %s\n", strerror(stats_ret));
+    return 1;
+  }
+#endif
+
   // measure unformatted errno-trace
   cdk_errno = 0;
   clock_gettime(CLOCK_MONOTONIC, &t0);
@@ -115,6 +205,27 @@ int main(void) {
   }
   clock_gettime(CLOCK_MONOTONIC, &t1);
   ns_fmt = ns_since(&t0, &t1);
+
+  // measure deferred formatted errno-trace, message is never read
+  cdk_errno = 0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int i = 0; i < iters; i++) {
+    sink ^= errd_l5();
+    cdk_errno = 0;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  ns_dfmt = ns_since(&t0, &t1);
+
+  // measure deferred formatted errno-trace with the message read back
+  char msg[CDK_ERROR_FSTR_MAX];
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int i = 0; i < iters; i++) {
+    sink ^= errd_l5();
+    sink ^= cdk_emsg(sizeof(msg), msg);
+    cdk_errno = 0;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  ns_dread = ns_since(&t0, &t1);
 #endif
 
   // measure plain int return
@@ -125,16 +236,89 @@ int main(void) {
   clock_gettime(CLOCK_MONOTONIC, &t1);
   ns_int = ns_since(&t0, &t1);
 
+  // measure construction alone, this is what CDK_ERROR_BTRACE_MAX and
+  // CDK_ERROR_FSTR_MAX could affect
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int i = 0; i < iters; i++) {
+    construct_int();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  ns_cint = ns_since(&t0, &t1);
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int i = 0; i < iters; i++) {
+    construct_str();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  ns_cstr = ns_since(&t0, &t1);
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int i = 0; i < iters; i++) {
+    construct_zero_fill();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  ns_czero = ns_since(&t0, &t1);
+
+  // measure dumping a 5-level trace
+  err_l5();
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int i = 0; i < iters; i++) {
+    sink ^= cdk_edumps(sizeof(dump), dump);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  ns_dump = ns_since(&t0, &t1);
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int i = 0; i < iters; i++) {
+    sink ^= snprintf_dumps(cdk_errno, sizeof(dump), dump);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  ns_sdump = ns_since(&t0, &t1);
+
+#ifdef CDK_ERROR_FINGERPRINT
+  // dedup key the old way: hash the dump after the fact
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int i = 0; i < iters; i++) {
+    uint64_t hash = 0xCBF29CE484222325u; // FNV-1a
+    cdk_edumps(sizeof(dump), dump);
+    for (const char *c = dump; *c; c++) {
+      hash = (hash ^ (unsigned char)*c) * 0x100000001B3u;
+    }
+    sink ^= (int)hash;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  ns_dhash = ns_since(&t0, &t1);
+#endif
+  cdk_errno = 0;
+
+  printf("config: CDK_ERROR_BTRACE_MAX=%d CDK_ERROR_FSTR_MAX=%d "
+         "sizeof(struct cdk_Error)=%zu\n",
+         CDK_ERROR_BTRACE_MAX, CDK_ERROR_FSTR_MAX, sizeof(struct cdk_Error));
   printf("5-lvl errno-trace avg:     %.1f ns\n", ns_err / iters);
 #ifndef CDK_ERROR_OPTIMIZE
   printf("5-lvl fmt errno-trace avg: %.1f ns\n", ns_fmt / iters);
+  printf("5-lvl dfmt errno-trace avg: %.1f ns\n", ns_dfmt / iters);
+  printf("5-lvl dfmt + read avg:     %.1f ns\n", ns_dread / iters);
 #else
   printf("5-lvl fmt errno-trace avg: (disabled by CDK_ERROR_OPTIMIZE)\n");
+  printf("5-lvl dfmt errno-trace avg: (disabled by CDK_ERROR_OPTIMIZE)\n");
 #endif
   printf("5-lvl int           avg:   %.1f ns\n", ns_int / iters);
+  printf("int construct       avg:   %.1f ns\n", ns_cint / iters);
+  printf("str construct       avg:   %.1f ns\n", ns_cstr / iters);
+  printf("zero-fill construct avg:   %.1f ns\n", ns_czero / iters);
+  printf("5-lvl dump          avg:   %.1f ns\n", ns_dump / iters);
+  printf("5-lvl snprintf dump avg:   %.1f ns\n", ns_sdump / iters);
+#ifdef CDK_ERROR_FINGERPRINT
+  printf("5-lvl dump+hash key avg:   %.1f ns (fingerprint: one load)\n",
+         ns_dhash / iters);
+#endif
 
   (void)sink; // keep side effects
   (void)ns_fmt;
+  (void)ns_dhash;
+  (void)ns_dfmt;
+  (void)ns_dread;
 
   return 0;
 }
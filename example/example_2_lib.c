@@ -2,3 +2,12 @@
 
 _Thread_local cdk_error_t cdk_errno = NULL;
 _Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+#ifdef CDK_ERROR_RECORDER
+struct cdk_ERecorder cdk_erecorder = {0};
+_Thread_local struct cdk_ERing *cdk_ering = NULL;
+#endif
+
+#ifdef CDK_ERROR_STATS
+struct cdk_EStats *cdk_estats = NULL;
+#endif
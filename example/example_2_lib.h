@@ -1,8 +1,12 @@
 #ifndef ERROR_H
 #define ERROR_H
 
+#ifndef CDK_ERROR_FSTR_MAX
 #define CDK_ERROR_FSTR_MAX 512
+#endif
+#ifndef CDK_ERROR_BTRACE_MAX
 #define CDK_ERROR_BTRACE_MAX 32
+#endif
 #include "cdk_error.h"
 
 #endif
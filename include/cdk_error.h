@@ -30,12 +30,52 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <float.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <threads.h>
+#if defined(CDK_ERROR_RECORDER) || defined(CDK_ERROR_COUNTERS) ||             \
+    defined(CDK_ERROR_STATS) || defined(CDK_ERROR_POOL) ||                     \
+    defined(CDK_ERROR_LOG) || defined(CDK_ERROR_LAZY)
+#include <stdatomic.h>
+#endif
+#if defined(CDK_ERROR_RECORDER) || defined(CDK_ERROR_STATS) ||                \
+    defined(CDK_ERROR_LOG)
+#include <time.h>
+#endif
+#ifdef CDK_ERROR_STATS
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+#if defined(CDK_ERROR_COUNTERS) || defined(CDK_ERROR_LAZY)
+#include <stdlib.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+#ifdef CDK_ERROR_BTRACE_FP
+#include <dlfcn.h>
+#include <pthread.h>
+#if defined(__FreeBSD__) || defined(__DragonFly__)
+#include <pthread_np.h>
+#endif
+#endif
+
+#ifdef __cplusplus
+// C++ code uses the compiled library, see cdk_error.hpp.
+#ifndef _Thread_local
+#define _Thread_local thread_local
+#endif
+#ifndef _Static_assert
+#define _Static_assert static_assert
+#endif
+extern "C" {
+#endif
 
 //
 ////
@@ -83,11 +123,299 @@
 #ifndef CDK_DISABLE_ERRNO_API
 #endif
 
+/*
+ * Dumps describe errno values from a static table holding every Linux value
+ * on Linux and the values POSIX requires elsewhere. Defining
+ * `CDK_ERRNO_POSIX` picks the POSIX table on Linux too. Values missing from
+ * the table are dumped as "Unknown error N".
+ */
+#ifndef CDK_ERRNO_POSIX
+#endif
+
 #ifdef CDK_ERROR_OPTIMIZE
 #undef CDK_ERROR_BTRACE_MAX
 #define CDK_ERROR_BTRACE_MAX 1
 #endif
 
+/*
+ * Frames added past `CDK_ERROR_BTRACE_MAX` are dropped, so deep traces lose
+ * their outermost frames. Defining `CDK_ERROR_BTRACE_RING` pins the first
+ * `CDK_ERROR_BTRACE_PIN` frames, starting with the origin, and keeps the rest
+ * in a ring of the most recent frames. Dumps tell how many frames were
+ * omitted in between. It has no effect with CDK_ERROR_OPTIMIZE.
+ */
+#ifndef CDK_ERROR_BTRACE_RING
+#endif
+
+#ifdef CDK_ERROR_OPTIMIZE
+#undef CDK_ERROR_BTRACE_RING
+#endif
+
+#ifndef CDK_ERROR_BTRACE_PIN
+#define CDK_ERROR_BTRACE_PIN (CDK_ERROR_BTRACE_MAX / 2)
+#endif
+
+/*
+ * Defining `CDK_ERROR_BTRACE_FP` to a depth makes every raise also store the
+ * return addresses of up to that many callers, found by following saved
+ * frame pointers. Functions that do not wrap show up there too. Needs code
+ * built with -fno-omit-frame-pointer, see the Native backtrace section.
+ */
+#ifndef CDK_ERROR_BTRACE_FP
+#endif
+
+/*
+ * Native frames are symbolized with dladdr, which may take the lock of the
+ * dynamic loader, so dumps of errors holding them are not async-signal-safe.
+ * Defining `CDK_ERROR_BTRACE_FP_RAW` prints bare return addresses instead and
+ * keeps every dump safe in crash handlers.
+ */
+#ifndef CDK_ERROR_BTRACE_FP_RAW
+#endif
+
+/*
+ * Formatted messages are written into the error, to a buffer of
+ * `CDK_ERROR_FSTR_MAX` bytes that short messages leave mostly unused.
+ * Defining `CDK_ERROR_FSTR_INLINE` as a smaller size keeps only that many
+ * bytes in the error. Longer messages spill into `cdk_emsg_spill`, a
+ * per-thread buffer of `CDK_ERROR_FSTR_MAX` bytes defined next to
+ * `cdk_errno`. A spilled message is read in full on its thread until the next
+ * one spills there; elsewhere and after that, its inline prefix is read.
+ * Arguments of deferred messages stay in the error and are truncated to it.
+ * It has no effect with CDK_ERROR_OPTIMIZE.
+ */
+#ifndef CDK_ERROR_FSTR_INLINE
+#endif
+
+#ifdef CDK_ERROR_OPTIMIZE
+#undef CDK_ERROR_FSTR_INLINE
+#endif
+
+#ifdef CDK_ERROR_FSTR_INLINE
+#define CDK_ERROR__MSG_BUF CDK_ERROR_FSTR_INLINE
+#else
+#define CDK_ERROR__MSG_BUF CDK_ERROR_FSTR_MAX
+#endif
+
+/*
+ * The library is header-only, every function is `static inline` and compiled
+ * into each translation unit using it. Defining `CDK_ERROR_LIBRARY` keeps only
+ * declarations of raise, wrap and dump functions and of the pool, lazy errno,
+ * async log and counter snapshot, with inline fast-path pieces and macros;
+ * definitions are then linked from the `cdk_error` library, built
+ * from src/cdk_error.c, or from one of your files that defines
+ * `CDK_ERROR_IMPLEMENTATION` before including this header. Both sides have to
+ * be compiled with the same config macros.
+ */
+#ifndef CDK_ERROR_LIBRARY
+#endif
+
+#ifndef CDK_ERROR_IMPLEMENTATION
+#endif
+
+#if defined(CDK_ERROR_IMPLEMENTATION) && !defined(CDK_ERROR_LIBRARY)
+#define CDK_ERROR_LIBRARY
+#endif
+
+#if !defined(CDK_ERROR_LIBRARY) || defined(CDK_ERROR_IMPLEMENTATION)
+#define CDK_ERROR__DEFINE
+#endif
+
+#ifdef CDK_ERROR_LIBRARY
+#ifdef __GNUC__
+#define CDK_ERROR_API __attribute__((visibility("default")))
+#else
+#define CDK_ERROR_API
+#endif
+#else
+#define CDK_ERROR_API static inline
+#endif
+
+/*
+ * Raising and wrapping errors is the slow path. Constructors and wraps are
+ * emitted out of line and marked cold, so a callsite keeps only the call and
+ * the compiler moves paths that raise errors to `.text.unlikely`. Defining
+ * `CDK_ERROR_NO_OUTLINE` lets them be inlined again, unless they come from
+ * the compiled library.
+ */
+#if defined(__GNUC__) && !defined(CDK_ERROR_NO_OUTLINE)
+#define CDK_ERROR__COLD __attribute__((cold, noinline, unused))
+#else
+#define CDK_ERROR__COLD
+#endif
+
+#ifdef CDK_ERROR_LIBRARY
+#define CDK_ERROR_COLD CDK_ERROR_API CDK_ERROR__COLD
+#elif defined(__GNUC__) && !defined(CDK_ERROR_NO_OUTLINE)
+#define CDK_ERROR_COLD static CDK_ERROR__COLD
+#else
+#define CDK_ERROR_COLD static inline
+#endif
+
+/*
+ * TLS model of `cdk_errno`, `cdk_hidden_errno` and the other thread-local
+ * state, as a string like "initial-exec". Code compiled with -fPIC uses the
+ * general-dynamic model, where reaching a thread-local may call
+ * __tls_get_addr. "initial-exec" makes it a load from the thread pointer, but
+ * a shared object built with it takes static TLS space, which is scarce for
+ * objects loaded with dlopen. Definitions need the attribute too, GCC
+ * compiles the defining file with the default model otherwise:
+ *
+ *   _Thread_local cdk_error_t cdk_errno CDK_ERROR_TLS = NULL;
+ *   _Thread_local struct cdk_Error cdk_hidden_errno CDK_ERROR_TLS = {0};
+ */
+#ifndef CDK_ERROR_TLS_MODEL
+#endif
+
+#if defined(CDK_ERROR_TLS_MODEL) && defined(__GNUC__)
+#define CDK_ERROR_TLS __attribute__((tls_model(CDK_ERROR_TLS_MODEL)))
+#else
+#define CDK_ERROR_TLS
+#endif
+
+/*
+ * Global state belongs to the program: neither this header nor the compiled
+ * library defines any, in either mode, besides the private per-thread stack
+ * bounds of CDK_ERROR_BTRACE_FP. Define what the enabled features need, once,
+ * in one C file of the program:
+ *
+ *   // Errno API, cdk_hidden_errno unless CDK_ERROR_LAZY
+ *   _Thread_local cdk_error_t cdk_errno CDK_ERROR_TLS = NULL;
+ *   _Thread_local struct cdk_Error cdk_hidden_errno CDK_ERROR_TLS = {0};
+ *   // CDK_ERROR_LAZY
+ *   struct cdk_ELazy cdk_elazy = {0};
+ *   _Thread_local struct cdk_Error *cdk_lazy_errno CDK_ERROR_TLS = NULL;
+ *   // CDK_ERROR_FSTR_INLINE
+ *   _Thread_local struct cdk_EMsgSpill cdk_emsg_spill CDK_ERROR_TLS = {0};
+ *   // CDK_ERROR_RECORDER
+ *   struct cdk_ERecorder cdk_erecorder = {0};
+ *   _Thread_local struct cdk_ERing *cdk_ering CDK_ERROR_TLS = NULL;
+ *   // CDK_ERROR_STATS
+ *   struct cdk_EStats *cdk_estats = NULL;
+ */
+
+// Branch hints for error checks: `if (cdk_unlikely(ret < 0))`.
+#define cdk_likely(x) __builtin_expect(!!(x), 1)
+#define cdk_unlikely(x) __builtin_expect(!!(x), 0)
+
+/*
+ * Defining `CDK_ERROR_DEFER_FSTR` makes cdk_errorf and cdk_errnof create
+ * deferred formatted errors, see cdk_error_dfstr.
+ */
+#ifndef CDK_ERROR_DEFER_FSTR
+#endif
+
+/*
+ * Defining `CDK_ERROR_FINGERPRINT` keeps a hash of code and path in every
+ * error, see the Fingerprint section.
+ */
+#ifndef CDK_ERROR_FINGERPRINT
+#endif
+
+/*
+ * Defining `CDK_ERROR_SAMPLE` records full traces only for 1 in N errors, see
+ * the Sampling section.
+ */
+#ifndef CDK_ERROR_SAMPLE
+#endif
+
+/*
+ * Defining `CDK_ERROR_STATS` publishes error counts and recent traces in a
+ * memory mapped file, see the Live stats section.
+ */
+#ifndef CDK_ERROR_STATS
+#endif
+
+/*
+ * Defining `CDK_ERROR_POOL` adds a fixed-capacity pool of errors addressed by
+ * generation-checked handles, see the Pool section.
+ */
+#ifndef CDK_ERROR_POOL
+#endif
+
+/*
+ * Defining `CDK_ERROR_LAZY` keeps only pointers in thread-local storage, the
+ * error behind the errno API is taken from a shared pool on the first error
+ * of a thread, see the Lazy errno section. It implies `CDK_ERROR_POOL`.
+ */
+#ifndef CDK_ERROR_LAZY
+#endif
+
+#if defined(CDK_ERROR_LAZY) && !defined(CDK_ERROR_POOL)
+#define CDK_ERROR_POOL
+#endif
+
+/*
+ * Defining `CDK_ERROR_LOG` adds a queue of errors written out by a background
+ * thread, see the Async log section.
+ */
+#ifndef CDK_ERROR_LOG
+#endif
+
+/*
+ * Defining `CDK_ERROR_CAUSE` lets an error be translated to another code while
+ * keeping the errors it was translated from, see the Causes section. Up to
+ * `CDK_ECAUSE_MAX` causes and `CDK_ECAUSE_BUF` bytes of their messages are
+ * kept inline in the error.
+ */
+#ifndef CDK_ERROR_CAUSE
+#endif
+
+#ifndef CDK_ECAUSE_MAX
+#define CDK_ECAUSE_MAX 4
+#endif
+
+#ifndef CDK_ECAUSE_BUF
+#define CDK_ECAUSE_BUF 128
+#endif
+
+/*
+ * Defining `CDK_ERROR_FIELDS` lets up to `CDK_EFIELDS_MAX` typed key/value
+ * fields be attached to an error, see the Fields section. Byte spans keep up
+ * to `CDK_EFIELD_BYTES` bytes.
+ */
+#ifndef CDK_ERROR_FIELDS
+#endif
+
+#ifndef CDK_EFIELDS_MAX
+#define CDK_EFIELDS_MAX 8
+#endif
+
+#ifndef CDK_EFIELD_BYTES
+#define CDK_EFIELD_BYTES 16
+#endif
+
+/*
+ * Defining `CDK_ERROR_COUNTERS` gives every raising callsite its own counter,
+ * see the Counters section.
+ */
+#ifndef CDK_ERROR_COUNTERS
+#endif
+
+/*
+ * Defining `CDK_ERROR_RECORDER` keeps the last errors of every thread in a
+ * per-thread ring, see the Flight recorder section.
+ */
+#ifndef CDK_ERROR_RECORDER
+#endif
+
+/*
+ * Defining `CDK_ERROR_DOMAINS` tags every code with a 16-bit domain, so
+ * libraries can raise their own codes next to errno values and dumps tell
+ * them apart, see the Domains section.
+ */
+#ifndef CDK_ERROR_DOMAINS
+#endif
+
+/*
+ * Defining `CDK_ERROR_CALLSITE` makes every error raising or wrapping
+ * expansion emit one `static const struct cdk_ECallsite` and store only a
+ * pointer to it in the frame. File, function and line are read from the
+ * descriptor when the error is dumped.
+ */
+#ifndef CDK_ERROR_CALLSITE
+#endif
+
 /******************************************************************************
  *                             Data types *
  ******************************************************************************/
@@ -99,9 +427,27 @@ enum cdk_ErrorType {
   cdk_ErrorType_STR,
 #ifndef CDK_ERROR_OPTIMIZE
   cdk_ErrorType_FSTR,
+  cdk_ErrorType_DFSTR,
 #endif
 };
 
+#ifdef CDK_ERROR_CALLSITE
+/**
+ * Callsite descriptor, one per error raising or wrapping expansion.
+ */
+struct cdk_ECallsite {
+  const char *file;
+  const char *func;
+  uint32_t line;
+};
+
+/**
+ * Error frame object.
+ */
+struct cdk_EFrame {
+  const struct cdk_ECallsite *site;
+};
+#else
 /**
  * Error frame object.
  */
@@ -110,220 +456,4896 @@ struct cdk_EFrame {
   const char *func;
   uint32_t line;
 };
+#endif
 
+#ifdef CDK_ERROR_CAUSE
 /**
- * Common error object.
+ * Error replaced by a translation, see the Causes section.
  */
-struct cdk_Error {
-  enum cdk_ErrorType type;                         // Error type
-  uint16_t code;                                   // Status code
-  const char *msg;                                 // String msg, can be NULL
-  struct cdk_EFrame eframes[CDK_ERROR_BTRACE_MAX]; // Backtrace frames
-  size_t eframes_len;                              // Backtrace frames length
-
-#ifndef CDK_ERROR_OPTIMIZE
-  char _msg_buf[CDK_ERROR_FSTR_MAX]; // Internal storage for formatted string
+struct cdk_ECause {
+  const char *msg;     // String msg, NULL if copied to the cause buffer
+  uint16_t code;       // Status code
+  int16_t msg_off;     // Offset of copied msg in `_ecause_buf`, -1 if none
+  uint32_t frames_end; // Frames up to this depth belong to this cause
+#ifdef CDK_ERROR_DOMAINS
+  uint16_t domain;     // Domain of `code`
 #endif
 };
+#endif
 
-typedef struct cdk_Error *cdk_error_t;
-
-/******************************************************************************
- *                                 Generic API                                *
- ******************************************************************************/
+#ifdef CDK_ERROR_FIELDS
 /**
- * Create struct cdk_Error of type cdk_ErrorType_INT.
+ * Field type.
  */
-static inline cdk_error_t cdk_error_int(struct cdk_Error *err, uint16_t code,
-                                        const char *file, const char *func,
-                                        int line) {
-  *err = (struct cdk_Error){
-      .type = cdk_ErrorType_INT,
-      .code = code,
-      .eframes = {{.file = file, .func = func, .line = line}},
-      .eframes_len = 1,
-  };
-
-  return err;
+enum cdk_EFieldType {
+  cdk_EFieldType_INT,
+  cdk_EFieldType_UINT,
+  cdk_EFieldType_STR,
+  cdk_EFieldType_BYTES,
 };
 
 /**
- * Create struct cdk_Error of type cdk_ErrorType_STR.
+ * Key/value field of an error, see the Fields section.
  */
-static inline cdk_error_t cdk_error_lstr(struct cdk_Error *err, uint16_t code,
-                                         const char *file, const char *func,
-                                         int line, const char *msg) {
-  *err = (struct cdk_Error){
-      .type = cdk_ErrorType_STR,
-      .code = code,
-      .msg = msg,
-      .eframes = {{.file = file, .func = func, .line = line}},
-      .eframes_len = 1,
+struct cdk_EField {
+  const char *key; // String literal
+  uint8_t type;    // enum cdk_EFieldType
+  uint8_t len;     // Bytes kept in `bytes`
+  uint32_t size;   // Size of the whole span for cdk_EFieldType_BYTES
+  union {
+    int64_t i64;
+    uint64_t u64;
+    const char *str; // String literal or other string outliving the error
+    unsigned char bytes[CDK_EFIELD_BYTES];
   };
-
-  return err;
 };
+#endif
+
+struct cdk_ERing;
+struct cdk_ECounter;
+
+_Static_assert(CDK_ERROR_BTRACE_MAX <= UINT16_MAX, "frame count is 16-bit");
+
+// Number of frames, a byte unless there can be more than 255.
+#if CDK_ERROR_BTRACE_MAX <= UINT8_MAX
+typedef uint8_t cdk_eframes_len_t;
+#else
+typedef uint16_t cdk_eframes_len_t;
+#endif
 
-#ifndef CDK_ERROR_OPTIMIZE
 /**
- * Create struct cdk_Error of type cdk_ErrorType_FSTR.
+ * Common error object.
  */
-static inline cdk_error_t cdk_error_fstr(struct cdk_Error *err, uint16_t code,
-                                         const char *file, const char *func,
-                                         int line, const char *fmt, ...) {
+struct cdk_Error {
+  // Header, written by every raise and read by every wrap and check, shares
+  // the first cacheline with the origin frame.
+  uint8_t type;                  // enum cdk_ErrorType
+  cdk_eframes_len_t eframes_len; // Backtrace frames length
+  uint16_t code;                 // Status code
+#ifdef CDK_ERROR_DOMAINS
+  uint16_t domain; // Domain of `code`, 0 for errno values
+#endif
+#ifdef CDK_ERROR_BTRACE_RING
+  uint32_t eframes_omitted; // Frames overwritten in the ring since the raise
+#endif
+  const char *msg;                                 // String msg, can be NULL
+  struct cdk_EFrame eframes[CDK_ERROR_BTRACE_MAX]; // Backtrace frames
 
-  *err = (struct cdk_Error){
-      .type = cdk_ErrorType_FSTR,
-      .code = code,
-      .eframes = {{.file = file, .func = func, .line = line}},
-      .eframes_len = 1,
-  };
+  // State of optional features, touched only when they are enabled.
+#ifdef CDK_ERROR_FSTR_INLINE
+  uint32_t _msg_spill; // cdk_EMsgSpill generation of a spilled message
+#endif
 
-  va_list args;
-  va_start(args, fmt);
-  int written_bytes =
-      vsnprintf(err->_msg_buf, sizeof(err->_msg_buf), fmt, args);
-  va_end(args);
+#ifdef CDK_ERROR_BTRACE_FP
+  void *epcs[CDK_ERROR_BTRACE_FP]; // Return addresses of callers at raise
+  uint8_t epcs_len;                // Number of return addresses
+#endif
 
-  assert(written_bytes >= 0);
+#ifdef CDK_ERROR_RECORDER
+  struct cdk_ERing *_ering; // Ring holding record of this error
+  uint64_t _erecord;        // Index of that record
+#endif
 
-  err->msg = err->_msg_buf;
+#ifdef CDK_ERROR_COUNTERS
+  struct cdk_ECounter *_ecounter; // Counter of the raising callsite
+  uint8_t _etopped;               // Already counted as dumped
+#endif
 
-  return err;
-};
+#ifdef CDK_ERROR_STATS
+  uint64_t _estrace; // Sequence number of trace in the stats file, 0 if none
 #endif
 
-/**
- * Dump all struct cdk_XError to string.
- */
-static inline int cdk_error_dumps(cdk_error_t err, size_t buf_size, char *buf) {
-  size_t offset = 0;
-  int written;
-
-  written = snprintf(buf, buf_size,
-                     "====== ERROR DUMP ======\n"
-                     "Error code: %d\n"
-                     "Error desc: %s\n",
-                     err->code, strerror(err->code));
-  if (written < 0 || (size_t)written >= buf_size) {
-    return ENOBUFS;
-  }
-  offset += written;
+#ifdef CDK_ERROR_FINGERPRINT
+  uint64_t efingerprint; // Hash of code and path, see Fingerprint section
+#endif
 
-  if (err->type > cdk_ErrorType_INT) {
-    written =
-        snprintf(buf + offset, buf_size - offset, "------------------------\n");
-    if (written < 0 || (size_t)written >= buf_size) {
-      return ENOBUFS;
-    }
-    offset += written;
-  }
+#ifdef CDK_ERROR_SAMPLE
+  uint32_t esuppressed; // Traces suppressed at origin since last full one
+  uint8_t _enotrace;    // Trace of this error is not sampled
+  uint32_t _ewraps;     // Wraps of this error if its trace is not sampled
+#endif
 
-  switch (err->type) {
-  case cdk_ErrorType_STR:
-    written =
-        snprintf(buf + offset, buf_size - offset, " Error msg: %s\n", err->msg);
-    if (written < 0 || (size_t)written >= buf_size - offset) {
-      return ENOBUFS;
-    }
-    offset += written;
-    break;
+#ifdef CDK_ERROR_FIELDS
+  struct cdk_EField efields[CDK_EFIELDS_MAX]; // Key/value context
+  uint8_t efields_len;                        // Number of fields
+#endif
+
+#ifdef CDK_ERROR_CAUSE
+  struct cdk_ECause ecauses[CDK_ECAUSE_MAX]; // Translated errors, root first
+  uint16_t ecauses_len;                      // Number of causes
+  uint16_t _ecause_buf_len;                  // Bytes of `_ecause_buf` in use
+  char _ecause_buf[CDK_ECAUSE_BUF];          // Copied messages of causes
+#endif
 
 #ifndef CDK_ERROR_OPTIMIZE
-  case cdk_ErrorType_FSTR:
-    written = snprintf(buf + offset, buf_size - offset, " Error msg: %.*s\n",
-                       (int)sizeof(err->_msg_buf), err->msg);
-    if (written < 0 || (size_t)written >= buf_size - offset) {
-      return ENOBUFS;
-    }
-    offset += written;
-    break;
+  char _msg_buf[CDK_ERROR__MSG_BUF]; // Internal storage for formatted string
 #endif
-  default:;
-  }
+};
 
-  written =
-      snprintf(buf + offset, buf_size - offset, "------------------------\n");
-  if (written < 0 || (size_t)written >= buf_size - offset) {
-    return ENOBUFS;
-  }
-  offset += written;
+typedef struct cdk_Error *cdk_error_t;
 
-  written = snprintf(buf + offset, buf_size - offset, " Backtrace:\n");
-  if (written < 0 || (size_t)written >= buf_size - offset) {
-    return ENOBUFS;
-  }
-  offset += written;
+/*
+ * Code taken by constructors. With CDK_ERROR_DOMAINS it holds the domain in
+ * its upper 16 bits, see CDK_ECODE.
+ */
+#ifdef CDK_ERROR_DOMAINS
+typedef uint32_t cdk_ecode_t;
 
-  for (int i = 0; i < err->eframes_len; i++) {
-    written = snprintf(buf + offset, buf_size - offset, "   [%02d] %s:%s:%d\n",
-                       i, err->eframes[i].file, err->eframes[i].func,
-                       err->eframes[i].line);
-    if (written < 0 || (size_t)written >= buf_size - offset) {
-      return ENOBUFS;
-    }
-    offset += written;
-  }
+#define CDK_ECODE(domain, value)                                               \
+  ((cdk_ecode_t)(domain) << 16 | (uint16_t)(value))
+#else
+typedef uint16_t cdk_ecode_t;
+#endif
 
+/**
+ * Domain of the error's code, 0 for errno values.
+ */
+static inline uint16_t cdk_error_domain(const struct cdk_Error *err) {
+#ifdef CDK_ERROR_DOMAINS
+  return err->domain;
+#else
+  (void)err;
   return 0;
+#endif
 }
-static inline void cdk_error_add_frame(cdk_error_t err,
-                                       struct cdk_EFrame *frame) {
-  if (err->eframes_len >= CDK_ERROR_BTRACE_MAX) {
-    return;
-  }
-  err->eframes[err->eframes_len++] = *frame;
+
+/**
+ * Code of the error with its domain, as passed to the constructor.
+ */
+static inline cdk_ecode_t cdk_error_code(const struct cdk_Error *err) {
+#ifdef CDK_ERROR_DOMAINS
+  return CDK_ECODE(err->domain, err->code);
+#else
+  return err->code;
+#endif
 }
 
-#ifndef CDK_ERROR_OPTIMIZE
-#define cdk_error_wrap(err)                                                    \
-  ({                                                                           \
-    cdk_error_add_frame(err, &(struct cdk_EFrame){.file = __FILE_NAME__,       \
-                                                  .func = __func__,            \
-                                                  .line = __LINE__});          \
-    err;                                                                       \
-  })
+#ifdef CDK_ERROR_CAUSE
+/**
+ * Code of a cause with its domain.
+ */
+static inline cdk_ecode_t cdk_ecause__code(const struct cdk_ECause *cause) {
+#ifdef CDK_ERROR_DOMAINS
+  return CDK_ECODE(cause->domain, cause->code);
 #else
-#define cdk_error_wrap(err)
+  return cause->code;
+#endif
+}
 #endif
 
-#define cdk_error_return(ret, err)                                             \
+#ifdef CDK_ERROR_FSTR_INLINE
+_Static_assert(CDK_ERROR_FSTR_INLINE > 1 &&
+                   CDK_ERROR_FSTR_INLINE < CDK_ERROR_FSTR_MAX,
+               "inline message buffer must be smaller than CDK_ERROR_FSTR_MAX");
+
+/**
+ * Per-thread buffer of formatted messages longer than CDK_ERROR_FSTR_INLINE,
+ * `cdk_emsg_spill` is defined by the program (see global state above).
+ */
+struct cdk_EMsgSpill {
+  uint32_t gen; // Incremented by every spill, error keeps it in `_msg_spill`
+  char buf[CDK_ERROR_FSTR_MAX];
+};
+
+_Thread_local extern struct cdk_EMsgSpill cdk_emsg_spill CDK_ERROR_TLS;
+#endif
+
+#ifdef CDK_ERROR_BTRACE_RING
+_Static_assert(CDK_ERROR_BTRACE_PIN > 0 &&
+                   CDK_ERROR_BTRACE_PIN < CDK_ERROR_BTRACE_MAX,
+               "ring needs pinned and ring frames");
+
+#define CDK_ERROR__BTRACE_RING (CDK_ERROR_BTRACE_MAX - CDK_ERROR_BTRACE_PIN)
+#endif
+
+/**
+ * Number of frames added to the error since it was raised, including frames
+ * omitted from the backtrace ring.
+ */
+static inline size_t cdk_error_depth(const struct cdk_Error *err) {
+#ifdef CDK_ERROR_BTRACE_RING
+  return err->eframes_len + err->eframes_omitted;
+#else
+  return err->eframes_len;
+#endif
+}
+
+/**
+ * Get frame `i` in the order frames were added, 0 being the origin. Returns
+ * NULL if the frame was omitted from the backtrace ring or `i` is out of range.
+ */
+static inline const struct cdk_EFrame *
+cdk_error_frame(const struct cdk_Error *err, size_t i) {
+#ifdef CDK_ERROR_BTRACE_RING
+  if (i >= CDK_ERROR_BTRACE_PIN) {
+    if (i < CDK_ERROR_BTRACE_PIN + (size_t)err->eframes_omitted ||
+        i >= cdk_error_depth(err)) {
+      return NULL;
+    }
+    return &err->eframes[CDK_ERROR_BTRACE_PIN +
+                         (i - CDK_ERROR_BTRACE_PIN) % CDK_ERROR__BTRACE_RING];
+  }
+#endif
+  return i < err->eframes_len ? &err->eframes[i] : NULL;
+}
+
+/******************************************************************************
+ *                                 Callsites                                  *
+ ******************************************************************************/
+#ifdef CDK_ERROR_CALLSITE
+#if defined(__ELF__)
+/*
+ * On ELF targets descriptors are collected in the `cdk_ecallsites` section, so
+ * each one can also be named by its 32-bit index in that table.
+ */
+#define CDK_ECALLSITE_ATTR                                                     \
+  __attribute__((section("cdk_ecallsites"), used,                             \
+                 aligned(__alignof__(struct cdk_ECallsite))))
+
+extern const struct cdk_ECallsite __start_cdk_ecallsites[]
+    __attribute__((weak));
+extern const struct cdk_ECallsite __stop_cdk_ecallsites[]
+    __attribute__((weak));
+
+/**
+ * Get 32-bit ID of a callsite, an index into `cdk_ecallsites` section.
+ */
+static inline uint32_t cdk_ecallsite_id(const struct cdk_ECallsite *site) {
+  return (uint32_t)(site - __start_cdk_ecallsites);
+}
+
+/**
+ * Get callsite by its 32-bit ID, NULL if the ID is out of range.
+ */
+static inline const struct cdk_ECallsite *cdk_ecallsite_get(uint32_t id) {
+  if (id >= (size_t)(__stop_cdk_ecallsites - __start_cdk_ecallsites)) {
+    return NULL;
+  }
+  return &__start_cdk_ecallsites[id];
+}
+#else
+#define CDK_ECALLSITE_ATTR
+#endif
+
+/**
+ * Pointer to callsite descriptor of the current line.
+ */
+#define CDK_ECALLSITE()                                                        \
+  ({                                                                           \
+    static const struct cdk_ECallsite _cdk_site CDK_ECALLSITE_ATTR = {         \
+        .file = __FILE_NAME__, .func = __func__, .line = __LINE__};            \
+    &_cdk_site;                                                                \
+  })
+
+#define CDK_EFRAME_HERE() ((struct cdk_EFrame){.site = CDK_ECALLSITE()})
+
+// Location parameters taken by error constructors.
+#define CDK_ERROR_LOC_PARAMS const struct cdk_ECallsite *site
+#define CDK_ERROR_LOC_FRAME ((struct cdk_EFrame){.site = site})
+#define CDK_ERROR_LOC() CDK_ECALLSITE()
+
+static inline const char *cdk_eframe_file(const struct cdk_EFrame *frame) {
+  return frame->site->file;
+}
+static inline const char *cdk_eframe_func(const struct cdk_EFrame *frame) {
+  return frame->site->func;
+}
+static inline uint32_t cdk_eframe_line(const struct cdk_EFrame *frame) {
+  return frame->site->line;
+}
+#else
+#define CDK_EFRAME_HERE()                                                      \
+  ((struct cdk_EFrame){                                                        \
+      .file = __FILE_NAME__, .func = __func__, .line = __LINE__})
+
+// Location parameters taken by error constructors.
+#define CDK_ERROR_LOC_PARAMS const char *file, const char *func, int line
+#define CDK_ERROR_LOC_FRAME                                                    \
+  ((struct cdk_EFrame){.file = file, .func = func, .line = line})
+#define CDK_ERROR_LOC() __FILE_NAME__, __func__, __LINE__
+
+static inline const char *cdk_eframe_file(const struct cdk_EFrame *frame) {
+  return frame->file;
+}
+static inline const char *cdk_eframe_func(const struct cdk_EFrame *frame) {
+  return frame->func;
+}
+static inline uint32_t cdk_eframe_line(const struct cdk_EFrame *frame) {
+  return frame->line;
+}
+#endif
+
+#if (defined(CDK_ERROR_RECORDER) || defined(CDK_ERROR_LAZY)) &&                \
+    defined(CDK_ERROR__DEFINE)
+/**
+ * Create `key` with destructor `dtor` once per program, racing threads wait
+ * for the winner. `state` goes from 0 through 1 while creating to 2, or to 3
+ * if creation failed. Returns the final state.
+ */
+static inline int cdk_error__tss_once(_Atomic int *state, tss_t *key,
+                                      tss_dtor_t dtor) {
+  int current = atomic_load_explicit(state, memory_order_acquire);
+
+  if (current < 2) {
+    int expected = 0;
+    if (atomic_compare_exchange_strong(state, &expected, 1)) {
+      current = tss_create(key, dtor) == thrd_success ? 2 : 3;
+      atomic_store_explicit(state, current, memory_order_release);
+    }
+    while ((current = atomic_load_explicit(state, memory_order_acquire)) ==
+           1) {
+      thrd_yield();
+    }
+  }
+
+  return current;
+}
+#endif
+
+/******************************************************************************
+ *                              Flight recorder                               *
+ ******************************************************************************/
+/*
+ * With `CDK_ERROR_RECORDER` every thread appends a compact record (code,
+ * callsite IDs of the trace, timestamp) to its own ring each time an error is
+ * raised, and extends the record each time the error is wrapped. Rings are
+ * single-producer/single-consumer: a collector thread drains all of them
+ * with cdk_erecorder_drain without taking any lock. Old records are
+ * overwritten when a ring is full.
+ *
+ * Requires CDK_ERROR_CALLSITE. `cdk_erecorder` and `cdk_ering` are defined by
+ * the program, like the rest of the global state.
+ */
+#ifdef CDK_ERROR_RECORDER
+#if !defined(CDK_ERROR_CALLSITE) || !defined(__ELF__)
+#error "CDK_ERROR_RECORDER requires CDK_ERROR_CALLSITE on an ELF target"
+#endif
+
+#ifndef CDK_ERECORDER_RING
+#define CDK_ERECORDER_RING 64
+#endif
+
+#ifndef CDK_ERECORDER_FRAMES
+#define CDK_ERECORDER_FRAMES 8
+#endif
+
+#ifndef CDK_ERECORDER_THREADS
+#define CDK_ERECORDER_THREADS 256
+#endif
+
+// Timestamp source, TSC ticks on x86 and nanoseconds elsewhere.
+#ifndef CDK_ERECORDER_CLOCK
+#if defined(__x86_64__) || defined(__i386__)
+#define CDK_ERECORDER_CLOCK() __builtin_ia32_rdtsc()
+#else
+#define CDK_ERECORDER_CLOCK() cdk_erecorder__clock()
+static inline uint64_t cdk_erecorder__clock(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#endif
+#endif
+
+/**
+ * Compact error record.
+ */
+struct cdk_ERecord {
+  uint64_t timestamp;                   // CDK_ERECORDER_CLOCK() at raise
+  uint16_t code;                        // Status code
+  uint16_t sites_len;                   // Number of callsite IDs
+  uint32_t sites[CDK_ERECORDER_FRAMES]; // Callsite IDs, origin first
+};
+
+struct cdk_ERingSlot {
+  _Atomic uint64_t seq; // Record index << 1, low bit set while writing
+  struct cdk_ERecord record;
+};
+
+/**
+ * Per-thread ring of records.
+ */
+struct cdk_ERing {
+  // Producer side
+  _Alignas(64) _Atomic uint32_t owned;
+  _Atomic uint64_t head;
+  // Collector side
+  _Alignas(64) uint64_t tail;
+  uint64_t dropped;
+  uint64_t open_seq;
+  uint16_t open_sites_len;
+  struct cdk_ERingSlot slots[CDK_ERECORDER_RING];
+};
+
+/**
+ * All rings of a program.
+ */
+struct cdk_ERecorder {
+  _Atomic int key_state; // 0 none, 1 creating, 2 created, 3 failed
+  tss_t key;             // Releases ring of an exiting thread
+  struct cdk_ERing rings[CDK_ERECORDER_THREADS];
+};
+
+/**
+ * Collector callback. `open` is set for the newest record of a ring, which
+ * may still grow and is delivered again by a later drain if it does.
+ */
+typedef void (*cdk_erecord_cb_t)(void *ctx, uint32_t thread, uint64_t index,
+                                 int open, const struct cdk_ERecord *record);
+
+extern struct cdk_ERecorder cdk_erecorder;
+_Thread_local extern struct cdk_ERing *cdk_ering CDK_ERROR_TLS;
+
+CDK_ERROR_API size_t cdk_erecorder_drain(struct cdk_ERecorder *recorder,
+                                        cdk_erecord_cb_t cb, void *ctx);
+
+#ifdef CDK_ERROR__DEFINE
+static inline void cdk_erecorder__release(void *ring) {
+  atomic_store_explicit(&((struct cdk_ERing *)ring)->owned, 0,
+                        memory_order_release);
+}
+
+/**
+ * Get ring of the current thread, claiming a free one on first use. Returns
+ * NULL if all rings are taken.
+ */
+static inline struct cdk_ERing *cdk_erecorder__ring(void) {
+  struct cdk_ERecorder *recorder = &cdk_erecorder;
+  int state;
+
+  if (cdk_ering) {
+    return cdk_ering;
+  }
+
+  state = cdk_error__tss_once(&recorder->key_state, &recorder->key,
+                              cdk_erecorder__release);
+
+  for (size_t i = 0; i < CDK_ERECORDER_THREADS; i++) {
+    uint32_t expected = 0;
+    if (atomic_compare_exchange_strong(&recorder->rings[i].owned, &expected,
+                                       1)) {
+      cdk_ering = &recorder->rings[i];
+      if (state == 2) {
+        tss_set(recorder->key, cdk_ering);
+      }
+      return cdk_ering;
+    }
+  }
+
+  return NULL;
+}
+
+static inline void cdk_erecorder__begin(struct cdk_ERingSlot *slot,
+                                        uint64_t index) {
+  atomic_store_explicit(&slot->seq, index << 1 | 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+static inline void cdk_erecorder__end(struct cdk_ERingSlot *slot,
+                                      uint64_t index) {
+  atomic_store_explicit(&slot->seq, index << 1, memory_order_release);
+}
+
+/**
+ * Start a new record for freshly raised `err`.
+ */
+static inline void cdk_erecorder__raise(struct cdk_Error *err) {
+  struct cdk_ERing *ring = cdk_erecorder__ring();
+  struct cdk_ERingSlot *slot;
+  uint64_t index;
+
+  err->_ering = ring;
+  if (!ring) {
+    return;
+  }
+
+  index = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  slot = &ring->slots[index % CDK_ERECORDER_RING];
+
+  cdk_erecorder__begin(slot, index);
+  slot->record.timestamp = CDK_ERECORDER_CLOCK();
+  slot->record.code = err->code;
+  slot->record.sites_len = 1;
+  slot->record.sites[0] = cdk_ecallsite_id(err->eframes[0].site);
+  cdk_erecorder__end(slot, index);
+
+  atomic_store_explicit(&ring->head, index + 1, memory_order_release);
+  err->_erecord = index;
+}
+
+/**
+ * Append wrap `frame` to the record of `err`, if this thread owns it and it
+ * was not overwritten yet.
+ */
+static inline void cdk_erecorder__wrap(struct cdk_Error *err,
+                                       const struct cdk_EFrame *frame) {
+  struct cdk_ERing *ring = err->_ering;
+  struct cdk_ERingSlot *slot;
+
+  if (!ring || ring != cdk_ering) {
+    return;
+  }
+
+  slot = &ring->slots[err->_erecord % CDK_ERECORDER_RING];
+  if (atomic_load_explicit(&slot->seq, memory_order_relaxed) !=
+          err->_erecord << 1 ||
+      slot->record.sites_len >= CDK_ERECORDER_FRAMES) {
+    return;
+  }
+
+  cdk_erecorder__begin(slot, err->_erecord);
+  slot->record.sites[slot->record.sites_len++] =
+      cdk_ecallsite_id(frame->site);
+  cdk_erecorder__end(slot, err->_erecord);
+}
+
+/**
+ * Copy record `index` out of `ring`. Returns 0 if it was overwritten or is
+ * being written right now.
+ */
+static inline int cdk_erecorder__read(struct cdk_ERing *ring, uint64_t index,
+                                      struct cdk_ERecord *record) {
+  struct cdk_ERingSlot *slot = &ring->slots[index % CDK_ERECORDER_RING];
+
+  for (int attempt = 0; attempt < 16; attempt++) {
+    uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (seq >> 1 != index) {
+      return 0;
+    }
+    if (seq & 1) {
+      continue;
+    }
+    memcpy(record, &slot->record, sizeof(*record));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == seq) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Pass every record written since the previous drain to `cb`. Must not be
+ * called from more than one thread at a time. Returns number of records
+ * delivered. Records overwritten before they could be drained are counted in
+ * each ring's `dropped`.
+ */
+CDK_ERROR_API size_t cdk_erecorder_drain(struct cdk_ERecorder *recorder,
+                                        cdk_erecord_cb_t cb, void *ctx) {
+  size_t delivered = 0;
+
+  for (uint32_t t = 0; t < CDK_ERECORDER_THREADS; t++) {
+    struct cdk_ERing *ring = &recorder->rings[t];
+    uint64_t head =
+        atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head - ring->tail > CDK_ERECORDER_RING) {
+      // Newest record of the previous drain was already delivered.
+      ring->dropped += head - ring->tail - CDK_ERECORDER_RING -
+                       (ring->open_seq == ring->tail + 1);
+      ring->tail = head - CDK_ERECORDER_RING;
+    }
+
+    for (uint64_t i = ring->tail; i < head; i++) {
+      struct cdk_ERecord record;
+      int open = i + 1 == head;
+
+      if (!cdk_erecorder__read(ring, i, &record)) {
+        ring->dropped += !open && ring->open_seq != i + 1;
+        continue;
+      }
+      if (open) {
+        // Deliver the newest record again only once it grew.
+        if (ring->open_seq == head &&
+            ring->open_sites_len == record.sites_len) {
+          continue;
+        }
+        ring->open_seq = head;
+        ring->open_sites_len = record.sites_len;
+      } else if (ring->open_seq == i + 1 &&
+                 ring->open_sites_len == record.sites_len) {
+        // Already delivered while open and it did not change since.
+        continue;
+      }
+
+      cb(ctx, t, i, open, &record);
+      delivered++;
+    }
+
+    // Keep the newest record, it may still be extended by wraps.
+    ring->tail = head ? head - 1 : 0;
+  }
+
+  return delivered;
+}
+#endif
+#endif
+
+/******************************************************************************
+ *                                  Counters                                  *
+ ******************************************************************************/
+/*
+ * With `CDK_ERROR_COUNTERS` every raise expansion (cdk_errori, cdk_errors,
+ * cdk_errorf, cdk_errord and their errno variants) gets a static counter in
+ * the `cdk_ecounters` section. The linker builds the table, so nothing is
+ * registered at startup. Each counter takes its own cache lines and is
+ * updated with relaxed atomics:
+ *
+ *   - `raised`     how often the callsite fired
+ *   - `wrapped[n]` how many of those errors were wrapped at least n+1 times
+ *   - `top`        how many of those errors were dumped
+ *
+ * An error counts towards `top` once, however often it is dumped. The mark
+ * travels with snapshots, so an error pushed to the async log and dumped by
+ * the caller as well is counted by whichever comes first. Wraps of errors
+ * whose trace CDK_ERROR_SAMPLE left out are counted all the same.
+ */
+#ifdef CDK_ERROR_COUNTERS
+#if !defined(__ELF__)
+#error "CDK_ERROR_COUNTERS requires an ELF target"
+#endif
+
+#ifndef CDK_ECOUNTER_DEPTH
+#define CDK_ECOUNTER_DEPTH 6
+#endif
+
+/**
+ * Counter of a single raising callsite.
+ */
+struct cdk_ECounter {
+  _Alignas(64) _Atomic uint64_t raised;
+  _Atomic uint64_t top;
+  _Atomic uint64_t wrapped[CDK_ECOUNTER_DEPTH];
+  const char *file;
+  const char *func;
+  uint32_t line;
+};
+
+/**
+ * Counter values copied by cdk_ecounters_snapshot.
+ */
+struct cdk_ECounterSnapshot {
+  const struct cdk_ECounter *counter; // Location is in file, func and line
+  uint64_t raised;
+  uint64_t top;
+  uint64_t wrapped[CDK_ECOUNTER_DEPTH];
+};
+
+extern struct cdk_ECounter __start_cdk_ecounters[] __attribute__((weak));
+extern struct cdk_ECounter __stop_cdk_ecounters[] __attribute__((weak));
+
+/**
+ * Pointer to counter of the current line.
+ */
+#define CDK_ECOUNTER()                                                         \
+  ({                                                                           \
+    static struct cdk_ECounter _cdk_counter                                    \
+        __attribute__((section("cdk_ecounters"), used)) = {                    \
+            .file = __FILE_NAME__, .func = __func__, .line = __LINE__};        \
+    &_cdk_counter;                                                             \
+  })
+
+/**
+ * Count raise of `err`, used by the raising macros.
+ */
+#define CDK_ECOUNT(err)                                                        \
+  ({                                                                           \
+    cdk_error_t _cdk_err = (err);                                              \
+    cdk_ecounter__raise(_cdk_err, CDK_ECOUNTER());                             \
+    _cdk_err;                                                                  \
+  })
+
+static inline void cdk_ecounter__raise(struct cdk_Error *err,
+                                       struct cdk_ECounter *counter) {
+  err->_ecounter = counter;
+  atomic_fetch_add_explicit(&counter->raised, 1, memory_order_relaxed);
+}
+
+static inline void cdk_ecounter__wrap(struct cdk_Error *err) {
+  size_t depth = cdk_error_depth(err) - 2;
+
+#ifdef CDK_ERROR_SAMPLE
+  depth += err->_ewraps; // Untraced errors keep only their origin frame
+#endif
+
+  if (err->_ecounter && depth < CDK_ECOUNTER_DEPTH) {
+    atomic_fetch_add_explicit(&err->_ecounter->wrapped[depth], 1,
+                              memory_order_relaxed);
+  }
+}
+
+static inline void cdk_ecounter__top(struct cdk_Error *err) {
+  if (err->_ecounter && !err->_etopped) {
+    err->_etopped = 1;
+    atomic_fetch_add_explicit(&err->_ecounter->top, 1, memory_order_relaxed);
+  }
+}
+
+/**
+ * Number of counters in the program.
+ */
+static inline size_t cdk_ecounters_len(void) {
+  return (size_t)(__stop_cdk_ecounters - __start_cdk_ecounters);
+}
+
+CDK_ERROR_API size_t
+cdk_ecounters_snapshot(size_t snapshots_len,
+                       struct cdk_ECounterSnapshot *snapshots);
+
+#ifdef CDK_ERROR__DEFINE
+static inline int cdk_ecounters__cmp(const void *a, const void *b) {
+  const struct cdk_ECounterSnapshot *x = a, *y = b;
+
+  if (x->raised != y->raised) {
+    return x->raised < y->raised ? 1 : -1;
+  }
+  return x->counter < y->counter ? -1 : x->counter > y->counter;
+}
+
+/**
+ * Copy all counters to `snapshots`, sorted by `raised` from the hottest
+ * callsite. Only the first `snapshots_len` are kept. Returns number of
+ * counters in the program.
+ */
+CDK_ERROR_API size_t
+cdk_ecounters_snapshot(size_t snapshots_len,
+                       struct cdk_ECounterSnapshot *snapshots) {
+  size_t len = cdk_ecounters_len();
+  size_t kept = 0;
+
+  for (size_t i = 0; i < len; i++) {
+    struct cdk_ECounter *counter = &__start_cdk_ecounters[i];
+    struct cdk_ECounterSnapshot snapshot = {
+        .counter = counter,
+        .raised =
+            atomic_load_explicit(&counter->raised, memory_order_relaxed),
+        .top = atomic_load_explicit(&counter->top, memory_order_relaxed),
+    };
+    for (size_t d = 0; d < CDK_ECOUNTER_DEPTH; d++) {
+      snapshot.wrapped[d] =
+          atomic_load_explicit(&counter->wrapped[d], memory_order_relaxed);
+    }
+
+    if (kept < snapshots_len) {
+      snapshots[kept++] = snapshot;
+      if (kept == snapshots_len) {
+        qsort(snapshots, kept, sizeof(*snapshots), cdk_ecounters__cmp);
+      }
+    } else if (snapshots_len &&
+               cdk_ecounters__cmp(&snapshot, &snapshots[kept - 1]) < 0) {
+      // Keep the hottest, insert in place of the coldest kept one.
+      size_t at = kept - 1;
+      while (at > 0 && cdk_ecounters__cmp(&snapshot, &snapshots[at - 1]) < 0) {
+        snapshots[at] = snapshots[at - 1];
+        at--;
+      }
+      snapshots[at] = snapshot;
+    }
+  }
+
+  if (kept < snapshots_len) {
+    qsort(snapshots, kept, sizeof(*snapshots), cdk_ecounters__cmp);
+  }
+
+  return len;
+}
+#endif
+#else
+#define CDK_ECOUNT(err) (err)
+#endif
+
+/******************************************************************************
+ *                                Fingerprint                                 *
+ ******************************************************************************/
+/*
+ * With `CDK_ERROR_FINGERPRINT` every error carries `efingerprint`, a 64-bit
+ * hash of its code and of every frame it passed through, in order. It is
+ * seeded by the constructors and extended in O(1) by each wrap, also past
+ * CDK_ERROR_BTRACE_MAX, so errors that took the same path compare equal by a
+ * single integer. It is built from addresses, so it is only stable within
+ * a process.
+ */
+#ifdef CDK_ERROR_FINGERPRINT
+static inline uint64_t cdk_efingerprint__mix(uint64_t hash, uint64_t value) {
+  // One multiply per step, like FxHash; order of steps matters.
+  return ((hash << 5 | hash >> 59) ^ value) * 0x9E3779B97F4A7C15u;
+}
+
+static inline uint64_t cdk_efingerprint__frame(const struct cdk_EFrame *frame) {
+#ifdef CDK_ERROR_CALLSITE
+  return (uintptr_t)frame->site;
+#else
+  uint64_t func = (uintptr_t)frame->func;
+  return (uintptr_t)frame->file ^ (func << 32 | func >> 32) ^ frame->line;
+#endif
+}
+
+static inline void cdk_efingerprint__raise(struct cdk_Error *err) {
+  err->efingerprint = cdk_efingerprint__mix(
+      cdk_error_code(err), cdk_efingerprint__frame(&err->eframes[0]));
+}
+
+static inline void cdk_efingerprint__wrap(struct cdk_Error *err,
+                                          const struct cdk_EFrame *frame) {
+  err->efingerprint =
+      cdk_efingerprint__mix(err->efingerprint, cdk_efingerprint__frame(frame));
+}
+#endif
+
+/******************************************************************************
+ *                                  Sampling                                  *
+ ******************************************************************************/
+/*
+ * With `CDK_ERROR_SAMPLE` only 1 in N errors raised at a callsite records a
+ * full trace. The others keep their code and origin frame, wrapping them only
+ * bumps the wrap counters of CDK_ERROR_COUNTERS. The flight recorder and
+ * CDK_ERROR_STATS see their raise but none of their wraps. `esuppressed` of
+ * an error tells how many traces of its callsite were suppressed on the
+ * current thread since the previous full one (including itself if it was
+ * suppressed too), dumps report it.
+ *
+ * N is `CDK_ERROR_SAMPLE_RATE(code)`, define it to set a rate per code:
+ *
+ *   #define CDK_ERROR_SAMPLE_RATE(code) ((code) == ECONNREFUSED ? 1000 : 1)
+ *
+ * or pass it per callsite with cdk_errori_sampled, cdk_errors_sampled and
+ * cdk_errorf_sampled. Rates 0 and 1 record every trace.
+ */
+#ifndef CDK_ERROR_SAMPLE_RATE
+#define CDK_ERROR_SAMPLE_RATE(code) 1
+#endif
+
+#ifdef CDK_ERROR_SAMPLE
+/**
+ * Sampling state of a callsite, one per thread.
+ */
+struct cdk_ESampler {
+  uint32_t countdown;  // Errors left to suppress before the next full trace
+  uint32_t suppressed; // Errors suppressed since the last full trace
+};
+
+static inline void cdk_esample__raise(struct cdk_Error *err,
+                                      struct cdk_ESampler *sampler,
+                                      uint32_t rate) {
+  if (sampler->countdown == 0) {
+    err->esuppressed = sampler->suppressed;
+    sampler->suppressed = 0;
+    sampler->countdown = rate > 1 ? rate - 1 : 0;
+    return;
+  }
+
+  sampler->countdown--;
+  err->esuppressed = ++sampler->suppressed;
+  err->_enotrace = 1;
+}
+
+/**
+ * Sample trace of `err` at `rate`, used by the raising macros.
+ */
+#define CDK_ESAMPLE(err, rate)                                                 \
+  ({                                                                           \
+    static _Thread_local struct cdk_ESampler _cdk_sampler CDK_ERROR_TLS;       \
+    cdk_error_t _cdk_serr = (err);                                             \
+    cdk_esample__raise(_cdk_serr, &_cdk_sampler, (rate));                      \
+    _cdk_serr;                                                                 \
+  })
+#else
+#define CDK_ESAMPLE(err, rate) (err)
+#endif
+
+/******************************************************************************
+ *                                Live stats                                  *
+ ******************************************************************************/
+/*
+ * With `CDK_ERROR_STATS` errors are also counted in a memory mapped file that
+ * other processes can read while the program runs (see tools/cdk_error_top.py).
+ * Producers only write to the mapping, there is no I/O on the error path.
+ *
+ * The file is fixed-size and starts with a versioned header giving the offset
+ * and length of each table:
+ *
+ *   - codes   count of raised errors per code
+ *   - sites   count of raised errors per origin frame (open addressing)
+ *   - traces  ring of the most recent traces
+ *
+ * Records with strings are guarded by a sequence number, odd while written.
+ * The mapping pointer `cdk_estats` is defined by the program, like the rest
+ * of the global state, and the file is created with cdk_estats_open. Needs
+ * POSIX declarations, so define `_POSIX_C_SOURCE` (200809L) or `_GNU_SOURCE`
+ * before any include.
+ */
+#ifdef CDK_ERROR_STATS
+#if !defined(__unix__)
+#error "CDK_ERROR_STATS requires a POSIX target"
+#endif
+
+#define CDK_ESTATS_MAGIC "CDKESTAT"
+#define CDK_ESTATS_VERSION 1
+#define CDK_ESTATS_NAME 32
+
+#ifndef CDK_ESTATS_CODES
+#define CDK_ESTATS_CODES 1024
+#endif
+
+#ifndef CDK_ESTATS_SITES
+#define CDK_ESTATS_SITES 512
+#endif
+
+#ifndef CDK_ESTATS_TRACES
+#define CDK_ESTATS_TRACES 64
+#endif
+
+#ifndef CDK_ESTATS_FRAMES
+#define CDK_ESTATS_FRAMES 8
+#endif
+
+// Slots probed for a free site before the raise is counted as `sites_full`.
+#ifndef CDK_ESTATS_PROBES
+#define CDK_ESTATS_PROBES 16
+#endif
+
+/**
+ * Frame as stored in the file, names are truncated and NUL terminated.
+ */
+struct cdk_EStatsFrame {
+  uint32_t line;
+  uint32_t _reserved;
+  char file[CDK_ESTATS_NAME];
+  char func[CDK_ESTATS_NAME];
+};
+
+struct cdk_EStatsSite {
+  _Atomic uint64_t seq;   // Odd while origin is written, 0 if unused
+  _Atomic uint64_t key;   // Origin frame identity, 0 if unused
+  _Atomic uint64_t count; // Raised errors
+  _Atomic uint32_t code;  // Last raised code
+  uint32_t _reserved;
+  struct cdk_EStatsFrame origin;
+};
+
+struct cdk_EStatsTrace {
+  _Atomic uint64_t seq; // (index + 1) * 2, odd while written, 0 if unused
+  uint64_t timestamp;   // Realtime clock in nanoseconds at raise
+  uint32_t code;
+  uint32_t frames_len;
+  struct cdk_EStatsFrame frames[CDK_ESTATS_FRAMES];
+};
+
+struct cdk_EStatsHeader {
+  char magic[8];      // CDK_ESTATS_MAGIC, written last
+  uint32_t version;   // CDK_ESTATS_VERSION
+  uint32_t pid;       // Producing process
+  uint32_t codes_len; // Entries of each table
+  uint32_t sites_len;
+  uint32_t traces_len;
+  uint32_t frames_len;  // Frames per trace
+  uint64_t codes_off;   // Table offsets from start of the file
+  uint64_t sites_off;
+  uint64_t traces_off;
+  uint64_t size;        // Size of the file
+  _Atomic uint64_t other_codes; // Raised errors of domains or code >= codes_len
+  _Atomic uint64_t sites_full;  // Raised errors without a site slot
+  _Atomic uint64_t traces_head; // Index of the next trace
+};
+
+/**
+ * Layout of the stats file.
+ */
+struct cdk_EStats {
+  struct cdk_EStatsHeader header;
+  _Atomic uint64_t codes[CDK_ESTATS_CODES];
+  struct cdk_EStatsSite sites[CDK_ESTATS_SITES];
+  struct cdk_EStatsTrace traces[CDK_ESTATS_TRACES];
+};
+
+// Record layouts are part of the file format.
+_Static_assert(sizeof(struct cdk_EStatsFrame) == 72, "stats frame layout");
+_Static_assert(sizeof(struct cdk_EStatsSite) == 104, "stats site layout");
+_Static_assert(sizeof(struct cdk_EStatsHeader) == 88, "stats header layout");
+
+extern struct cdk_EStats *cdk_estats;
+
+CDK_ERROR_API int cdk_estats_open(const char *path);
+CDK_ERROR_API void cdk_estats_close(void);
+
+#ifdef CDK_ERROR__DEFINE
+/**
+ * Create stats file at `path`, map it and start publishing to it. Returns 0 on
+ * success or errno value.
+ */
+CDK_ERROR_API int cdk_estats_open(const char *path) {
+  struct cdk_EStats *stats;
+  int fd, ret = 0;
+
+  fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return errno;
+  }
+  if (ftruncate(fd, sizeof(*stats)) < 0) {
+    ret = errno;
+    close(fd);
+    return ret;
+  }
+  stats = mmap(NULL, sizeof(*stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+               0);
+  if (stats == MAP_FAILED) {
+    ret = errno;
+  }
+  close(fd);
+  if (ret) {
+    return ret;
+  }
+
+  // Fault all pages in now, not on the error path.
+  memset(stats, 0, sizeof(*stats));
+  stats->header = (struct cdk_EStatsHeader){
+      .version = CDK_ESTATS_VERSION,
+      .pid = (uint32_t)getpid(),
+      .codes_len = CDK_ESTATS_CODES,
+      .sites_len = CDK_ESTATS_SITES,
+      .traces_len = CDK_ESTATS_TRACES,
+      .frames_len = CDK_ESTATS_FRAMES,
+      .codes_off = offsetof(struct cdk_EStats, codes),
+      .sites_off = offsetof(struct cdk_EStats, sites),
+      .traces_off = offsetof(struct cdk_EStats, traces),
+      .size = sizeof(*stats),
+  };
+  atomic_thread_fence(memory_order_release);
+  memcpy(stats->header.magic, CDK_ESTATS_MAGIC, sizeof(stats->header.magic));
+
+  cdk_estats = stats;
+  return 0;
+}
+
+/**
+ * Stop publishing and unmap the stats file. Must not race with errors being
+ * raised or wrapped.
+ */
+CDK_ERROR_API void cdk_estats_close(void) {
+  if (cdk_estats) {
+    munmap(cdk_estats, sizeof(*cdk_estats));
+    cdk_estats = NULL;
+  }
+}
+
+static inline void cdk_estats__name(char *dst, const char *src) {
+  size_t i = 0;
+
+  for (; src && src[i] && i < CDK_ESTATS_NAME - 1; i++) {
+    dst[i] = src[i];
+  }
+  dst[i] = '\0';
+}
+
+static inline void cdk_estats__frame(struct cdk_EStatsFrame *dst,
+                                     const struct cdk_EFrame *frame) {
+  dst->line = cdk_eframe_line(frame);
+  cdk_estats__name(dst->file, cdk_eframe_file(frame));
+  cdk_estats__name(dst->func, cdk_eframe_func(frame));
+}
+
+/**
+ * Identity of an origin frame, never 0.
+ */
+static inline uint64_t cdk_estats__key(const struct cdk_EFrame *frame) {
+  uint64_t key;
+
+#ifdef CDK_ERROR_CALLSITE
+  key = (uintptr_t)frame->site * 0x9E3779B97F4A7C15u;
+#else
+  key = (uintptr_t)frame->file * 0x9E3779B97F4A7C15u;
+  key ^= (uintptr_t)frame->func * 0xC2B2AE3D27D4EB4Fu;
+  key ^= frame->line;
+#endif
+  key ^= key >> 29;
+
+  return key ? key : 1;
+}
+
+static inline void cdk_estats__site(struct cdk_EStats *stats,
+                                    struct cdk_Error *err) {
+  uint64_t key = cdk_estats__key(&err->eframes[0]);
+
+  for (uint64_t i = 0; i < CDK_ESTATS_PROBES; i++) {
+    struct cdk_EStatsSite *site =
+        &stats->sites[(key + i) % CDK_ESTATS_SITES];
+    uint64_t found = atomic_load_explicit(&site->key, memory_order_relaxed);
+
+    if (found == 0) {
+      if (!atomic_compare_exchange_strong(&site->key, &found, key) &&
+          found != key) {
+        continue;
+      }
+      if (found == 0) {
+        // Slot claimed, publish origin under the sequence number.
+        atomic_store_explicit(&site->seq, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        cdk_estats__frame(&site->origin, &err->eframes[0]);
+        atomic_store_explicit(&site->seq, 2, memory_order_release);
+      }
+    } else if (found != key) {
+      continue;
+    }
+
+    atomic_store_explicit(&site->code, cdk_error_code(err),
+                          memory_order_relaxed);
+    atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed);
+    return;
+  }
+
+  atomic_fetch_add_explicit(&stats->header.sites_full, 1,
+                            memory_order_relaxed);
+}
+
+static inline uint64_t cdk_estats__now(void) {
+  struct timespec ts;
+
+#ifdef CLOCK_REALTIME_COARSE
+  // Ages are shown in seconds, a tick resolution is plenty.
+  if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) < 0) {
+    return 0;
+  }
+#else
+  if (!timespec_get(&ts, TIME_UTC)) {
+    return 0;
+  }
+#endif
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static inline struct cdk_EStatsTrace *
+cdk_estats__trace_lock(struct cdk_EStats *stats, uint64_t seq) {
+  struct cdk_EStatsTrace *trace =
+      &stats->traces[(seq / 2 - 1) % CDK_ESTATS_TRACES];
+
+  if (!atomic_compare_exchange_strong(&trace->seq, &seq, seq - 1)) {
+    return NULL;
+  }
+  atomic_thread_fence(memory_order_release);
+  return trace;
+}
+
+/**
+ * Count freshly raised `err` and start its trace.
+ */
+static inline void cdk_estats__raise(struct cdk_Error *err) {
+  struct cdk_EStats *stats = cdk_estats;
+  struct cdk_EStatsTrace *trace;
+  uint64_t index, seq;
+
+  err->_estrace = 0;
+  if (!stats) {
+    return;
+  }
+
+  if (err->code < CDK_ESTATS_CODES && !cdk_error_domain(err)) {
+    atomic_fetch_add_explicit(&stats->codes[err->code], 1,
+                              memory_order_relaxed);
+  } else {
+    atomic_fetch_add_explicit(&stats->header.other_codes, 1,
+                              memory_order_relaxed);
+  }
+  cdk_estats__site(stats, err);
+
+  index = atomic_fetch_add_explicit(&stats->header.traces_head, 1,
+                                    memory_order_relaxed);
+  trace = &stats->traces[index % CDK_ESTATS_TRACES];
+  seq = atomic_load_explicit(&trace->seq, memory_order_relaxed);
+  // Skip the slot if a lapped writer still holds it.
+  if ((seq & 1) || !atomic_compare_exchange_strong(&trace->seq, &seq,
+                                                   (index + 1) * 2 - 1)) {
+    return;
+  }
+  atomic_thread_fence(memory_order_release);
+
+  trace->timestamp = cdk_estats__now();
+  trace->code = cdk_error_code(err);
+  trace->frames_len = 1;
+  cdk_estats__frame(&trace->frames[0], &err->eframes[0]);
+
+  atomic_store_explicit(&trace->seq, (index + 1) * 2, memory_order_release);
+  err->_estrace = (index + 1) * 2;
+}
+
+/**
+ * Append wrap `frame` to the trace of `err`, unless it was overwritten.
+ */
+static inline void cdk_estats__wrap(struct cdk_Error *err,
+                                    const struct cdk_EFrame *frame) {
+  struct cdk_EStats *stats = cdk_estats;
+  struct cdk_EStatsTrace *trace;
+
+  if (!stats || !err->_estrace ||
+      !(trace = cdk_estats__trace_lock(stats, err->_estrace))) {
+    return;
+  }
+
+  if (trace->frames_len < CDK_ESTATS_FRAMES) {
+    cdk_estats__frame(&trace->frames[trace->frames_len++], frame);
+  }
+
+  atomic_store_explicit(&trace->seq, err->_estrace, memory_order_release);
+}
+#endif
+#endif
+
+/******************************************************************************
+ *                                    Pool                                    *
+ ******************************************************************************/
+/*
+ * The errno API keeps one live error per thread. Code holding errors of many
+ * requests at once, like an event loop keeping the error of a failed
+ * connection until its handler runs, takes them from a pool instead. The pool
+ * works on memory given at init and never allocates. Free slots form a
+ * lock-free stack, so acquire and release are O(1) from any thread.
+ *
+ * A handle names a slot and its generation. Releasing a slot bumps the
+ * generation, so stale handles are detected instead of reaching an error that
+ * now belongs to someone else. Pooled errors are plain struct cdk_Error, the
+ * generic API works on them as usual.
+ */
+#ifdef CDK_ERROR_POOL
+typedef uint64_t cdk_epool_handle_t; // Generation << 32 | slot, 0 is invalid
+
+struct cdk_EPoolSlot {
+  struct cdk_Error err;
+  _Atomic uint32_t gen;  // Current generation, odd while acquired
+  _Atomic uint32_t next; // Next free slot + 1, 0 ends the list
+};
+
+struct cdk_EPool {
+  _Atomic uint64_t free;        // ABA tag << 32 | first free slot + 1
+  uint32_t capacity;            // Number of slots
+  struct cdk_EPoolSlot *slots;  // Caller-provided storage
+};
+
+CDK_ERROR_API void cdk_epool_init(struct cdk_EPool *pool, size_t capacity,
+                                  struct cdk_EPoolSlot *slots);
+CDK_ERROR_API cdk_epool_handle_t cdk_epool_acquire(struct cdk_EPool *pool);
+CDK_ERROR_API struct cdk_Error *cdk_epool_get(struct cdk_EPool *pool,
+                                              cdk_epool_handle_t handle);
+CDK_ERROR_API int cdk_epool_release(struct cdk_EPool *pool,
+                                    cdk_epool_handle_t handle);
+
+#ifdef CDK_ERROR__DEFINE
+/**
+ * Set up `pool` over `capacity` slots at `slots`, all of them free. `capacity`
+ * must be below UINT32_MAX.
+ */
+CDK_ERROR_API void cdk_epool_init(struct cdk_EPool *pool, size_t capacity,
+                                  struct cdk_EPoolSlot *slots) {
+  pool->capacity = (uint32_t)capacity;
+  pool->slots = slots;
+  for (uint32_t i = 0; i < pool->capacity; i++) {
+    atomic_init(&slots[i].gen, 0);
+    atomic_init(&slots[i].next, i + 1 < pool->capacity ? i + 2 : 0);
+  }
+  atomic_init(&pool->free, pool->capacity ? 1 : 0);
+}
+
+/**
+ * Take a free error from `pool`. Returns its handle, or 0 if the pool is
+ * exhausted.
+ */
+CDK_ERROR_API cdk_epool_handle_t cdk_epool_acquire(struct cdk_EPool *pool) {
+  uint64_t head = atomic_load_explicit(&pool->free, memory_order_acquire);
+  struct cdk_EPoolSlot *slot;
+  uint32_t gen;
+
+  for (;;) {
+    uint32_t first = (uint32_t)head;
+    uint64_t next;
+
+    if (!first) {
+      return 0;
+    }
+    slot = &pool->slots[first - 1];
+    next = (head >> 32) + 1;
+    next = next << 32 |
+           atomic_load_explicit(&slot->next, memory_order_relaxed);
+    if (atomic_compare_exchange_weak_explicit(&pool->free, &head, next,
+                                              memory_order_acquire,
+                                              memory_order_acquire)) {
+      break;
+    }
+  }
+
+  gen = atomic_load_explicit(&slot->gen, memory_order_relaxed) + 1;
+  atomic_store_explicit(&slot->gen, gen, memory_order_relaxed);
+  return (uint64_t)gen << 32 | (uint32_t)(slot - pool->slots);
+}
+
+/**
+ * Get error named by `handle`, NULL if the handle is stale or invalid.
+ */
+CDK_ERROR_API struct cdk_Error *cdk_epool_get(struct cdk_EPool *pool,
+                                              cdk_epool_handle_t handle) {
+  uint32_t index = (uint32_t)handle;
+
+  if (index >= pool->capacity ||
+      atomic_load_explicit(&pool->slots[index].gen, memory_order_relaxed) !=
+          (uint32_t)(handle >> 32) ||
+      !(handle >> 32 & 1)) {
+    return NULL;
+  }
+  return &pool->slots[index].err;
+}
+
+/**
+ * Return error named by `handle` to `pool`. Returns 0 on success or EINVAL if
+ * the handle is stale or invalid.
+ */
+CDK_ERROR_API int cdk_epool_release(struct cdk_EPool *pool,
+                                    cdk_epool_handle_t handle) {
+  uint32_t index = (uint32_t)handle, gen = (uint32_t)(handle >> 32);
+  struct cdk_EPoolSlot *slot;
+  uint64_t head;
+
+  if (index >= pool->capacity || !(gen & 1)) {
+    return EINVAL;
+  }
+  slot = &pool->slots[index];
+  if (!atomic_compare_exchange_strong_explicit(&slot->gen, &gen, gen + 1,
+                                               memory_order_relaxed,
+                                               memory_order_relaxed)) {
+    return EINVAL;
+  }
+
+  head = atomic_load_explicit(&pool->free, memory_order_relaxed);
+  do {
+    atomic_store_explicit(&slot->next, (uint32_t)head, memory_order_relaxed);
+  } while (!atomic_compare_exchange_weak_explicit(
+      &pool->free, &head, ((head >> 32) + 1) << 32 | (index + 1),
+      memory_order_release, memory_order_relaxed));
+
+  return 0;
+}
+#endif
+#endif
+
+/******************************************************************************
+ *                                 Lazy errno                                 *
+ ******************************************************************************/
+/*
+ * The errno API keeps a whole struct cdk_Error in thread-local storage, set
+ * up for every thread although most threads of a large blocking pool never
+ * raise an error. With `CDK_ERROR_LAZY` a thread holds only `cdk_errno` and
+ * `cdk_lazy_errno`, a pointer to its error. The first errno macro run by the
+ * thread takes the error from the pool in `cdk_elazy`, a tss destructor
+ * returns it when the thread exits. Past the pool capacity, or before
+ * cdk_elazy_init, errors are allocated and freed instead, `overflow` counts
+ * them. The spill buffer of `CDK_ERROR_FSTR_INLINE` stays thread-local. The
+ * program defines `cdk_elazy` and `cdk_lazy_errno` in place of
+ * `cdk_hidden_errno`, like the rest of the global state.
+ */
+#ifdef CDK_ERROR_LAZY
+struct cdk_ELazy {
+  struct cdk_EPool pool;     // Errors of threads that raised one
+  _Atomic uint64_t overflow; // Errors allocated past the pool
+  _Atomic int key_state;     // 0 none, 1 creating, 2 created, 3 failed
+  tss_t key;                 // Returns error of an exiting thread
+};
+
+extern struct cdk_ELazy cdk_elazy;
+_Thread_local extern struct cdk_Error *cdk_lazy_errno CDK_ERROR_TLS;
+
+CDK_ERROR_API void cdk_elazy_init(size_t capacity,
+                                  struct cdk_EPoolSlot *slots);
+CDK_ERROR_COLD struct cdk_Error *cdk_elazy__take(void);
+
+/**
+ * Error of the current thread, taken on first use.
+ */
+static inline struct cdk_Error *cdk_elazy__get(void) {
+  struct cdk_Error *err = cdk_lazy_errno;
+
+  return cdk_likely(err) ? err : cdk_elazy__take();
+}
+
+#ifdef CDK_ERROR__DEFINE
+/**
+ * Set up the pool of `cdk_elazy` over `capacity` slots at `slots`. Call it
+ * before any thread raises an error.
+ */
+CDK_ERROR_API void cdk_elazy_init(size_t capacity,
+                                  struct cdk_EPoolSlot *slots) {
+  cdk_epool_init(&cdk_elazy.pool, capacity, slots);
+}
+
+static inline void cdk_elazy__return(void *err) {
+  struct cdk_EPool *pool = &cdk_elazy.pool;
+  uintptr_t addr = (uintptr_t)err, start = (uintptr_t)pool->slots;
+
+  cdk_lazy_errno = NULL;
+  if (addr - start < (uintptr_t)pool->capacity * sizeof(*pool->slots)) {
+    // The error is the first member of its slot.
+    struct cdk_EPoolSlot *slot = err;
+    uint32_t gen = atomic_load_explicit(&slot->gen, memory_order_relaxed);
+
+    cdk_epool_release(pool, (uint64_t)gen << 32 |
+                                (uint32_t)(slot - pool->slots));
+    return;
+  }
+  free(err);
+}
+
+/**
+ * Take error of the current thread from the pool, or allocate it. Aborts if
+ * allocation fails, errno macros have nowhere else to write.
+ */
+CDK_ERROR_COLD struct cdk_Error *cdk_elazy__take(void) {
+  struct cdk_ELazy *lazy = &cdk_elazy;
+  cdk_epool_handle_t handle = cdk_epool_acquire(&lazy->pool);
+  struct cdk_Error *err;
+
+  if (handle) {
+    err = cdk_epool_get(&lazy->pool, handle);
+    // Same state as a zero-initialized thread-local error.
+    memset(err, 0, sizeof(*err));
+  } else {
+    err = calloc(1, sizeof(*err));
+    if (!err) {
+      abort();
+    }
+    atomic_fetch_add_explicit(&lazy->overflow, 1, memory_order_relaxed);
+  }
+
+  if (cdk_error__tss_once(&lazy->key_state, &lazy->key, cdk_elazy__return) ==
+      2) {
+    tss_set(lazy->key, err);
+  }
+  cdk_lazy_errno = err;
+  return err;
+}
+#endif
+#endif
+
+/******************************************************************************
+ *                                   Fields                                   *
+ ******************************************************************************/
+#ifdef CDK_ERROR_FIELDS
+/*
+ * Fields carry context such as a descriptor, an offset or a peer address as
+ * typed values instead of text. They can be attached right after the error is
+ * raised or at any wrap level, and cost a store of the key and the value:
+ * nothing is formatted until the error is dumped. Fields past
+ * `CDK_EFIELDS_MAX` are dropped, byte spans are cut to `CDK_EFIELD_BYTES`.
+ * Raising an error clears its fields, translating it keeps them.
+ */
+_Static_assert(CDK_EFIELDS_MAX <= UINT8_MAX, "field count is 8-bit");
+_Static_assert(CDK_EFIELD_BYTES <= 32, "field span is dumped in one piece");
+
+CDK_ERROR_COLD cdk_error_t cdk_error_field_int(struct cdk_Error *err,
+                                               const char *key, int64_t value);
+CDK_ERROR_COLD cdk_error_t cdk_error_field_uint(struct cdk_Error *err,
+                                                const char *key,
+                                                uint64_t value);
+CDK_ERROR_COLD cdk_error_t cdk_error_field_str(struct cdk_Error *err,
+                                               const char *key,
+                                               const char *value);
+CDK_ERROR_COLD cdk_error_t cdk_error_field_bytes(struct cdk_Error *err,
+                                                 const char *key,
+                                                 const void *data, size_t size);
+
+#ifdef CDK_ERROR__DEFINE
+static inline struct cdk_EField *cdk_error__field(struct cdk_Error *err,
+                                                  const char *key,
+                                                  enum cdk_EFieldType type) {
+  struct cdk_EField *field;
+
+  if (err->efields_len >= CDK_EFIELDS_MAX) {
+    return NULL;
+  }
+  field = &err->efields[err->efields_len++];
+  field->key = key;
+  field->type = type;
+
+  return field;
+}
+
+/**
+ * Attach signed integer field.
+ */
+CDK_ERROR_COLD cdk_error_t cdk_error_field_int(struct cdk_Error *err,
+                                               const char *key, int64_t value) {
+  struct cdk_EField *field = cdk_error__field(err, key, cdk_EFieldType_INT);
+
+  if (field) {
+    field->i64 = value;
+  }
+  return err;
+}
+
+/**
+ * Attach unsigned integer field.
+ */
+CDK_ERROR_COLD cdk_error_t cdk_error_field_uint(struct cdk_Error *err,
+                                                const char *key,
+                                                uint64_t value) {
+  struct cdk_EField *field = cdk_error__field(err, key, cdk_EFieldType_UINT);
+
+  if (field) {
+    field->u64 = value;
+  }
+  return err;
+}
+
+/**
+ * Attach string field, only the pointer is kept.
+ */
+CDK_ERROR_COLD cdk_error_t cdk_error_field_str(struct cdk_Error *err,
+                                               const char *key,
+                                               const char *value) {
+  struct cdk_EField *field = cdk_error__field(err, key, cdk_EFieldType_STR);
+
+  if (field) {
+    field->str = value;
+  }
+  return err;
+}
+
+/**
+ * Attach copy of up to CDK_EFIELD_BYTES bytes of `data`.
+ */
+CDK_ERROR_COLD cdk_error_t cdk_error_field_bytes(struct cdk_Error *err,
+                                                 const char *key,
+                                                 const void *data,
+                                                 size_t size) {
+  struct cdk_EField *field = cdk_error__field(err, key, cdk_EFieldType_BYTES);
+
+  if (field) {
+    field->len = size < CDK_EFIELD_BYTES ? size : CDK_EFIELD_BYTES;
+    field->size = size < UINT32_MAX ? (uint32_t)size : UINT32_MAX;
+    memcpy(field->bytes, data, field->len);
+  }
+  return err;
+}
+#endif
+
+/**
+ * Attach field of type picked from `value`: strings, signed or unsigned
+ * integers.
+ */
+#define cdk_error_field(err, key, value)                                       \
+  _Generic((value),                                                            \
+      char *: cdk_error_field_str,                                             \
+      const char *: cdk_error_field_str,                                       \
+      unsigned char: cdk_error_field_uint,                                     \
+      unsigned short: cdk_error_field_uint,                                    \
+      unsigned int: cdk_error_field_uint,                                      \
+      unsigned long: cdk_error_field_uint,                                     \
+      unsigned long long: cdk_error_field_uint,                                \
+      default: cdk_error_field_int)((err), (key), (value))
+#endif
+
+/******************************************************************************
+ *                              Native backtrace                              *
+ ******************************************************************************/
+/*
+ * With `CDK_ERROR_BTRACE_FP` every raise follows the chain of saved frame
+ * pointers from the constructor up and stores up to CDK_ERROR_BTRACE_FP
+ * return addresses in `epcs`. The first one is in the raising function,
+ * unless the constructor was inlined into it with CDK_ERROR_NO_OUTLINE. The
+ * walk costs a couple of loads per level, it needs no unwinder and no heap.
+ *
+ * Every function on the way has to keep a frame pointer, so build with
+ * -fno-omit-frame-pointer. In a mixed build, where some code is compiled
+ * without frame pointers (often libraries built at -O2), the register of such
+ * a frame holds whatever the code left there. If it happens to look like a
+ * frame pointer, the walk would load from it. Each thread therefore queries
+ * its stack bounds on its first raise, and the walk stops at a null,
+ * misaligned or not increasing frame pointer, or one outside the stack of the
+ * thread. Every load then stays between the raising frame and the top of the
+ * stack, which is mapped, so a mixed build gets bogus or missing addresses
+ * but does not crash. A raise on a stack the thread does not own, like a
+ * sigaltstack handler or a coroutine, keeps only the first address, as does
+ * a thread whose bounds cannot be queried. Frame records are read as on x86
+ * and AArch64, the saved frame pointer followed by the return address.
+ *
+ * Addresses are symbolized only when the error is dumped, through dladdr,
+ * in the format of backtrace_symbols:
+ *
+ *   [00] ./server(parse_request+0x4c) [0x55d0c3a1b2c4]
+ *   [01] ./server(+0x1a2f) [0x55d0c3a1ba2f]
+ *
+ * Only dynamic symbols have names, link executables with -rdynamic to get
+ * them. Offsets from the object itself, as in the second line, are resolved
+ * offline with `addr2line -f -e ./server 0x1a2f`. dladdr needs `_GNU_SOURCE`
+ * on glibc. It is called once per frame, but may take the loader lock, so
+ * crash handlers dumping native frames need CDK_ERROR_BTRACE_FP_RAW, which
+ * prints only the addresses:
+ *
+ *   [00] [0x55d0c3a1b2c4]
+ *
+ * Snapshots keep the addresses, wire records do not.
+ */
+#ifdef CDK_ERROR_BTRACE_FP
+#if !defined(__GNUC__) || !(defined(__unix__) || defined(__APPLE__)) ||      \
+    !(defined(__x86_64__) || defined(__i386__) || defined(__aarch64__))
+#error "CDK_ERROR_BTRACE_FP requires GCC or Clang on POSIX x86 or AArch64"
+#endif
+
+_Static_assert(CDK_ERROR_BTRACE_FP > 0 && CDK_ERROR_BTRACE_FP <= UINT8_MAX,
+               "native backtrace depth is 1 to 255");
+
+#ifdef CDK_ERROR__DEFINE
+/**
+ * Stack of a thread, `queried` once its first raise looked it up. `lo` and
+ * `hi` stay 0 if the bounds cannot be queried.
+ */
+struct cdk_EStack {
+  uintptr_t lo;
+  uintptr_t hi;
+  int queried;
+};
+
+static _Thread_local struct cdk_EStack cdk_error__stack CDK_ERROR_TLS;
+
+static CDK_ERROR__COLD void cdk_error__stack_query(struct cdk_EStack *stack) {
+  void *addr = NULL;
+  size_t size = 0;
+#if defined(__APPLE__)
+  pthread_t self = pthread_self();
+
+  size = pthread_get_stacksize_np(self);
+  addr = (char *)pthread_get_stackaddr_np(self) - size;
+#elif defined(__linux__) || defined(__FreeBSD__) || defined(__DragonFly__) ||  \
+    defined(__NetBSD__)
+  pthread_attr_t attr;
+
+#ifdef __linux__
+  if (!pthread_getattr_np(pthread_self(), &attr)) {
+#else
+  if (!pthread_attr_init(&attr) &&
+      !pthread_attr_get_np(pthread_self(), &attr)) {
+#endif
+    if (pthread_attr_getstack(&attr, &addr, &size)) {
+      addr = NULL;
+      size = 0;
+    }
+    pthread_attr_destroy(&attr);
+  }
+#endif
+
+  stack->lo = (uintptr_t)addr;
+  stack->hi = (uintptr_t)addr + size;
+  stack->queried = 1;
+}
+
+/**
+ * Store return addresses of the current function and its callers in
+ * `epcs`. Always inlined, so the walk starts in the frame of the constructor.
+ */
+__attribute__((always_inline)) static inline void
+cdk_error__fp_walk(struct cdk_Error *err) {
+  struct cdk_EStack *stack = &cdk_error__stack;
+  void **fp = (void **)__builtin_frame_address(0);
+  uintptr_t hi;
+  uint8_t len = 0;
+
+  if (cdk_unlikely(!stack->queried)) {
+    cdk_error__stack_query(stack);
+  }
+  // Frames are followed only on the stack of the thread.
+  hi = (uintptr_t)fp >= stack->lo && (uintptr_t)fp < stack->hi ? stack->hi : 0;
+
+  while (len < CDK_ERROR_BTRACE_FP) {
+    void **next = (void **)fp[0];
+    void *pc = fp[1];
+
+    if (!pc) {
+      break;
+    }
+    err->epcs[len++] = pc;
+
+    if ((uintptr_t)next <= (uintptr_t)fp || (uintptr_t)next >= hi ||
+        hi - (uintptr_t)next < 2 * sizeof(void *) ||
+        (uintptr_t)next % sizeof(void *)) {
+      break;
+    }
+    fp = next;
+  }
+
+  err->epcs_len = len;
+}
+
+/**
+ * Object and symbol holding return address `pc`. Looks up the call before
+ * it, a call ending a function returns past its end. Returns 0 and clears
+ * `info` if `pc` is in no loaded object.
+ */
+static inline int cdk_error__pc_info(const void *pc, Dl_info *info) {
+  if (!dladdr((const char *)pc - 1, info)) {
+    memset(info, 0, sizeof(*info));
+    return 0;
+  }
+  return 1;
+}
+#endif
+#endif
+
+/******************************************************************************
+ *                                   Hooks                                    *
+ ******************************************************************************/
+/*
+ * Every constructor calls cdk_error__on_raise once the error is filled in,
+ * cdk_error_add_frame calls cdk_error__on_wrap for every stored frame and
+ * every dump starts with cdk_error__on_top. Optional features attach here, so
+ * code paths without errors stay untouched.
+ */
+#ifdef CDK_ERROR__DEFINE
+#ifdef CDK_ERROR_BTRACE_FP
+// The native backtrace starts in the frame of the constructor.
+__attribute__((always_inline))
+#endif
+static inline void cdk_error__on_raise(struct cdk_Error *err) {
+#ifdef CDK_ERROR_BTRACE_FP
+  cdk_error__fp_walk(err);
+#endif
+#ifdef CDK_ERROR_SAMPLE
+  err->esuppressed = 0;
+  err->_enotrace = 0;
+  err->_ewraps = 0;
+#endif
+#ifdef CDK_ERROR_CAUSE
+  err->ecauses_len = 0;
+  err->_ecause_buf_len = 0;
+#endif
+#ifdef CDK_ERROR_BTRACE_RING
+  err->eframes_omitted = 0;
+#endif
+#ifdef CDK_ERROR_FIELDS
+  err->efields_len = 0;
+#endif
+#ifdef CDK_ERROR_COUNTERS
+  // Set again by CDK_ECOUNT, which runs after the constructor.
+  err->_ecounter = NULL;
+  err->_etopped = 0;
+#endif
+#ifdef CDK_ERROR_FINGERPRINT
+  cdk_efingerprint__raise(err);
+#endif
+#ifdef CDK_ERROR_RECORDER
+  cdk_erecorder__raise(err);
+#endif
+#ifdef CDK_ERROR_STATS
+  cdk_estats__raise(err);
+#endif
+  (void)err;
+}
+
+static inline void cdk_error__on_wrap(struct cdk_Error *err,
+                                      const struct cdk_EFrame *frame) {
+#ifdef CDK_ERROR_RECORDER
+  cdk_erecorder__wrap(err, frame);
+#endif
+#ifdef CDK_ERROR_COUNTERS
+  cdk_ecounter__wrap(err);
+#endif
+#ifdef CDK_ERROR_STATS
+  cdk_estats__wrap(err, frame);
+#endif
+  (void)err;
+  (void)frame;
+}
+
+static inline void cdk_error__on_top(struct cdk_Error *err) {
+#ifdef CDK_ERROR_COUNTERS
+  cdk_ecounter__top(err);
+#endif
+  (void)err;
+}
+#endif
+
+/******************************************************************************
+ *                                 Generic API                                *
+ ******************************************************************************/
+/*
+ * Constructors write only the header fields and the origin frame. Frames past
+ * `eframes_len` and the bytes of `_msg_buf` past the terminating NUL are never
+ * read, so they are left untouched; construction cost does not depend on
+ * CDK_ERROR_BTRACE_MAX nor CDK_ERROR_FSTR_MAX.
+ */
+CDK_ERROR_COLD cdk_error_t cdk_error_int(struct cdk_Error *err,
+                                         cdk_ecode_t code,
+                                         CDK_ERROR_LOC_PARAMS);
+CDK_ERROR_COLD cdk_error_t cdk_error_lstr(struct cdk_Error *err,
+                                          cdk_ecode_t code,
+                                          CDK_ERROR_LOC_PARAMS,
+                                          const char *msg);
+#ifndef CDK_ERROR_OPTIMIZE
+CDK_ERROR_COLD cdk_error_t cdk_error_fstr(struct cdk_Error *err,
+                                          cdk_ecode_t code,
+                                          CDK_ERROR_LOC_PARAMS,
+                                          const char *fmt, ...);
+CDK_ERROR_COLD cdk_error_t cdk_error_dfstr(struct cdk_Error *err,
+                                           cdk_ecode_t code,
+                                           CDK_ERROR_LOC_PARAMS,
+                                           const char *fmt, ...);
+#endif
+
+#ifdef CDK_ERROR__DEFINE
+static inline void cdk_error__set_code(struct cdk_Error *err,
+                                       cdk_ecode_t code) {
+  err->code = (uint16_t)code;
+#ifdef CDK_ERROR_DOMAINS
+  err->domain = (uint16_t)(code >> 16);
+#endif
+}
+
+/**
+ * Create struct cdk_Error of type cdk_ErrorType_INT.
+ */
+CDK_ERROR_COLD cdk_error_t
+cdk_error_int(struct cdk_Error *err, cdk_ecode_t code,
+              CDK_ERROR_LOC_PARAMS) {
+  err->type = cdk_ErrorType_INT;
+  cdk_error__set_code(err, code);
+  err->msg = NULL;
+  err->eframes[0] = CDK_ERROR_LOC_FRAME;
+  err->eframes_len = 1;
+  cdk_error__on_raise(err);
+
+  return err;
+};
+
+/**
+ * Create struct cdk_Error of type cdk_ErrorType_STR.
+ */
+CDK_ERROR_COLD cdk_error_t
+cdk_error_lstr(struct cdk_Error *err, cdk_ecode_t code, CDK_ERROR_LOC_PARAMS,
+               const char *msg) {
+  err->type = cdk_ErrorType_STR;
+  cdk_error__set_code(err, code);
+  err->msg = msg;
+  err->eframes[0] = CDK_ERROR_LOC_FRAME;
+  err->eframes_len = 1;
+  cdk_error__on_raise(err);
+
+  return err;
+};
+
+#ifndef CDK_ERROR_OPTIMIZE
+/**
+ * Format message of cdk_ErrorType_FSTR error, into `_msg_buf` or, if it does
+ * not fit there, into `cdk_emsg_spill`.
+ */
+static inline void cdk_error__vformat(struct cdk_Error *err, const char *fmt,
+                                      va_list args) {
+#ifdef CDK_ERROR_FSTR_INLINE
+  va_list spill_args;
+  va_copy(spill_args, args);
+#endif
+
+  int written_bytes =
+      vsnprintf(err->_msg_buf, sizeof(err->_msg_buf), fmt, args);
+
+  assert(written_bytes >= 0);
+  err->msg = err->_msg_buf;
+
+#ifdef CDK_ERROR_FSTR_INLINE
+  if ((size_t)written_bytes >= sizeof(err->_msg_buf)) {
+    vsnprintf(cdk_emsg_spill.buf, sizeof(cdk_emsg_spill.buf), fmt,
+              spill_args);
+    err->msg = cdk_emsg_spill.buf;
+    err->_msg_spill = ++cdk_emsg_spill.gen;
+  }
+  va_end(spill_args);
+#endif
+  (void)written_bytes;
+}
+
+/**
+ * Message of cdk_ErrorType_FSTR error and size of the buffer holding it. A
+ * spilled message overwritten since, or spilled on another thread, is read
+ * from its inline prefix.
+ */
+static inline const char *cdk_error__fmsg(const struct cdk_Error *err,
+                                          size_t *size) {
+#ifdef CDK_ERROR_FSTR_INLINE
+  if (err->msg == cdk_emsg_spill.buf &&
+      err->_msg_spill == cdk_emsg_spill.gen) {
+    *size = sizeof(cdk_emsg_spill.buf);
+    return err->msg;
+  }
+  *size = sizeof(err->_msg_buf);
+  return err->_msg_buf;
+#else
+  *size = sizeof(err->_msg_buf);
+  return err->msg;
+#endif
+}
+
+/**
+ * Create struct cdk_Error of type cdk_ErrorType_FSTR.
+ */
+CDK_ERROR_COLD cdk_error_t
+cdk_error_fstr(struct cdk_Error *err, cdk_ecode_t code, CDK_ERROR_LOC_PARAMS,
+               const char *fmt, ...) {
+  err->type = cdk_ErrorType_FSTR;
+  cdk_error__set_code(err, code);
+  err->eframes[0] = CDK_ERROR_LOC_FRAME;
+  err->eframes_len = 1;
+
+  va_list args;
+  va_start(args, fmt);
+  cdk_error__vformat(err, fmt, args);
+  va_end(args);
+
+  cdk_error__on_raise(err);
+
+  return err;
+};
+#endif
+#endif
+
+#if !defined(CDK_ERROR_OPTIMIZE) && defined(CDK_ERROR__DEFINE)
+/*
+ * Deferred formatting. Instead of running vsnprintf when the error is raised,
+ * cdk_error_dfstr walks the format once, copies every argument into `_msg_buf`
+ * as a type-tagged record and keeps `fmt` in `msg`. Text is produced only by
+ * cdk_error_msg or cdk_error_dumps, so errors that are handled and dropped
+ * never pay for formatting.
+ *
+ * Record layout: one tag byte followed by 8 bytes of payload (int64_t,
+ * uint64_t, double or pointer) or, for strings, a NUL-terminated copy of the
+ * string. A cdk_EArg_END tag closes the list. `long double` arguments are
+ * narrowed to `double` and `%n` is consumed but never written.
+ *
+ * Widths and precisions are honoured like printf does, padding and long `%f`
+ * bodies are emitted in pieces so only the output buffer bounds them.
+ * Floating point conversions show at most 17 fractional digits.
+ */
+enum cdk_EArg {
+  cdk_EArg_END,
+  cdk_EArg_INT,
+  cdk_EArg_UINT,
+  cdk_EArg_DBL,
+  cdk_EArg_PTR,
+  cdk_EArg_STR,
+};
+
+/**
+ * Single parsed printf conversion specification.
+ */
+struct cdk_EFmtSpec {
+  char flags[7]; // NUL-terminated subset of "-+ #0"
+  int width;     // -1 if absent, -2 if taken from argument
+  int prec;      // -1 if absent, -2 if taken from argument
+  char length;   // 'H' for hh, 'h', 'l', 'q' for ll, 'j', 'z', 't', 'L' or 0
+  char conv;     // Conversion character, 0 if spec is malformed
+};
+
+// Append decimal digit to width or precision, saturating at INT_MAX.
+static inline int cdk_error__fmt_num(int num, char digit) {
+  return num > (INT_MAX - 9) / 10 ? INT_MAX : num * 10 + (digit - '0');
+}
+
+/**
+ * Parse conversion specification starting right after '%'. Returns pointer to
+ * the first character after the specification.
+ */
+static inline const char *cdk_error__fmt_spec(const char *fmt,
+                                              struct cdk_EFmtSpec *spec) {
+  size_t flags_len = 0;
+
+  *spec = (struct cdk_EFmtSpec){.width = -1, .prec = -1};
+
+  while (*fmt && strchr("-+ #0", *fmt)) {
+    // Leave room for '-' added by a negative '*' width.
+    if (flags_len < sizeof(spec->flags) - 2) {
+      spec->flags[flags_len++] = *fmt;
+    }
+    fmt++;
+  }
+
+  if (*fmt == '*') {
+    spec->width = -2;
+    fmt++;
+  } else {
+    for (; *fmt >= '0' && *fmt <= '9'; fmt++) {
+      spec->width = cdk_error__fmt_num(spec->width < 0 ? 0 : spec->width, *fmt);
+    }
+  }
+
+  if (*fmt == '.') {
+    fmt++;
+    spec->prec = 0;
+    if (*fmt == '*') {
+      spec->prec = -2;
+      fmt++;
+    } else {
+      for (; *fmt >= '0' && *fmt <= '9'; fmt++) {
+        spec->prec = cdk_error__fmt_num(spec->prec, *fmt);
+      }
+    }
+  }
+
+  switch (*fmt) {
+  case 'h':
+  case 'l':
+    spec->length = *fmt++;
+    if (*fmt == spec->length) {
+      spec->length = spec->length == 'h' ? 'H' : 'q';
+      fmt++;
+    }
+    break;
+  case 'j':
+  case 'z':
+  case 't':
+  case 'L':
+    spec->length = *fmt++;
+    break;
+  default:;
+  }
+
+  if (*fmt && strchr("diouxXcspfFeEgGaAn%", *fmt)) {
+    spec->conv = *fmt++;
+  }
+
+  return fmt;
+}
+
+/**
+ * Append one tagged argument record, returns false if it does not fit.
+ */
+static inline int cdk_error__arg_put(struct cdk_Error *err, size_t *offset,
+                                     enum cdk_EArg tag, const void *payload,
+                                     size_t payload_len) {
+  // Keep one byte for the closing cdk_EArg_END tag.
+  if (*offset + 1 + payload_len >= sizeof(err->_msg_buf)) {
+    return 0;
+  }
+  err->_msg_buf[(*offset)++] = (char)tag;
+  memcpy(&err->_msg_buf[*offset], payload, payload_len);
+  *offset += payload_len;
+  return 1;
+}
+
+static inline int cdk_error__arg_put_int(struct cdk_Error *err,
+                                         size_t *offset, int64_t value) {
+  return cdk_error__arg_put(err, offset, cdk_EArg_INT, &value, sizeof(value));
+}
+
+/**
+ * Copy arguments described by `fmt` into `_msg_buf`.
+ */
+static inline void cdk_error__dfmt_capture(struct cdk_Error *err,
+                                           const char *fmt, va_list args) {
+  struct cdk_EFmtSpec spec;
+  size_t offset = 0;
+  int fits = 1;
+
+  while (fits && (fmt = strchr(fmt, '%'))) {
+    fmt = cdk_error__fmt_spec(fmt + 1, &spec);
+
+    if (spec.width == -2) {
+      fits = cdk_error__arg_put_int(err, &offset, va_arg(args, int));
+    }
+    if (fits && spec.prec == -2) {
+      int prec = va_arg(args, int);
+      // Strings are cut to the precision right away.
+      spec.prec = prec < 0 ? -1 : prec;
+      fits = cdk_error__arg_put_int(err, &offset, prec);
+    }
+    if (!fits) {
+      break;
+    }
+
+    switch (spec.conv) {
+    case 'd':
+    case 'i': {
+      int64_t value;
+      switch (spec.length) {
+      case 'H':
+        value = (signed char)va_arg(args, int);
+        break;
+      case 'h':
+        value = (short)va_arg(args, int);
+        break;
+      case 'l':
+        value = va_arg(args, long);
+        break;
+      case 'q':
+        value = va_arg(args, long long);
+        break;
+      case 'j':
+        value = va_arg(args, intmax_t);
+        break;
+      case 'z':
+      case 't':
+        value = va_arg(args, ptrdiff_t);
+        break;
+      default:
+        value = va_arg(args, int);
+      }
+      fits = cdk_error__arg_put_int(err, &offset, value);
+      break;
+    }
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X': {
+      uint64_t value;
+      switch (spec.length) {
+      case 'H':
+        value = (unsigned char)va_arg(args, unsigned int);
+        break;
+      case 'h':
+        value = (unsigned short)va_arg(args, unsigned int);
+        break;
+      case 'l':
+        value = va_arg(args, unsigned long);
+        break;
+      case 'q':
+        value = va_arg(args, unsigned long long);
+        break;
+      case 'j':
+        value = va_arg(args, uintmax_t);
+        break;
+      case 'z':
+      case 't':
+        value = va_arg(args, size_t);
+        break;
+      default:
+        value = va_arg(args, unsigned int);
+      }
+      fits = cdk_error__arg_put(err, &offset, cdk_EArg_UINT, &value,
+                                sizeof(value));
+      break;
+    }
+    case 'c':
+      fits = cdk_error__arg_put_int(err, &offset, va_arg(args, int));
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A': {
+      double value = spec.length == 'L' ? (double)va_arg(args, long double)
+                                        : va_arg(args, double);
+      fits =
+          cdk_error__arg_put(err, &offset, cdk_EArg_DBL, &value, sizeof(value));
+      break;
+    }
+    case 'p': {
+      const void *value = va_arg(args, void *);
+      fits =
+          cdk_error__arg_put(err, &offset, cdk_EArg_PTR, &value, sizeof(value));
+      break;
+    }
+    case 's': {
+      const char *value = va_arg(args, const char *);
+      size_t len;
+      if (!value) {
+        value = "(null)";
+      }
+      // Like printf, read no further than the precision.
+      if (spec.prec >= 0) {
+        const char *nul = memchr(value, '\0', spec.prec);
+        len = nul ? (size_t)(nul - value) : (size_t)spec.prec;
+      } else {
+        len = strlen(value);
+      }
+      // Tag, NUL and the closing tag must fit, the string is truncated.
+      if (offset + 3 > sizeof(err->_msg_buf)) {
+        fits = 0;
+        break;
+      }
+      if (offset + 3 + len > sizeof(err->_msg_buf)) {
+        len = sizeof(err->_msg_buf) - offset - 3;
+      }
+      cdk_error__arg_put(err, &offset, cdk_EArg_STR, value, len);
+      err->_msg_buf[offset++] = '\0';
+      break;
+    }
+    case 'n':
+      (void)va_arg(args, void *);
+      break;
+    default:;
+    }
+  }
+
+  err->_msg_buf[offset] = cdk_EArg_END;
+}
+
+/**
+ * Create struct cdk_Error of type cdk_ErrorType_DFSTR.
+ */
+CDK_ERROR_COLD cdk_error_t
+cdk_error_dfstr(struct cdk_Error *err, cdk_ecode_t code, CDK_ERROR_LOC_PARAMS,
+                const char *fmt, ...) {
+  err->type = cdk_ErrorType_DFSTR;
+  cdk_error__set_code(err, code);
+  err->msg = fmt;
+  err->eframes[0] = CDK_ERROR_LOC_FRAME;
+  err->eframes_len = 1;
+
+  va_list args;
+  va_start(args, fmt);
+  cdk_error__dfmt_capture(err, fmt, args);
+  va_end(args);
+  cdk_error__on_raise(err);
+
+  return err;
+};
+#endif
+
+/******************************************************************************
+ *                                    Dump                                    *
+ ******************************************************************************/
+/*
+ * Dumping never touches stdio, the heap nor any lock: numbers are formatted by
+ * hand and errno descriptions come from a static table, so every dump function
+ * below is thread-safe and async-signal-safe and may be used from crash
+ * handlers. The exception are native frames of CDK_ERROR_BTRACE_FP, resolved
+ * with dladdr unless CDK_ERROR_BTRACE_FP_RAW is defined.
+ *
+ * A dump is produced as a sequence of pieces, each either a pointer into the
+ * error, a literal, or a few bytes rendered into caller's scratch space. A
+ * struct cdk_EDumpCursor names the piece being emitted and how much of it was
+ * already consumed, so output can be drained through buffers of any size.
+ */
+#ifndef CDK_EDUMP_IOV
+#define CDK_EDUMP_IOV 16
+#endif
+
+// Scratch bytes needed to render a single piece.
+#define CDK_EDUMP_SCRATCH 96
+// Returned by cdk_error_dumpr for an empty buffer.
+#define CDK_EDUMP_EINVAL ((size_t)-1)
+
+/**
+ * Errno name and description.
+ */
+struct cdk_ErrnoDesc {
+  const char *name;
+  const char *desc;
+};
+
+#if defined(__linux__) && !defined(CDK_ERRNO_POSIX)
+// Linux errno values with glibc descriptions.
+#define CDK_ERRNO_LIST(X)                                                      \
+  X(EPERM, "Operation not permitted")                                          \
+  X(ENOENT, "No such file or directory")                                       \
+  X(ESRCH, "No such process")                                                  \
+  X(EINTR, "Interrupted system call")                                          \
+  X(EIO, "Input/output error")                                                 \
+  X(ENXIO, "No such device or address")                                        \
+  X(E2BIG, "Argument list too long")                                           \
+  X(ENOEXEC, "Exec format error")                                              \
+  X(EBADF, "Bad file descriptor")                                              \
+  X(ECHILD, "No child processes")                                              \
+  X(EAGAIN, "Resource temporarily unavailable")                                \
+  X(ENOMEM, "Cannot allocate memory")                                          \
+  X(EACCES, "Permission denied")                                               \
+  X(EFAULT, "Bad address")                                                     \
+  X(ENOTBLK, "Block device required")                                          \
+  X(EBUSY, "Device or resource busy")                                          \
+  X(EEXIST, "File exists")                                                     \
+  X(EXDEV, "Invalid cross-device link")                                        \
+  X(ENODEV, "No such device")                                                  \
+  X(ENOTDIR, "Not a directory")                                                \
+  X(EISDIR, "Is a directory")                                                  \
+  X(EINVAL, "Invalid argument")                                                \
+  X(ENFILE, "Too many open files in system")                                   \
+  X(EMFILE, "Too many open files")                                             \
+  X(ENOTTY, "Inappropriate ioctl for device")                                  \
+  X(ETXTBSY, "Text file busy")                                                 \
+  X(EFBIG, "File too large")                                                   \
+  X(ENOSPC, "No space left on device")                                         \
+  X(ESPIPE, "Illegal seek")                                                    \
+  X(EROFS, "Read-only file system")                                            \
+  X(EMLINK, "Too many links")                                                  \
+  X(EPIPE, "Broken pipe")                                                      \
+  X(EDOM, "Numerical argument out of domain")                                  \
+  X(ERANGE, "Numerical result out of range")                                   \
+  X(EDEADLK, "Resource deadlock avoided")                                      \
+  X(ENAMETOOLONG, "File name too long")                                        \
+  X(ENOLCK, "No locks available")                                              \
+  X(ENOSYS, "Function not implemented")                                        \
+  X(ENOTEMPTY, "Directory not empty")                                          \
+  X(ELOOP, "Too many levels of symbolic links")                                \
+  X(ENOMSG, "No message of desired type")                                      \
+  X(EIDRM, "Identifier removed")                                               \
+  X(ECHRNG, "Channel number out of range")                                     \
+  X(EL2NSYNC, "Level 2 not synchronized")                                      \
+  X(EL3HLT, "Level 3 halted")                                                  \
+  X(EL3RST, "Level 3 reset")                                                   \
+  X(ELNRNG, "Link number out of range")                                        \
+  X(EUNATCH, "Protocol driver not attached")                                   \
+  X(ENOCSI, "No CSI structure available")                                      \
+  X(EL2HLT, "Level 2 halted")                                                  \
+  X(EBADE, "Invalid exchange")                                                 \
+  X(EBADR, "Invalid request descriptor")                                       \
+  X(EXFULL, "Exchange full")                                                   \
+  X(ENOANO, "No anode")                                                        \
+  X(EBADRQC, "Invalid request code")                                           \
+  X(EBADSLT, "Invalid slot")                                                   \
+  X(EBFONT, "Bad font file format")                                            \
+  X(ENOSTR, "Device not a stream")                                             \
+  X(ENODATA, "No data available")                                              \
+  X(ETIME, "Timer expired")                                                    \
+  X(ENOSR, "Out of streams resources")                                         \
+  X(ENONET, "Machine is not on the network")                                   \
+  X(ENOPKG, "Package not installed")                                           \
+  X(EREMOTE, "Object is remote")                                               \
+  X(ENOLINK, "Link has been severed")                                          \
+  X(EADV, "Advertise error")                                                   \
+  X(ESRMNT, "Srmount error")                                                   \
+  X(ECOMM, "Communication error on send")                                      \
+  X(EPROTO, "Protocol error")                                                  \
+  X(EMULTIHOP, "Multihop attempted")                                           \
+  X(EDOTDOT, "RFS specific error")                                             \
+  X(EBADMSG, "Bad message")                                                    \
+  X(EOVERFLOW, "Value too large for defined data type")                        \
+  X(ENOTUNIQ, "Name not unique on network")                                    \
+  X(EBADFD, "File descriptor in bad state")                                    \
+  X(EREMCHG, "Remote address changed")                                         \
+  X(ELIBACC, "Can not access a needed shared library")                         \
+  X(ELIBBAD, "Accessing a corrupted shared library")                           \
+  X(ELIBSCN, ".lib section in a.out corrupted")                                \
+  X(ELIBMAX, "Attempting to link in too many shared libraries")                \
+  X(ELIBEXEC, "Cannot exec a shared library directly")                         \
+  X(EILSEQ, "Invalid or incomplete multibyte or wide character")               \
+  X(ERESTART, "Interrupted system call should be restarted")                   \
+  X(ESTRPIPE, "Streams pipe error")                                            \
+  X(EUSERS, "Too many users")                                                  \
+  X(ENOTSOCK, "Socket operation on non-socket")                                \
+  X(EDESTADDRREQ, "Destination address required")                              \
+  X(EMSGSIZE, "Message too long")                                              \
+  X(EPROTOTYPE, "Protocol wrong type for socket")                              \
+  X(ENOPROTOOPT, "Protocol not available")                                     \
+  X(EPROTONOSUPPORT, "Protocol not supported")                                 \
+  X(ESOCKTNOSUPPORT, "Socket type not supported")                              \
+  X(EOPNOTSUPP, "Operation not supported")                                     \
+  X(EPFNOSUPPORT, "Protocol family not supported")                             \
+  X(EAFNOSUPPORT, "Address family not supported by protocol")                  \
+  X(EADDRINUSE, "Address already in use")                                      \
+  X(EADDRNOTAVAIL, "Cannot assign requested address")                          \
+  X(ENETDOWN, "Network is down")                                               \
+  X(ENETUNREACH, "Network is unreachable")                                     \
+  X(ENETRESET, "Network dropped connection on reset")                          \
+  X(ECONNABORTED, "Software caused connection abort")                          \
+  X(ECONNRESET, "Connection reset by peer")                                    \
+  X(ENOBUFS, "No buffer space available")                                      \
+  X(EISCONN, "Transport endpoint is already connected")                        \
+  X(ENOTCONN, "Transport endpoint is not connected")                           \
+  X(ESHUTDOWN, "Cannot send after transport endpoint shutdown")                \
+  X(ETOOMANYREFS, "Too many references: cannot splice")                        \
+  X(ETIMEDOUT, "Connection timed out")                                         \
+  X(ECONNREFUSED, "Connection refused")                                        \
+  X(EHOSTDOWN, "Host is down")                                                 \
+  X(EHOSTUNREACH, "No route to host")                                          \
+  X(EALREADY, "Operation already in progress")                                 \
+  X(EINPROGRESS, "Operation now in progress")                                  \
+  X(ESTALE, "Stale file handle")                                               \
+  X(EUCLEAN, "Structure needs cleaning")                                       \
+  X(ENOTNAM, "Not a XENIX named type file")                                    \
+  X(ENAVAIL, "No XENIX semaphores available")                                  \
+  X(EISNAM, "Is a named type file")                                            \
+  X(EREMOTEIO, "Remote I/O error")                                             \
+  X(EDQUOT, "Disk quota exceeded")                                             \
+  X(ENOMEDIUM, "No medium found")                                              \
+  X(EMEDIUMTYPE, "Wrong medium type")                                          \
+  X(ECANCELED, "Operation canceled")                                           \
+  X(ENOKEY, "Required key not available")                                      \
+  X(EKEYEXPIRED, "Key has expired")                                            \
+  X(EKEYREVOKED, "Key has been revoked")                                       \
+  X(EKEYREJECTED, "Key was rejected by service")                               \
+  X(EOWNERDEAD, "Owner died")                                                  \
+  X(ENOTRECOVERABLE, "State not recoverable")                                  \
+  X(ERFKILL, "Operation not possible due to RF-kill")                          \
+  X(EHWPOISON, "Memory page has hardware error")
+#else
+/*
+ * POSIX errno values, numbered by the platform's <errno.h>, with glibc
+ * descriptions. EWOULDBLOCK and ENOTSUP are left out, they may equal EAGAIN
+ * and EOPNOTSUPP, as are the optional STREAMS values.
+ */
+#define CDK_ERRNO_LIST(X)                                                      \
+  X(EPERM, "Operation not permitted")                                          \
+  X(ENOENT, "No such file or directory")                                       \
+  X(ESRCH, "No such process")                                                  \
+  X(EINTR, "Interrupted system call")                                          \
+  X(EIO, "Input/output error")                                                 \
+  X(ENXIO, "No such device or address")                                        \
+  X(E2BIG, "Argument list too long")                                           \
+  X(ENOEXEC, "Exec format error")                                              \
+  X(EBADF, "Bad file descriptor")                                              \
+  X(ECHILD, "No child processes")                                              \
+  X(EAGAIN, "Resource temporarily unavailable")                                \
+  X(ENOMEM, "Cannot allocate memory")                                          \
+  X(EACCES, "Permission denied")                                               \
+  X(EFAULT, "Bad address")                                                     \
+  X(EBUSY, "Device or resource busy")                                          \
+  X(EEXIST, "File exists")                                                     \
+  X(EXDEV, "Invalid cross-device link")                                        \
+  X(ENODEV, "No such device")                                                  \
+  X(ENOTDIR, "Not a directory")                                                \
+  X(EISDIR, "Is a directory")                                                  \
+  X(EINVAL, "Invalid argument")                                                \
+  X(ENFILE, "Too many open files in system")                                   \
+  X(EMFILE, "Too many open files")                                             \
+  X(ENOTTY, "Inappropriate ioctl for device")                                  \
+  X(ETXTBSY, "Text file busy")                                                 \
+  X(EFBIG, "File too large")                                                   \
+  X(ENOSPC, "No space left on device")                                         \
+  X(ESPIPE, "Illegal seek")                                                    \
+  X(EROFS, "Read-only file system")                                            \
+  X(EMLINK, "Too many links")                                                  \
+  X(EPIPE, "Broken pipe")                                                      \
+  X(EDOM, "Numerical argument out of domain")                                  \
+  X(ERANGE, "Numerical result out of range")                                   \
+  X(EDEADLK, "Resource deadlock avoided")                                      \
+  X(ENAMETOOLONG, "File name too long")                                        \
+  X(ENOLCK, "No locks available")                                              \
+  X(ENOSYS, "Function not implemented")                                        \
+  X(ENOTEMPTY, "Directory not empty")                                          \
+  X(ELOOP, "Too many levels of symbolic links")                                \
+  X(ENOMSG, "No message of desired type")                                      \
+  X(EIDRM, "Identifier removed")                                               \
+  X(ENOLINK, "Link has been severed")                                          \
+  X(EPROTO, "Protocol error")                                                  \
+  X(EMULTIHOP, "Multihop attempted")                                           \
+  X(EBADMSG, "Bad message")                                                    \
+  X(EOVERFLOW, "Value too large for defined data type")                        \
+  X(EILSEQ, "Invalid or incomplete multibyte or wide character")               \
+  X(ENOTSOCK, "Socket operation on non-socket")                                \
+  X(EDESTADDRREQ, "Destination address required")                              \
+  X(EMSGSIZE, "Message too long")                                              \
+  X(EPROTOTYPE, "Protocol wrong type for socket")                              \
+  X(ENOPROTOOPT, "Protocol not available")                                     \
+  X(EPROTONOSUPPORT, "Protocol not supported")                                 \
+  X(EOPNOTSUPP, "Operation not supported")                                     \
+  X(EAFNOSUPPORT, "Address family not supported by protocol")                  \
+  X(EADDRINUSE, "Address already in use")                                      \
+  X(EADDRNOTAVAIL, "Cannot assign requested address")                          \
+  X(ENETDOWN, "Network is down")                                               \
+  X(ENETUNREACH, "Network is unreachable")                                     \
+  X(ENETRESET, "Network dropped connection on reset")                          \
+  X(ECONNABORTED, "Software caused connection abort")                          \
+  X(ECONNRESET, "Connection reset by peer")                                    \
+  X(ENOBUFS, "No buffer space available")                                      \
+  X(EISCONN, "Transport endpoint is already connected")                        \
+  X(ENOTCONN, "Transport endpoint is not connected")                           \
+  X(ETIMEDOUT, "Connection timed out")                                         \
+  X(ECONNREFUSED, "Connection refused")                                        \
+  X(EHOSTUNREACH, "No route to host")                                          \
+  X(EALREADY, "Operation already in progress")                                 \
+  X(EINPROGRESS, "Operation now in progress")                                  \
+  X(ESTALE, "Stale file handle")                                               \
+  X(EDQUOT, "Disk quota exceeded")                                             \
+  X(ECANCELED, "Operation canceled")                                           \
+  X(EOWNERDEAD, "Owner died")                                                  \
+  X(ENOTRECOVERABLE, "State not recoverable")
+#endif
+
+CDK_ERROR_API const struct cdk_ErrnoDesc *cdk_errno_desc(int code);
+
+#ifdef CDK_ERROR__DEFINE
+/**
+ * Get name and description of errno value, NULL if the value is unknown.
+ */
+CDK_ERROR_API const struct cdk_ErrnoDesc *cdk_errno_desc(int code) {
+#define CDK_ERRNO__DESC(name, desc) [name] = {#name, desc},
+  static const struct cdk_ErrnoDesc descs[] = {
+      [0] = {"OK", "Success"},
+      CDK_ERRNO_LIST(CDK_ERRNO__DESC)};
+#undef CDK_ERRNO__DESC
+
+  if (code < 0 || (size_t)code >= sizeof(descs) / sizeof(descs[0]) ||
+      !descs[code].name) {
+    return NULL;
+  }
+  return &descs[code];
+}
+#endif
+
+/******************************************************************************
+ *                                  Domains                                   *
+ ******************************************************************************/
+/*
+ * With `CDK_ERROR_DOMAINS` a code carries a 16-bit domain next to its 16-bit
+ * value, packed by CDK_ECODE(domain, value). Domain 0 holds errno values, so
+ * existing codes raise and dump as before. A library lists its codes once,
+ * like CDK_ERRNO_LIST does:
+ *
+ *   #define NET_EDOMAIN 0x4e01
+ *   #define NET_ERRORS(X)                                                    \
+ *     X(NET_TIMEOUT, "Peer did not answer in time")                          \
+ *     X(NET_PROTOCOL, "Peer broke the protocol")
+ *
+ *   CDK_EDOMAIN_CODES(net, NET_EDOMAIN, NET_ERRORS);  // in its header
+ *   CDK_EDOMAIN_DEFINE(net, NET_EDOMAIN, NET_ERRORS); // in one source file
+ *
+ * CDK_EDOMAIN_CODES declares `enum net_ecode`, values numbered from 1 and
+ * already tagged with the domain, so they are raised like errno values:
+ * cdk_errnoi(NET_TIMEOUT). CDK_EDOMAIN_DEFINE emits the table of names and
+ * descriptions indexed by value and registers it in the `cdk_edomains`
+ * section, where dumps find it. Domain IDs are 1 to 0x7fff, picked by each
+ * library.
+ *
+ * A lookup scans the registered domains, a handful per program, and indexes
+ * the table of the one found. It sees domains linked into the same
+ * executable or shared object as the code doing the lookup. Wire records
+ * keep the domain, the flight recorder and live stats keep the value only;
+ * stats count values per code for errno values only.
+ */
+#ifdef CDK_ERROR_DOMAINS
+#if !defined(__ELF__)
+#error "CDK_ERROR_DOMAINS requires an ELF target"
+#endif
+
+/**
+ * Codes of one domain.
+ */
+struct cdk_EDomain {
+  const char *name;                  // Name printed by dumps
+  uint16_t id;                       // Domain ID
+  uint16_t descs_len;                // Entries in `descs`
+  const struct cdk_ErrnoDesc *descs; // Indexed by value, name NULL if unused
+};
+
+#define CDK_EDOMAIN_ATTR                                                       \
+  __attribute__((section("cdk_edomains"), used,                               \
+                 aligned(__alignof__(struct cdk_EDomain))))
+
+extern const struct cdk_EDomain __start_cdk_edomains[] __attribute__((weak));
+extern const struct cdk_EDomain __stop_cdk_edomains[] __attribute__((weak));
+
+#define CDK_EDOMAIN__ENUM(name, desc) name,
+#define CDK_EDOMAIN__DESC(name, desc) [(name) & 0xffff] = {#name, desc},
+
+/**
+ * Declare `enum <ident>_ecode` with codes of X-macro `LIST` in `domain`.
+ */
+#define CDK_EDOMAIN_CODES(ident, domain, LIST)                                 \
+  enum ident##_ecode {                                                         \
+    ident##_ecode__base = (int)CDK_ECODE(domain, 0),                           \
+    LIST(CDK_EDOMAIN__ENUM)                                                    \
+  }
+
+/**
+ * Define and register table of codes declared by CDK_EDOMAIN_CODES.
+ */
+#define CDK_EDOMAIN_DEFINE(ident, domain, LIST)                                \
+  _Static_assert((domain) > 0 && (domain) <= 0x7fff,                          \
+                 "domain ID is 1 to 0x7fff");                                  \
+  static const struct cdk_ErrnoDesc cdk_edomain__descs_##ident[] = {          \
+      [0] = {"OK", "Success"}, LIST(CDK_EDOMAIN__DESC)};                       \
+  static const struct cdk_EDomain cdk_edomain_##ident CDK_EDOMAIN_ATTR = {    \
+      .name = #ident,                                                          \
+      .id = (domain),                                                          \
+      .descs_len = sizeof(cdk_edomain__descs_##ident) /                        \
+                   sizeof(cdk_edomain__descs_##ident[0]),                      \
+      .descs = cdk_edomain__descs_##ident}
+
+CDK_ERROR_API const struct cdk_EDomain *cdk_edomain_get(uint16_t id);
+CDK_ERROR_API const struct cdk_ErrnoDesc *cdk_ecode_desc(cdk_ecode_t code);
+
+#ifdef CDK_ERROR__DEFINE
+/**
+ * Get registered domain by its ID, NULL if there is none.
+ */
+CDK_ERROR_API const struct cdk_EDomain *cdk_edomain_get(uint16_t id) {
+  for (const struct cdk_EDomain *domain = __start_cdk_edomains;
+       domain < __stop_cdk_edomains; domain++) {
+    if (domain->id == id) {
+      return domain;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Get name and description of a code of any domain, NULL if the code or its
+ * domain is unknown.
+ */
+CDK_ERROR_API const struct cdk_ErrnoDesc *cdk_ecode_desc(cdk_ecode_t code) {
+  uint16_t value = (uint16_t)code;
+  const struct cdk_EDomain *domain;
+
+  if (!(code >> 16)) {
+    return cdk_errno_desc(value);
+  }
+  domain = cdk_edomain_get((uint16_t)(code >> 16));
+  if (!domain || value >= domain->descs_len || !domain->descs[value].name) {
+    return NULL;
+  }
+  return &domain->descs[value];
+}
+#endif
+#endif
+
+#ifdef CDK_ERROR__DEFINE
+// Description of a code as the dump prints it.
+static inline const struct cdk_ErrnoDesc *
+cdk_error__code_desc(cdk_ecode_t code) {
+#ifdef CDK_ERROR_DOMAINS
+  return cdk_ecode_desc(code);
+#else
+  return cdk_errno_desc(code);
+#endif
+}
+#endif
+
+enum cdk_EDumpStage {
+  cdk_EDumpStage_HEADER,
+  cdk_EDumpStage_CODE,
+  cdk_EDumpStage_DOMAIN,
+  cdk_EDumpStage_DESC,
+  cdk_EDumpStage_MSG_HEADER,
+  cdk_EDumpStage_MSG,
+  cdk_EDumpStage_MSG_FOOTER,
+  cdk_EDumpStage_FIELDS,
+  cdk_EDumpStage_BTRACE_HEADER,
+  cdk_EDumpStage_FRAME,
+  cdk_EDumpStage_CAUSE,
+  cdk_EDumpStage_NATIVE_HEADER,
+  cdk_EDumpStage_NATIVE,
+  cdk_EDumpStage_SUPPRESSED,
+  cdk_EDumpStage_END,
+};
+
+/**
+ * Dump cursor, zero-initialize it to start a dump from the beginning.
+ */
+struct cdk_EDumpCursor {
+  uint16_t stage;  // Current enum cdk_EDumpStage
+  uint16_t sub;    // Piece within current item
+  uint32_t item;   // Frame index, or format position for messages
+  uint32_t arg;    // Offset of next deferred argument, or frames segment
+  uint32_t offset; // Bytes of current piece already emitted
+  uint32_t pad;    // Padding of current deferred conversion already emitted
+#if defined(CDK_ERROR_BTRACE_FP) && !defined(CDK_ERROR_BTRACE_FP_RAW)
+  // Current native frame, resolved once before its first piece.
+  const char *native_file; // Object holding it, NULL if unknown
+  const char *native_sym;  // Symbol holding it, NULL if unknown
+  uintptr_t native_base;   // Address of the symbol, or of the object
+#endif
+};
+
+/**
+ * Sink receiving dump pieces, non-zero return value stops the dump.
+ */
+typedef int (*cdk_error_sink_t)(void *ctx, const char *data, size_t len);
+
+CDK_ERROR_API size_t cdk_error_dumpr(cdk_error_t err,
+                                    struct cdk_EDumpCursor *cursor,
+                                    size_t buf_size, char *buf);
+CDK_ERROR_API int cdk_error_dumps(cdk_error_t err, size_t buf_size, char *buf);
+CDK_ERROR_API int cdk_error_dumpw(cdk_error_t err, cdk_error_sink_t sink,
+                                  void *ctx);
+#if defined(__unix__) || defined(__APPLE__)
+CDK_ERROR_API int cdk_error_dumpfd(cdk_error_t err, int fd);
+#endif
+CDK_ERROR_API int cdk_error_msg(cdk_error_t err, size_t buf_size, char *buf);
+
+#ifdef CDK_ERROR__DEFINE
+
+/**
+ * Format unsigned `value` with at least `min_digits` digits, `buf` must hold
+ * max(22, min_digits) bytes. Returns number of characters written.
+ */
+static inline size_t cdk_error__utoa(char *buf, uint64_t value, unsigned base,
+                                     size_t min_digits, int upper) {
+  const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+  char tmp[24];
+  size_t len = 0, i = 0;
+
+  do {
+    tmp[len++] = digits[value % base];
+    value /= base;
+  } while (value);
+
+  for (; i + len < min_digits; i++) {
+    buf[i] = '0';
+  }
+  while (len) {
+    buf[i++] = tmp[--len];
+  }
+
+  return i;
+}
+
+/**
+ * Copy `len` bytes to `buf` at `offset`, truncating and keeping `buf`
+ * NUL-terminated. Returns offset past the whole source, like snprintf.
+ */
+static inline size_t cdk_error__put(char *buf, size_t buf_size, size_t offset,
+                                    const char *src, size_t len) {
+  if (offset < buf_size) {
+    size_t room = buf_size - offset - 1;
+    size_t copy_len = len < room ? len : room;
+    memcpy(buf + offset, src, copy_len);
+    buf[offset + copy_len] = '\0';
+  }
+  return offset + len;
+}
+
+#ifndef CDK_ERROR_OPTIMIZE
+/**
+ * Deferred conversion laid out like printf does it: spaces, sign or base
+ * prefix, zeros, body and trailing spaces. Only the body is rendered, padding
+ * of any length is emitted piece by piece.
+ */
+struct cdk_EConv {
+  const char *body;
+  size_t body_len;  // Length of the whole body
+  size_t body_from; // Offset in the body of the bytes at `body`
+  size_t body_end;  // End of the bytes at `body`, 0 if it is `body_len`
+  char prefix[2];
+  size_t prefix_len;
+  size_t zeros; // Zeros between prefix and body
+  size_t lead;  // Spaces before prefix
+  size_t trail; // Spaces after body
+};
+
+/**
+ * Pad `conv` to width of `spec`, with zeros if `zero_pad` and the '0' flag.
+ */
+static inline void cdk_error__conv_pad(struct cdk_EConv *conv,
+                                       const struct cdk_EFmtSpec *spec,
+                                       int zero_pad) {
+  size_t width = spec->width > 0 ? (size_t)spec->width : 0;
+  size_t len = conv->prefix_len + conv->zeros + conv->body_len;
+  size_t pad = width > len ? width - len : 0;
+
+  if (strchr(spec->flags, '-')) {
+    conv->trail = pad;
+  } else if (zero_pad && strchr(spec->flags, '0')) {
+    conv->zeros += pad;
+  } else {
+    conv->lead = pad;
+  }
+}
+
+/**
+ * Lay out integer, character or pointer conversion of a captured argument,
+ * its body is rendered in `scratch`.
+ */
+static inline void cdk_error__conv_int(const struct cdk_EFmtSpec *spec,
+                                       const char *arg, char *scratch,
+                                       struct cdk_EConv *conv) {
+  unsigned base = 10;
+  uint64_t value;
+
+  memcpy(&value, arg + 1, sizeof(value));
+  *conv = (struct cdk_EConv){.body = scratch};
+
+  switch (spec->conv) {
+  case 'c':
+    scratch[0] = (char)value;
+    conv->body_len = 1;
+    cdk_error__conv_pad(conv, spec, 0);
+    return;
+  case 'd':
+  case 'i':
+    if ((int64_t)value < 0) {
+      conv->prefix[conv->prefix_len++] = '-';
+      value = 0 - value;
+    } else if (strchr(spec->flags, '+')) {
+      conv->prefix[conv->prefix_len++] = '+';
+    } else if (strchr(spec->flags, ' ')) {
+      conv->prefix[conv->prefix_len++] = ' ';
+    }
+    break;
+  case 'o':
+    base = 8;
+    break;
+  case 'p':
+    if (!value) {
+      conv->body = "(nil)";
+      conv->body_len = 5;
+      cdk_error__conv_pad(conv, spec, 0);
+      return;
+    }
+    memcpy(conv->prefix, "0x", 2);
+    conv->prefix_len = 2;
+    base = 16;
+    break;
+  case 'x':
+  case 'X':
+    base = 16;
+    if (value && strchr(spec->flags, '#')) {
+      conv->prefix[conv->prefix_len++] = '0';
+      conv->prefix[conv->prefix_len++] = spec->conv;
+    }
+    break;
+  default:;
+  }
+
+  if (spec->prec != 0 || value != 0) {
+    conv->body_len =
+        cdk_error__utoa(scratch, value, base, 1, spec->conv == 'X');
+  }
+  if (spec->prec > 0 && (size_t)spec->prec > conv->body_len) {
+    conv->zeros = (size_t)spec->prec - conv->body_len;
+  }
+  if (spec->conv == 'o' && strchr(spec->flags, '#') && !conv->zeros &&
+      (conv->body_len == 0 || scratch[0] != '0')) {
+    conv->zeros = 1;
+  }
+
+  cdk_error__conv_pad(conv, spec, spec->prec < 0);
+}
+
+/**
+ * Render non-negative `value` below 1e18 with `prec` fractional digits.
+ */
+static inline size_t cdk_error__ftoa(char *buf, double value, int prec,
+                                     int point) {
+  static const uint64_t pow10[] = {1,
+                                   10,
+                                   100,
+                                   1000,
+                                   10000,
+                                   100000,
+                                   1000000,
+                                   10000000,
+                                   100000000,
+                                   1000000000,
+                                   10000000000ULL,
+                                   100000000000ULL,
+                                   1000000000000ULL,
+                                   10000000000000ULL,
+                                   100000000000000ULL,
+                                   1000000000000000ULL,
+                                   10000000000000000ULL,
+                                   100000000000000000ULL};
+  uint64_t int_part = (uint64_t)value;
+  uint64_t frac_part =
+      (uint64_t)((value - (double)int_part) * (double)pow10[prec] + 0.5);
+  size_t len;
+
+  if (frac_part >= pow10[prec]) {
+    int_part++;
+    frac_part -= pow10[prec];
+  }
+
+  len = cdk_error__utoa(buf, int_part, 10, 1, 0);
+  if (prec || point) {
+    buf[len++] = '.';
+  }
+  if (prec) {
+    len += cdk_error__utoa(buf + len, frac_part, 10, prec, 0);
+  }
+
+  return len;
+}
+
+/**
+ * Render bytes `from` to `*end` of `%f` of `value`, an integer of at least
+ * 1e18 and at most DBL_MAX, to `buf`. All digits are exact, like printf gives
+ * them, a window of at most CDK_EDUMP_SCRATCH bytes is rendered per call.
+ * Returns length of the whole body.
+ */
+static inline size_t cdk_error__ftoa_wide(char *buf, double value, int prec,
+                                          int point, size_t from,
+                                          size_t *end) {
+  uint32_t words[34] = {0}; // Little-endian value, 971 + 53 bits at most
+  char digits[34 * 10];     // Decimal digits, filled from the end
+  size_t digits_at = sizeof(digits), words_len, len;
+  uint64_t bits, mant;
+  unsigned shift, bit;
+
+  memcpy(&bits, &value, sizeof(bits));
+  mant = (bits & ((1ULL << 52) - 1)) | 1ULL << 52;
+  shift = (unsigned)(bits >> 52 & 0x7ff) - 1075;
+  bit = shift % 32;
+  words_len = shift / 32 + 3;
+  words[shift / 32] = (uint32_t)mant;
+  words[shift / 32 + 1] = (uint32_t)(mant >> 32);
+  for (size_t i = words_len - 1; bit && i > shift / 32; i--) {
+    words[i] = words[i] << bit | words[i - 1] >> (32 - bit);
+  }
+  words[shift / 32] <<= bit;
+
+  // Nine digits per division by 1e9, leading zeros are dropped at the end.
+  while (words_len) {
+    uint64_t rem = 0;
+
+    for (size_t i = words_len; i-- > 0;) {
+      uint64_t cur = rem << 32 | words[i];
+      words[i] = (uint32_t)(cur / 1000000000);
+      rem = cur % 1000000000;
+    }
+    for (int i = 0; i < 9; i++) {
+      digits[--digits_at] = (char)('0' + rem % 10);
+      rem /= 10;
+    }
+    while (words_len && !words[words_len - 1]) {
+      words_len--;
+    }
+  }
+  while (digits[digits_at] == '0') {
+    digits_at++;
+  }
+
+  len = sizeof(digits) - digits_at;
+  len += (prec || point) + (size_t)prec;
+  *end = len - from < CDK_EDUMP_SCRATCH ? len : from + CDK_EDUMP_SCRATCH;
+  for (size_t i = from; i < *end; i++) {
+    size_t at = digits_at + i;
+
+    // Integer digits, the point and zeros of the fraction.
+    buf[i - from] = at < sizeof(digits)   ? digits[at]
+                    : at == sizeof(digits) ? '.'
+                                           : '0';
+  }
+
+  return len;
+}
+
+/**
+ * Render `value` in [1, 10) scientific notation, `exp10` is its exponent.
+ */
+static inline size_t cdk_error__etoa(char *buf, double value, int exp10,
+                                     int prec, int point, int upper) {
+  size_t len = cdk_error__ftoa(buf, value, prec, point);
+
+  buf[len++] = upper ? 'E' : 'e';
+  buf[len++] = exp10 < 0 ? '-' : '+';
+  len += cdk_error__utoa(buf + len, exp10 < 0 ? -exp10 : exp10, 10, 2, 0);
+
+  return len;
+}
+
+/**
+ * Lay out floating point conversion of a captured argument, its body is
+ * rendered in `scratch`, bodies longer than that a window from `from` on.
+ * Output matches printf up to rounding of the last digit, precision is
+ * limited to 17 digits and `%a` is rendered like `%e`.
+ */
+static inline void cdk_error__conv_dbl(const struct cdk_EFmtSpec *spec,
+                                       const char *arg, size_t from,
+                                       char *scratch, struct cdk_EConv *out) {
+  char *body = scratch;
+  char *prefix = out->prefix;
+  size_t prefix_len = 0, body_len;
+  int upper = spec->conv >= 'A' && spec->conv <= 'Z';
+  int point = strchr(spec->flags, '#') != NULL;
+  int prec = spec->prec < 0 ? 6 : spec->prec > 17 ? 17 : spec->prec;
+  char conv = upper ? spec->conv - 'A' + 'a' : spec->conv;
+  double value, mantissa;
+  uint64_t bits;
+  int exp10 = 0;
+
+  memcpy(&value, arg + 1, sizeof(value));
+  memcpy(&bits, arg + 1, sizeof(bits));
+  *out = (struct cdk_EConv){.body = scratch};
+
+  // Sign bit rather than `value < 0`, -0.0 keeps its sign like in printf.
+  if (bits >> 63) {
+    prefix[prefix_len++] = '-';
+    value = -value;
+  } else if (strchr(spec->flags, '+')) {
+    prefix[prefix_len++] = '+';
+  } else if (strchr(spec->flags, ' ')) {
+    prefix[prefix_len++] = ' ';
+  }
+
+  if (value != value || value > DBL_MAX) {
+    out->body = value != value ? (upper ? "NAN" : "nan")
+                                : (upper ? "INF" : "inf");
+    out->body_len = 3;
+    out->prefix_len = prefix_len;
+    cdk_error__conv_pad(out, spec, 0);
+    return;
+  }
+
+  mantissa = value;
+  if (mantissa != 0) {
+    while (mantissa >= 10) {
+      mantissa /= 10;
+      exp10++;
+    }
+    while (mantissa < 1) {
+      mantissa *= 10;
+      exp10--;
+    }
+  }
+
+  if (conv == 'g') {
+    int sig = prec ? prec : 1;
+    double round = 0.5;
+    for (int i = 1; i < sig; i++) {
+      round /= 10;
+    }
+    int exp_rounded = mantissa + round >= 10 ? exp10 + 1 : exp10;
+
+    if (exp_rounded < sig && exp_rounded >= -4 && value < 1e18) {
+      body_len = cdk_error__ftoa(body, value, sig - 1 - exp_rounded, point);
+    } else {
+      if (mantissa + round >= 10) {
+        mantissa /= 10;
+        exp10++;
+      }
+      body_len =
+          cdk_error__etoa(body, mantissa, exp10, sig - 1, point, upper);
+    }
+
+    if (!point && memchr(body, '.', body_len)) {
+      char *exp = memchr(body, upper ? 'E' : 'e', body_len);
+      size_t mant_len = exp ? (size_t)(exp - body) : body_len;
+      size_t stripped = mant_len;
+      while (body[stripped - 1] == '0') {
+        stripped--;
+      }
+      if (body[stripped - 1] == '.') {
+        stripped--;
+      }
+      memmove(body + stripped, body + mant_len, body_len - mant_len);
+      body_len -= mant_len - stripped;
+    }
+  } else if (conv == 'f' && value < 1e18) {
+    body_len = cdk_error__ftoa(body, value, prec, point);
+  } else if (conv == 'f') {
+    body_len = cdk_error__ftoa_wide(body, value, prec, point, from,
+                                    &out->body_end);
+    out->body_from = from;
+  } else {
+    double round = 0.5;
+    for (int i = 0; i < prec; i++) {
+      round /= 10;
+    }
+    if (mantissa + round >= 10) {
+      mantissa /= 10;
+      exp10++;
+    }
+    body_len = cdk_error__etoa(body, mantissa, exp10, prec, point, upper);
+  }
+
+  out->body_len = body_len;
+  out->prefix_len = prefix_len;
+  cdk_error__conv_pad(out, spec, 1);
+}
+
+/**
+ * Size of captured argument record starting at `arg`.
+ */
+static inline size_t cdk_error__arg_size(const char *arg) {
+  switch (*arg) {
+  case cdk_EArg_END:
+    return 0;
+  case cdk_EArg_STR:
+    return 1 + strlen(arg + 1) + 1;
+  default:
+    return 1 + sizeof(uint64_t);
+  }
+}
+
+/**
+ * Produce next piece of deferred message. Returns 0 once the message is done.
+ */
+static inline int cdk_error__dfmt_piece(const struct cdk_Error *err,
+                                        struct cdk_EDumpCursor *cursor,
+                                        char *scratch, const char **piece,
+                                        size_t *piece_len) {
+  const char *fmt = err->msg + cursor->item;
+  const char *arg = err->_msg_buf + cursor->arg;
+  struct cdk_EFmtSpec spec;
+  const char *end;
+
+  if (!*fmt) {
+    return 0;
+  }
+
+  *piece = scratch;
+  *piece_len = 0;
+
+  if (*fmt != '%') {
+    const char *conv = strchr(fmt, '%');
+    *piece = fmt;
+    *piece_len = conv ? (size_t)(conv - fmt) : strlen(fmt);
+    cursor->item += *piece_len;
+    return 1;
+  }
+
+  end = cdk_error__fmt_spec(fmt + 1, &spec);
+
+  if (spec.conv == '%') {
+    *piece = "%";
+    *piece_len = 1;
+    cursor->item = end - err->msg;
+    return 1;
+  }
+
+  // Resolve '*' width and precision from captured arguments.
+  if (spec.width == -2) {
+    int64_t star = 0;
+    if (*arg == cdk_EArg_INT) {
+      memcpy(&star, arg + 1, sizeof(star));
+      arg += cdk_error__arg_size(arg);
+    }
+    if (star < 0) {
+      star = -star;
+      strcat(spec.flags, "-");
+    }
+    spec.width = (int)(star > INT_MAX ? INT_MAX : star);
+  }
+  if (spec.prec == -2) {
+    int64_t star = -1;
+    if (*arg == cdk_EArg_INT) {
+      memcpy(&star, arg + 1, sizeof(star));
+      arg += cdk_error__arg_size(arg);
+    }
+    spec.prec = (int)(star < 0 ? -1 : star);
+  }
+
+  if (spec.conv && spec.conv != 'n' && *arg != cdk_EArg_END) {
+    struct cdk_EConv conv;
+
+    switch (*arg) {
+    case cdk_EArg_STR:
+      // Strings were cut to their precision when captured.
+      conv = (struct cdk_EConv){.body = arg + 1, .body_len = strlen(arg + 1)};
+      cdk_error__conv_pad(&conv, &spec, 0);
+      break;
+    case cdk_EArg_DBL:
+      cdk_error__conv_dbl(&spec, arg, cursor->sub == 3 ? cursor->pad : 0,
+                          scratch, &conv);
+      break;
+    default:
+      cdk_error__conv_int(&spec, arg, scratch, &conv);
+    }
+
+    // Spaces, prefix, zeros, body and spaces, padding a scratch at a time.
+    for (; cursor->sub < 5; cursor->sub++) {
+      size_t pad = cursor->sub == 0   ? conv.lead
+                   : cursor->sub == 2 ? conv.zeros
+                                      : conv.trail;
+
+      if (cursor->sub == 1 || cursor->sub == 3) {
+        if (cursor->sub == 1) {
+          memcpy(scratch, conv.prefix, conv.prefix_len);
+          *piece = scratch;
+          *piece_len = conv.prefix_len;
+        } else {
+          // Long bodies come a window at a time, `pad` is their offset.
+          size_t body_end = conv.body_end ? conv.body_end : conv.body_len;
+
+          *piece = conv.body + (cursor->pad - conv.body_from);
+          *piece_len = body_end - cursor->pad;
+          cursor->pad = body_end < conv.body_len ? body_end : 0;
+        }
+        if (*piece_len) {
+          if (!cursor->pad) {
+            cursor->sub++;
+          }
+          return 1;
+        }
+        continue;
+      }
+      if (cursor->pad < pad) {
+        *piece = scratch;
+        *piece_len = pad - cursor->pad < CDK_EDUMP_SCRATCH
+                         ? pad - cursor->pad
+                         : CDK_EDUMP_SCRATCH;
+        memset(scratch, cursor->sub == 2 ? '0' : ' ', *piece_len);
+        cursor->pad += *piece_len;
+        if (cursor->pad == pad) {
+          cursor->pad = 0;
+          cursor->sub++;
+        }
+        return 1;
+      }
+    }
+    cursor->sub = 0;
+    *piece_len = 0;
+    arg += cdk_error__arg_size(arg);
+  }
+
+  cursor->item = end - err->msg;
+  cursor->arg = arg - err->_msg_buf;
+  return 1;
+}
+#endif
+
+/*
+ * Frames of a translated error are split into segments by `frames_end` of its
+ * causes. Segment `i` holds frames of cause `i`, the last segment, number
+ * `ecauses_len`, those added since the newest translation.
+ */
+static inline size_t cdk_error__causes_len(cdk_error_t err) {
+#ifdef CDK_ERROR_CAUSE
+  return err->ecauses_len;
+#else
+  (void)err;
+  return 0;
+#endif
+}
+
+static inline size_t cdk_error__segment_start(cdk_error_t err, size_t i) {
+#ifdef CDK_ERROR_CAUSE
+  return i ? err->ecauses[i - 1].frames_end : 0;
+#else
+  (void)err;
+  (void)i;
+  return 0;
+#endif
+}
+
+static inline size_t cdk_error__segment_end(cdk_error_t err, size_t i) {
+#ifdef CDK_ERROR_CAUSE
+  if (i < err->ecauses_len) {
+    return err->ecauses[i].frames_end;
+  }
+#endif
+  (void)i;
+  return cdk_error_depth(err);
+}
+
+#ifdef CDK_ERROR_FIELDS
+/**
+ * Render value of `field`, in `scratch` unless it is a string. Returns length.
+ */
+static inline size_t cdk_error__field_value(const struct cdk_EField *field,
+                                            char *scratch,
+                                            const char **piece) {
+  size_t len = 0;
+
+  switch (field->type) {
+  case cdk_EFieldType_INT:
+    if (field->i64 < 0) {
+      scratch[len++] = '-';
+    }
+    return len + cdk_error__utoa(scratch + len,
+                                 field->i64 < 0 ? 0 - (uint64_t)field->i64
+                                                : (uint64_t)field->i64,
+                                 10, 1, 0);
+  case cdk_EFieldType_UINT:
+    return cdk_error__utoa(scratch, field->u64, 10, 1, 0);
+  case cdk_EFieldType_STR:
+    *piece = field->str ? field->str : "(null)";
+    return strlen(*piece);
+  default:
+    for (size_t i = 0; i < field->len; i++) {
+      len += cdk_error__utoa(scratch + len, field->bytes[i], 16, 2, 0);
+    }
+    if (field->size > field->len) {
+      memcpy(scratch + len, "...", 3);
+      len += 3;
+    }
+    return len;
+  }
+}
+#endif
+
+/**
+ * Produce next piece of the dump and advance `cursor`. A call either emits a
+ * piece of the current stage or moves to the next stage with an empty piece.
+ * Returns 0 once the dump is complete.
+ */
+static inline int cdk_error__dump_piece(cdk_error_t err,
+                                        struct cdk_EDumpCursor *cursor,
+                                        char *scratch, const char **piece,
+                                        size_t *piece_len) {
+  const struct cdk_ErrnoDesc *desc;
+  size_t len = 0;
+
+  *piece = scratch;
+  *piece_len = 0;
+  cursor->offset = 0;
+
+  switch (cursor->stage) {
+  case cdk_EDumpStage_HEADER:
+    *piece = "====== ERROR DUMP ======\nError code: ";
+    *piece_len = strlen(*piece);
+    cursor->stage = cdk_EDumpStage_CODE;
+    break;
+
+  case cdk_EDumpStage_CODE:
+    len = cdk_error__utoa(scratch, err->code, 10, 1, 0);
+    memcpy(scratch + len, "\nError desc: ", 13);
+    *piece_len = len + 13;
+    cursor->stage = cdk_EDumpStage_DESC;
+#ifdef CDK_ERROR_DOMAINS
+    if (err->domain) {
+      *piece_len = len + 1;
+      cursor->stage = cdk_EDumpStage_DOMAIN;
+    }
+#endif
+    break;
+
+#ifdef CDK_ERROR_DOMAINS
+  case cdk_EDumpStage_DOMAIN:
+    switch (cursor->sub++) {
+    case 0:
+      *piece = "Error domain: ";
+      *piece_len = strlen(*piece);
+      break;
+    case 1: {
+      const struct cdk_EDomain *domain = cdk_edomain_get(err->domain);
+
+      if (domain) {
+        *piece = domain->name;
+        *piece_len = strlen(domain->name);
+      } else {
+        *piece_len = cdk_error__utoa(scratch, err->domain, 10, 1, 0);
+      }
+      break;
+    }
+    default:
+      *piece = "\nError desc: ";
+      *piece_len = strlen(*piece);
+      cursor->sub = 0;
+      cursor->stage = cdk_EDumpStage_DESC;
+    }
+    break;
+#endif
+
+  case cdk_EDumpStage_DESC:
+    desc = cdk_error__code_desc(cdk_error_code(err));
+    if (desc && cursor->sub == 0) {
+      *piece = desc->desc;
+      *piece_len = strlen(desc->desc);
+      cursor->sub = 1;
+      break;
+    }
+    if (!desc) {
+      memcpy(scratch, "Unknown error ", 14);
+      len = 14 + cdk_error__utoa(scratch + 14, err->code, 10, 1, 0);
+    }
+    scratch[len] = '\n';
+    *piece_len = len + 1;
+    cursor->sub = 0;
+    cursor->stage = cdk_EDumpStage_MSG_HEADER;
+    break;
+
+  case cdk_EDumpStage_MSG_HEADER:
+    if (err->type == cdk_ErrorType_INT) {
+      cursor->stage = cdk_EDumpStage_FIELDS;
+      break;
+    }
+    *piece = "------------------------\n Error msg: ";
+    *piece_len = strlen(*piece);
+    cursor->stage = cdk_EDumpStage_MSG;
+    break;
+
+  case cdk_EDumpStage_MSG:
+    switch (err->type) {
+    case cdk_ErrorType_STR:
+      if (cursor->item == 0) {
+        *piece = err->msg ? err->msg : "(null)";
+        *piece_len = strlen(*piece);
+        cursor->item = 1;
+        return 1;
+      }
+      break;
+#ifndef CDK_ERROR_OPTIMIZE
+    case cdk_ErrorType_FSTR:
+      if (cursor->item == 0) {
+        size_t size;
+        const char *msg = cdk_error__fmsg(err, &size);
+        const char *end = memchr(msg, '\0', size);
+        *piece = msg;
+        *piece_len = end ? (size_t)(end - msg) : size;
+        cursor->item = 1;
+        return 1;
+      }
+      break;
+    case cdk_ErrorType_DFSTR:
+      if (cdk_error__dfmt_piece(err, cursor, scratch, piece, piece_len)) {
+        return 1;
+      }
+      break;
+#endif
+    default:;
+    }
+    cursor->item = 0;
+    cursor->arg = 0;
+    cursor->sub = 0;
+    cursor->stage = cdk_EDumpStage_MSG_FOOTER;
+    break;
+
+  case cdk_EDumpStage_MSG_FOOTER:
+    *piece = "\n";
+    *piece_len = 1;
+    cursor->stage = cdk_EDumpStage_FIELDS;
+    break;
+
+  case cdk_EDumpStage_FIELDS:
+#ifdef CDK_ERROR_FIELDS
+    if (cursor->item < err->efields_len) {
+      const struct cdk_EField *field = &err->efields[cursor->item];
+
+      switch (cursor->sub++) {
+      case 0:
+        *piece = cursor->item ? "   "
+                              : "------------------------\n Fields:\n   ";
+        *piece_len = strlen(*piece);
+        break;
+      case 1:
+        *piece = field->key;
+        *piece_len = strlen(field->key);
+        break;
+      case 2:
+        *piece = "=";
+        *piece_len = 1;
+        break;
+      case 3:
+        *piece_len = cdk_error__field_value(field, scratch, piece);
+        break;
+      default:
+        *piece = "\n";
+        *piece_len = 1;
+        cursor->sub = 0;
+        cursor->item++;
+      }
+      break;
+    }
+    cursor->item = 0;
+#endif
+    cursor->stage = cdk_EDumpStage_BTRACE_HEADER;
+    break;
+
+  case cdk_EDumpStage_BTRACE_HEADER:
+    *piece = "------------------------\n Backtrace:\n";
+    *piece_len = strlen(*piece);
+    cursor->arg = cdk_error__causes_len(err);
+    cursor->item = cdk_error__segment_start(err, cursor->arg);
+    cursor->stage = cdk_EDumpStage_FRAME;
+    break;
+
+  case cdk_EDumpStage_FRAME: {
+    size_t end = cdk_error__segment_end(err, cursor->arg);
+    const struct cdk_EFrame *frame;
+
+    if (cursor->item >= end) {
+      cursor->stage =
+          cursor->arg ? cdk_EDumpStage_CAUSE : cdk_EDumpStage_NATIVE_HEADER;
+      break;
+    }
+
+    frame = cdk_error_frame(err, cursor->item);
+#ifdef CDK_ERROR_BTRACE_RING
+    if (!frame) {
+      size_t kept = CDK_ERROR_BTRACE_PIN + (size_t)err->eframes_omitted;
+
+      end = end < kept ? end : kept;
+      memcpy(scratch, "   ... ", 7);
+      len = 7 + cdk_error__utoa(scratch + 7, end - cursor->item, 10, 1, 0);
+      memcpy(scratch + len, " frames omitted\n", 16);
+      *piece_len = len + 16;
+      cursor->item = end;
+      break;
+    }
+#endif
+
+    switch (cursor->sub++) {
+    case 0:
+      memcpy(scratch, "   [", 4);
+      len = 4 + cdk_error__utoa(
+                    scratch + 4,
+                    cursor->item - cdk_error__segment_start(err, cursor->arg),
+                    10, 2, 0);
+      memcpy(scratch + len, "] ", 2);
+      *piece_len = len + 2;
+      break;
+    case 1:
+      *piece = cdk_eframe_file(frame);
+      *piece_len = strlen(*piece);
+      break;
+    case 2:
+      *piece = ":";
+      *piece_len = 1;
+      break;
+    case 3:
+      *piece = cdk_eframe_func(frame);
+      *piece_len = strlen(*piece);
+      break;
+    default:
+      scratch[0] = ':';
+      len = 1 + cdk_error__utoa(scratch + 1, cdk_eframe_line(frame), 10, 1, 0);
+      scratch[len] = '\n';
+      *piece_len = len + 1;
+      cursor->sub = 0;
+      cursor->item++;
+    }
+    break;
+  }
+
+#ifdef CDK_ERROR_CAUSE
+  case cdk_EDumpStage_CAUSE: {
+    // Segment `arg` was printed, its cause `arg - 1` follows.
+    const struct cdk_ECause *cause = &err->ecauses[cursor->arg - 1];
+    const char *msg = cause->msg;
+
+    if (!msg && cause->msg_off >= 0) {
+      msg = err->_ecause_buf + cause->msg_off;
+    }
+
+    switch (cursor->sub++) {
+    case 0:
+      *piece = "------------------------\n Caused by: ";
+      *piece_len = strlen(*piece);
+      break;
+    case 1:
+      len = cdk_error__utoa(scratch, cause->code, 10, 1, 0);
+      memcpy(scratch + len, " (", 2);
+      *piece_len = len + 2;
+      break;
+    case 2:
+      desc = cdk_error__code_desc(cdk_ecause__code(cause));
+      *piece = desc ? desc->desc : "Unknown error";
+      *piece_len = strlen(*piece);
+      break;
+    case 3:
+      *piece = msg ? ")\n Error msg: " : ")\n";
+      *piece_len = strlen(*piece);
+      cursor->sub = msg ? 4 : 6;
+      break;
+    case 4:
+      *piece = msg;
+      *piece_len = strlen(msg);
+      break;
+    case 5:
+      *piece = "\n";
+      *piece_len = 1;
+      break;
+    default:
+      *piece = " Backtrace:\n";
+      *piece_len = strlen(*piece);
+      cursor->sub = 0;
+      cursor->arg--;
+      cursor->item = cdk_error__segment_start(err, cursor->arg);
+      cursor->stage = cdk_EDumpStage_FRAME;
+    }
+    break;
+  }
+#endif
+
+  case cdk_EDumpStage_NATIVE_HEADER:
+#ifdef CDK_ERROR_BTRACE_FP
+    if (err->epcs_len) {
+      *piece = "------------------------\n Native backtrace:\n";
+      *piece_len = strlen(*piece);
+      cursor->item = 0;
+      cursor->stage = cdk_EDumpStage_NATIVE;
+      break;
+    }
+#endif
+    cursor->stage = cdk_EDumpStage_SUPPRESSED;
+    break;
+
+#ifdef CDK_ERROR_BTRACE_FP
+  case cdk_EDumpStage_NATIVE: {
+    const char *pc;
+
+    if (cursor->item >= err->epcs_len) {
+      cursor->item = 0;
+      cursor->stage = cdk_EDumpStage_SUPPRESSED;
+      break;
+    }
+    pc = err->epcs[cursor->item];
+
+#ifdef CDK_ERROR_BTRACE_FP_RAW
+    memcpy(scratch, "   [", 4);
+    len = 4 + cdk_error__utoa(scratch + 4, cursor->item, 10, 2, 0);
+    memcpy(scratch + len, "] [0x", 5);
+    len += 5;
+    len += cdk_error__utoa(scratch + len, (uintptr_t)pc, 16, 1, 0);
+    memcpy(scratch + len, "]\n", 2);
+    *piece_len = len + 2;
+    cursor->item++;
+#else
+    switch (cursor->sub++) {
+    case 0: {
+      Dl_info info;
+
+      cdk_error__pc_info(pc, &info);
+      cursor->native_file = info.dli_fname;
+      cursor->native_sym = info.dli_sname;
+      // Offsets are from the symbol, or from the object if it has none.
+      cursor->native_base =
+          (uintptr_t)(info.dli_sname ? info.dli_saddr : info.dli_fbase);
+      break;
+    }
+    case 1:
+      memcpy(scratch, "   [", 4);
+      len = 4 + cdk_error__utoa(scratch + 4, cursor->item, 10, 2, 0);
+      memcpy(scratch + len, "] ", 2);
+      *piece_len = len + 2;
+      break;
+    case 2:
+      *piece = cursor->native_file ? cursor->native_file : "??";
+      *piece_len = strlen(*piece);
+      break;
+    case 3:
+      *piece = "(";
+      *piece_len = 1;
+      break;
+    case 4:
+      *piece = cursor->native_sym ? cursor->native_sym : "";
+      *piece_len = strlen(*piece);
+      break;
+    default:
+      memcpy(scratch, "+0x", 3);
+      len = 3 + cdk_error__utoa(scratch + 3,
+                                (uintptr_t)pc - cursor->native_base, 16, 1, 0);
+      memcpy(scratch + len, ") [0x", 5);
+      len += 5;
+      len += cdk_error__utoa(scratch + len, (uintptr_t)pc, 16, 1, 0);
+      memcpy(scratch + len, "]\n", 2);
+      *piece_len = len + 2;
+      cursor->sub = 0;
+      cursor->item++;
+    }
+#endif
+    break;
+  }
+#endif
+
+  case cdk_EDumpStage_SUPPRESSED:
+#ifdef CDK_ERROR_SAMPLE
+    if (err->esuppressed) {
+      memcpy(scratch, "Suppressed: ", 12);
+      len = 12 + cdk_error__utoa(scratch + 12, err->esuppressed, 10, 1, 0);
+      memcpy(scratch + len, " traces\n", 8);
+      *piece_len = len + 8;
+    }
+#endif
+    cursor->stage = cdk_EDumpStage_END;
+    break;
+
+  default:
+    return 0;
+  }
+
+  return 1;
+}
+
+/**
+ * Write up to `buf_size` bytes of the dump to `buf`, continuing where `cursor`
+ * points. The output is not NUL-terminated. Returns number of bytes written,
+ * 0 once the dump is complete. An empty `buf` could not tell the two apart,
+ * so `buf_size` of 0 is rejected with CDK_EDUMP_EINVAL.
+ */
+CDK_ERROR_API size_t cdk_error_dumpr(cdk_error_t err,
+                                    struct cdk_EDumpCursor *cursor,
+                                    size_t buf_size, char *buf) {
+  char scratch[CDK_EDUMP_SCRATCH];
+  size_t len = 0;
+
+  if (!buf_size) {
+    return CDK_EDUMP_EINVAL;
+  }
+
+  if (cursor->stage == cdk_EDumpStage_HEADER && cursor->offset == 0) {
+    cdk_error__on_top(err);
+  }
+
+  for (;;) {
+    struct cdk_EDumpCursor next = *cursor;
+    const char *piece;
+    size_t piece_len, copy_len;
+
+    if (!cdk_error__dump_piece(err, &next, scratch, &piece, &piece_len)) {
+      break;
+    }
+
+    piece += cursor->offset;
+    piece_len -= cursor->offset;
+    copy_len = piece_len < buf_size - len ? piece_len : buf_size - len;
+    memcpy(buf + len, piece, copy_len);
+    len += copy_len;
+
+    if (copy_len < piece_len) {
+      cursor->offset += copy_len;
+      break;
+    }
+    *cursor = next;
+  }
+
+  return len;
+}
+
+/**
+ * Dump struct cdk_Error to string. Returns ENOBUFS if `buf` is too small, in
+ * which case it holds the truncated dump.
+ */
+CDK_ERROR_API int cdk_error_dumps(cdk_error_t err, size_t buf_size, char *buf) {
+  struct cdk_EDumpCursor cursor = {0};
+  size_t len;
+
+  if (buf_size < 2) {
+    if (buf_size) {
+      buf[0] = '\0';
+    }
+    return ENOBUFS;
+  }
+
+  len = cdk_error_dumpr(err, &cursor, buf_size - 1, buf);
+  buf[len] = '\0';
+
+  return cursor.stage == cdk_EDumpStage_END ? 0 : ENOBUFS;
+}
+
+/**
+ * Stream dump of struct cdk_Error to `sink`. Returns first non-zero value
+ * returned by `sink`, 0 on success.
+ */
+CDK_ERROR_API int cdk_error_dumpw(cdk_error_t err, cdk_error_sink_t sink,
+                                  void *ctx) {
+  struct cdk_EDumpCursor cursor = {0};
+  char scratch[CDK_EDUMP_SCRATCH];
+  const char *piece;
+  size_t piece_len;
+  int ret;
+
+  cdk_error__on_top(err);
+  while (cdk_error__dump_piece(err, &cursor, scratch, &piece, &piece_len)) {
+    if (piece_len && (ret = sink(ctx, piece, piece_len))) {
+      return ret;
+    }
+  }
+
+  return 0;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+/**
+ * Write dump of struct cdk_Error to `fd`, batching pieces with writev. Leaves
+ * errno untouched. Returns 0 on success or errno value of failed writev.
+ */
+CDK_ERROR_API int cdk_error_dumpfd(cdk_error_t err, int fd) {
+  char scratch[CDK_EDUMP_IOV][CDK_EDUMP_SCRATCH];
+  struct iovec iov[CDK_EDUMP_IOV];
+  struct cdk_EDumpCursor cursor = {0};
+  int saved_errno = errno;
+  int more = 1, ret = 0;
+
+  cdk_error__on_top(err);
+  while (more && !ret) {
+    struct iovec *pending = iov;
+    int iov_len = 0;
+
+    while (iov_len < CDK_EDUMP_IOV) {
+      const char *piece;
+      size_t piece_len;
+
+      more = cdk_error__dump_piece(err, &cursor, scratch[iov_len], &piece,
+                                   &piece_len);
+      if (!more) {
+        break;
+      }
+      if (piece_len) {
+        iov[iov_len].iov_base = (void *)piece;
+        iov[iov_len].iov_len = piece_len;
+        iov_len++;
+      }
+    }
+
+    while (iov_len > 0) {
+      ssize_t written = writev(fd, pending, iov_len);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        ret = errno;
+        break;
+      }
+      while (iov_len > 0 && (size_t)written >= pending->iov_len) {
+        written -= pending->iov_len;
+        pending++;
+        iov_len--;
+      }
+      if (iov_len > 0) {
+        pending->iov_base = (char *)pending->iov_base + written;
+        pending->iov_len -= written;
+      }
+    }
+  }
+
+  errno = saved_errno;
+  return ret;
+}
+#endif
+
+/**
+ * Write error message to `buf`, formatting it first if it was deferred. Errors
+ * without message produce an empty string. Returns ENOBUFS if the message was
+ * truncated.
+ */
+CDK_ERROR_API int cdk_error_msg(cdk_error_t err, size_t buf_size, char *buf) {
+  struct cdk_EDumpCursor cursor = {.stage = cdk_EDumpStage_MSG};
+  char scratch[CDK_EDUMP_SCRATCH];
+  const char *piece;
+  size_t piece_len, offset;
+
+  if (!buf_size) {
+    return ENOBUFS;
+  }
+
+  offset = cdk_error__put(buf, buf_size, 0, "", 0);
+  while (cursor.stage == cdk_EDumpStage_MSG &&
+         cdk_error__dump_piece(err, &cursor, scratch, &piece, &piece_len)) {
+    offset = cdk_error__put(buf, buf_size, offset, piece, piece_len);
+  }
+
+  return offset < buf_size ? 0 : ENOBUFS;
+}
+#endif
+
+CDK_ERROR_COLD void cdk_error_add_frame(cdk_error_t err,
+                                        struct cdk_EFrame *frame);
+CDK_ERROR_COLD void cdk_error__wrap(cdk_error_t err, CDK_ERROR_LOC_PARAMS);
+
+#ifdef CDK_ERROR__DEFINE
+static inline void cdk_error__push_frame(cdk_error_t err,
+                                         const struct cdk_EFrame *frame) {
+#ifdef CDK_ERROR_SAMPLE
+  if (err->_enotrace) {
+    // Nothing is traced, but the wrap still counts towards its callsite.
+    err->_ewraps++;
+#ifdef CDK_ERROR_COUNTERS
+    cdk_ecounter__wrap(err);
+#endif
+    return;
+  }
+#endif
+#ifdef CDK_ERROR_FINGERPRINT
+  cdk_efingerprint__wrap(err, frame);
+#endif
+  if (err->eframes_len >= CDK_ERROR_BTRACE_MAX) {
+#ifdef CDK_ERROR_BTRACE_RING
+    err->eframes[CDK_ERROR_BTRACE_PIN +
+                 err->eframes_omitted % CDK_ERROR__BTRACE_RING] = *frame;
+    err->eframes_omitted++;
+    cdk_error__on_wrap(err, frame);
+#endif
+    return;
+  }
+  err->eframes[err->eframes_len++] = *frame;
+  cdk_error__on_wrap(err, frame);
+}
+
+CDK_ERROR_COLD void cdk_error_add_frame(cdk_error_t err,
+                                        struct cdk_EFrame *frame) {
+  cdk_error__push_frame(err, frame);
+}
+
+/**
+ * Add frame of the wrapping location, takes location like the constructors
+ * so callsites do not build the frame on their stack.
+ */
+CDK_ERROR_COLD void cdk_error__wrap(cdk_error_t err, CDK_ERROR_LOC_PARAMS) {
+  struct cdk_EFrame frame = CDK_ERROR_LOC_FRAME;
+  cdk_error__push_frame(err, &frame);
+}
+#endif
+
+#ifndef CDK_ERROR_OPTIMIZE
+#define cdk_error_wrap(err)                                                    \
+  ({                                                                           \
+    cdk_error__wrap(err, CDK_ERROR_LOC());                                     \
+    err;                                                                       \
+  })
+#else
+#define cdk_error_wrap(err)
+#endif
+
+#define cdk_error_return(ret, err)                                             \
   ({                                                                           \
     cdk_error_wrap(err);                                                       \
     ret;                                                                       \
   })
 
-#define cdk_errori(err, code)                                                  \
-  cdk_error_int((err), (code), __FILE_NAME__, __func__, __LINE__)
+#define cdk_errori_sampled(err, code, rate)                                    \
+  CDK_ECOUNT(                                                                  \
+      CDK_ESAMPLE(cdk_error_int((err), (code), CDK_ERROR_LOC()), (rate)))
+
+#define cdk_errors_sampled(err, code, msg, rate)                               \
+  CDK_ECOUNT(CDK_ESAMPLE(                                                      \
+      cdk_error_lstr((err), (code), CDK_ERROR_LOC(), (msg)), (rate)))
+
+#define cdk_errord_sampled(err, code, rate, fmt, ...)                          \
+  CDK_ECOUNT(CDK_ESAMPLE(cdk_error_dfstr((err), (code), CDK_ERROR_LOC(),      \
+                                         (fmt), ##__VA_ARGS__),                \
+                         (rate)))
+
+#ifdef CDK_ERROR_DEFER_FSTR
+#define cdk_errorf_sampled(err, code, rate, fmt, ...)                          \
+  cdk_errord_sampled((err), (code), (rate), (fmt), ##__VA_ARGS__)
+#else
+#define cdk_errorf_sampled(err, code, rate, fmt, ...)                          \
+  CDK_ECOUNT(CDK_ESAMPLE(cdk_error_fstr((err), (code), CDK_ERROR_LOC(),       \
+                                        (fmt), ##__VA_ARGS__),                 \
+                         (rate)))
+#endif
+
+#define cdk_errori(err, code)                                                  \
+  cdk_errori_sampled((err), (code), CDK_ERROR_SAMPLE_RATE(code))
+
+#define cdk_errors(err, code, msg)                                             \
+  cdk_errors_sampled((err), (code), (msg), CDK_ERROR_SAMPLE_RATE(code))
+
+#define cdk_errord(err, code, fmt, ...)                                        \
+  cdk_errord_sampled((err), (code), CDK_ERROR_SAMPLE_RATE(code), (fmt),       \
+                     ##__VA_ARGS__)
+
+#define cdk_errorf(err, code, fmt, ...)                                        \
+  cdk_errorf_sampled((err), (code), CDK_ERROR_SAMPLE_RATE(code), (fmt),       \
+                     ##__VA_ARGS__)
+
+/******************************************************************************
+ *                                   Causes                                   *
+ ******************************************************************************/
+#ifdef CDK_ERROR_CAUSE
+/*
+ * Translating an error gives it a new code and message, like raising a new
+ * one, but keeps the frames collected so far and records the replaced error
+ * as a cause. A cause is a compact record inline in the error: frames are not
+ * copied, the cause only remembers where its frames end. Messages made by
+ * cdk_errorf or cdk_errord are copied as text to `_ecause_buf` and dropped
+ * once it is full. When all `CDK_ECAUSE_MAX` records are taken, the oldest
+ * translation after the root cause is dropped and its frames go to the next
+ * cause. Dumps print the causes after the error, newest first.
+ */
+_Static_assert(CDK_ECAUSE_MAX >= 2, "root and newest cause are always kept");
+_Static_assert(CDK_ECAUSE_BUF <= INT16_MAX, "cause msg offset is 16-bit");
+
+CDK_ERROR_COLD cdk_error_t cdk_error_wrap_int(struct cdk_Error *err,
+                                              cdk_ecode_t code,
+                                              CDK_ERROR_LOC_PARAMS);
+CDK_ERROR_COLD cdk_error_t cdk_error_wrap_lstr(struct cdk_Error *err,
+                                               cdk_ecode_t code,
+                                               CDK_ERROR_LOC_PARAMS,
+                                               const char *msg);
+#ifndef CDK_ERROR_OPTIMIZE
+CDK_ERROR_COLD cdk_error_t cdk_error_wrap_fstr(struct cdk_Error *err,
+                                               cdk_ecode_t code,
+                                               CDK_ERROR_LOC_PARAMS,
+                                               const char *fmt, ...);
+#endif
+
+#ifdef CDK_ERROR__DEFINE
+/**
+ * Record current code and message of `err` as its newest cause.
+ */
+static inline void cdk_error__push_cause(struct cdk_Error *err) {
+  struct cdk_ECause *cause;
+
+  if (err->ecauses_len == CDK_ECAUSE_MAX) {
+    memmove(&err->ecauses[1], &err->ecauses[2],
+            (CDK_ECAUSE_MAX - 2) * sizeof(*cause));
+    err->ecauses_len--;
+  }
+
+  cause = &err->ecauses[err->ecauses_len++];
+  cause->msg = NULL;
+  cause->code = err->code;
+#ifdef CDK_ERROR_DOMAINS
+  cause->domain = err->domain;
+#endif
+  cause->msg_off = -1;
+  cause->frames_end = (uint32_t)cdk_error_depth(err);
+
+  switch (err->type) {
+  case cdk_ErrorType_STR:
+    cause->msg = err->msg;
+    break;
+#ifndef CDK_ERROR_OPTIMIZE
+  case cdk_ErrorType_FSTR:
+  case cdk_ErrorType_DFSTR: {
+    char *buf = err->_ecause_buf + err->_ecause_buf_len;
+    size_t room = CDK_ECAUSE_BUF - err->_ecause_buf_len, len;
+
+    if (room < 2) {
+      break;
+    }
+    if (err->type == cdk_ErrorType_FSTR) {
+      size_t size;
+      const char *msg = cdk_error__fmsg(err, &size);
+      const char *end;
+
+      size = size < room - 1 ? size : room - 1;
+      end = memchr(msg, '\0', size);
+      len = end ? (size_t)(end - msg) : size;
+      memcpy(buf, msg, len);
+      buf[len] = '\0';
+    } else {
+      cdk_error_msg(err, room, buf);
+      len = strlen(buf);
+    }
+    cause->msg_off = (int16_t)err->_ecause_buf_len;
+    err->_ecause_buf_len += len + 1;
+    break;
+  }
+#endif
+  default:;
+  }
+}
+
+/**
+ * Translate `err` to cdk_ErrorType_INT error with `code`.
+ */
+CDK_ERROR_COLD cdk_error_t cdk_error_wrap_int(struct cdk_Error *err,
+                                              cdk_ecode_t code,
+                                              CDK_ERROR_LOC_PARAMS) {
+  struct cdk_EFrame frame = CDK_ERROR_LOC_FRAME;
+
+  cdk_error__push_cause(err);
+  err->type = cdk_ErrorType_INT;
+  cdk_error__set_code(err, code);
+  err->msg = NULL;
+  cdk_error__push_frame(err, &frame);
+
+  return err;
+}
+
+/**
+ * Translate `err` to cdk_ErrorType_STR error with `code`.
+ */
+CDK_ERROR_COLD cdk_error_t cdk_error_wrap_lstr(struct cdk_Error *err,
+                                               cdk_ecode_t code,
+                                               CDK_ERROR_LOC_PARAMS,
+                                               const char *msg) {
+  struct cdk_EFrame frame = CDK_ERROR_LOC_FRAME;
+
+  cdk_error__push_cause(err);
+  err->type = cdk_ErrorType_STR;
+  cdk_error__set_code(err, code);
+  err->msg = msg;
+  cdk_error__push_frame(err, &frame);
+
+  return err;
+}
+
+#ifndef CDK_ERROR_OPTIMIZE
+/**
+ * Translate `err` to cdk_ErrorType_FSTR error with `code`.
+ */
+CDK_ERROR_COLD cdk_error_t cdk_error_wrap_fstr(struct cdk_Error *err,
+                                               cdk_ecode_t code,
+                                               CDK_ERROR_LOC_PARAMS,
+                                               const char *fmt, ...) {
+  struct cdk_EFrame frame = CDK_ERROR_LOC_FRAME;
+  va_list args;
+
+  cdk_error__push_cause(err);
+  err->type = cdk_ErrorType_FSTR;
+  cdk_error__set_code(err, code);
+
+  va_start(args, fmt);
+  cdk_error__vformat(err, fmt, args);
+  va_end(args);
+
+  cdk_error__push_frame(err, &frame);
 
-#define cdk_errors(err, code, msg)                                             \
-  cdk_error_lstr((err), (code), __FILE_NAME__, __func__, __LINE__, (msg))
+  return err;
+}
+#endif
+#endif
 
-#define cdk_errorf(err, code, fmt, ...)                                        \
-  cdk_error_fstr((err), (code), __FILE_NAME__, __func__, __LINE__, (fmt),      \
-                 ##__VA_ARGS__)
+#define cdk_error_wrapi(err, code)                                             \
+  cdk_error_wrap_int((err), (code), CDK_ERROR_LOC())
+
+#define cdk_error_wraps(err, code, msg)                                        \
+  cdk_error_wrap_lstr((err), (code), CDK_ERROR_LOC(), (msg))
+
+#ifndef CDK_ERROR_OPTIMIZE
+#define cdk_error_wrapf(err, code, fmt, ...)                                   \
+  cdk_error_wrap_fstr((err), (code), CDK_ERROR_LOC(), (fmt), ##__VA_ARGS__)
+#endif
+#endif
+
+/******************************************************************************
+ *                                  Capture                                   *
+ ******************************************************************************/
+/*
+ * Errors live in thread-local storage, so a task continued on another thread
+ * loses its trace. A snapshot keeps only the used part of the error: the
+ * fields, `eframes_len` frames and the message bytes in use, and can be
+ * restored into an error of any thread. The restored error keeps growing with
+ * wraps on its new thread. The flight recorder keeps the record in the ring of
+ * the raising thread and does not extend it after a restore.
+ */
+struct cdk_ESnapshot {
+  uint32_t size;        // Bytes used by the whole snapshot
+  uint32_t msg_len;     // Bytes of message buffer at the end of `data`
+  unsigned char data[]; // Fields, frames and message buffer
+};
+
+// Size of a snapshot buffer that fits any error.
+#ifdef CDK_ERROR_FSTR_INLINE
+#define CDK_ESNAPSHOT_MAX                                                      \
+  (sizeof(struct cdk_ESnapshot) + sizeof(struct cdk_Error) +                   \
+   CDK_ERROR_FSTR_MAX - CDK_ERROR_FSTR_INLINE)
+#else
+#define CDK_ESNAPSHOT_MAX                                                      \
+  (sizeof(struct cdk_ESnapshot) + sizeof(struct cdk_Error))
+#endif
+
+CDK_ERROR_API size_t cdk_error_capture(cdk_error_t err, size_t buf_size,
+                                       struct cdk_ESnapshot *snap);
+CDK_ERROR_API cdk_error_t cdk_error_restore(struct cdk_Error *err,
+                                            const struct cdk_ESnapshot *snap);
+
+#ifdef CDK_ERROR__DEFINE
+// Fields are copied in two runs, the header and the state of features after
+// the frames array.
+#define CDK_ESNAPSHOT__HEAD offsetof(struct cdk_Error, eframes)
+#define CDK_ESNAPSHOT__FEATURES                                                \
+  (offsetof(struct cdk_Error, eframes) +                                       \
+   sizeof(((struct cdk_Error *)0)->eframes))
+#ifndef CDK_ERROR_OPTIMIZE
+#define CDK_ESNAPSHOT__TAIL                                                    \
+  (offsetof(struct cdk_Error, _msg_buf) - CDK_ESNAPSHOT__FEATURES)
+#else
+#define CDK_ESNAPSHOT__TAIL (sizeof(struct cdk_Error) - CDK_ESNAPSHOT__FEATURES)
+#endif
+
+/**
+ * Bytes of message buffer in use and where they are, `msg` is not set if
+ * there are none.
+ */
+static inline size_t cdk_error__msg_used(cdk_error_t err, const char **msg) {
+#ifndef CDK_ERROR_OPTIMIZE
+  size_t offset = 0, arg_size;
+
+  switch (err->type) {
+  case cdk_ErrorType_FSTR:
+    *msg = cdk_error__fmsg(err, &offset);
+    return strlen(*msg) + 1;
+  case cdk_ErrorType_DFSTR:
+    *msg = err->_msg_buf;
+    while ((arg_size = cdk_error__arg_size(err->_msg_buf + offset))) {
+      offset += arg_size;
+    }
+    return offset + 1;
+  default:;
+  }
+#endif
+  (void)err, (void)msg;
+  return 0;
+}
+
+/**
+ * Write snapshot of `err` to `snap` if it fits in `buf_size` bytes. Returns
+ * size of the snapshot, nothing is written if it is larger than `buf_size`.
+ */
+CDK_ERROR_API size_t cdk_error_capture(cdk_error_t err, size_t buf_size,
+                                       struct cdk_ESnapshot *snap) {
+  size_t frames = err->eframes_len * sizeof(struct cdk_EFrame);
+  const char *msg = NULL;
+  size_t msg_len = cdk_error__msg_used(err, &msg);
+  size_t size = sizeof(*snap) + CDK_ESNAPSHOT__HEAD + CDK_ESNAPSHOT__TAIL +
+                frames + msg_len;
+  unsigned char *data;
+
+  if (size > buf_size) {
+    return size;
+  }
+  data = snap->data;
+
+  snap->size = (uint32_t)size;
+  snap->msg_len = (uint32_t)msg_len;
+  memcpy(data, err, CDK_ESNAPSHOT__HEAD);
+  data += CDK_ESNAPSHOT__HEAD;
+  memcpy(data, (const char *)err + CDK_ESNAPSHOT__FEATURES,
+         CDK_ESNAPSHOT__TAIL);
+  data += CDK_ESNAPSHOT__TAIL;
+  memcpy(data, err->eframes, frames);
+  if (msg_len) {
+    memcpy(data + frames, msg, msg_len);
+  }
+
+  return size;
+}
+
+/**
+ * Fill `err` from snapshot made by cdk_error_capture, possibly on another
+ * thread. Returns `err`.
+ */
+CDK_ERROR_API cdk_error_t cdk_error_restore(struct cdk_Error *err,
+                                            const struct cdk_ESnapshot *snap) {
+  const unsigned char *data = snap->data;
+
+  memcpy(err, data, CDK_ESNAPSHOT__HEAD);
+  data += CDK_ESNAPSHOT__HEAD;
+  memcpy((char *)err + CDK_ESNAPSHOT__FEATURES, data, CDK_ESNAPSHOT__TAIL);
+  data += CDK_ESNAPSHOT__TAIL;
+  memcpy(err->eframes, data, err->eframes_len * sizeof(struct cdk_EFrame));
+#ifndef CDK_ERROR_OPTIMIZE
+  data += err->eframes_len * sizeof(struct cdk_EFrame);
+#ifdef CDK_ERROR_FSTR_INLINE
+  // Spilled message spills again, on this thread.
+  if (snap->msg_len > sizeof(err->_msg_buf)) {
+    memcpy(err->_msg_buf, data, sizeof(err->_msg_buf) - 1);
+    err->_msg_buf[sizeof(err->_msg_buf) - 1] = '\0';
+    memcpy(cdk_emsg_spill.buf, data, snap->msg_len);
+    err->msg = cdk_emsg_spill.buf;
+    err->_msg_spill = ++cdk_emsg_spill.gen;
+    return err;
+  }
+#endif
+  memcpy(err->_msg_buf, data, snap->msg_len);
+  if (err->type == cdk_ErrorType_FSTR) {
+    err->msg = err->_msg_buf;
+  }
+#endif
+
+  return err;
+}
+#endif
+
+/******************************************************************************
+ *                                Wire format                                 *
+ ******************************************************************************/
+/*
+ * Compact binary record of an error, for shipping errors to a collector.
+ * tools/cdk_error_decode.py turns records back into the dump format. Integers
+ * are LEB128 varints, signed ones zigzag encoded. A record is:
+ *
+ *   u8 CDK_EWIRE_MAGIC, u8 CDK_EWIRE_VERSION
+ *   u32 little-endian length of the rest of the record
+ *   u8 flags, enum cdk_EWireFlag
+ *   varint code
+ *   MSG:        varint length, message text
+ *   varint depth
+ *   OMITTED:    varint index of first omitted frame, varint omitted frames
+ *   frames:     string file, string function, zigzag line delta
+ *   CAUSES:     varint count, per cause: varint code, varint frames end,
+ *               varint message length + 1 or 0 if none, message text
+ *   FIELDS:     varint count, per field: string key, u8 type, value
+ *   SUPPRESSED: varint suppressed traces
+ *
+ * A string is varint 0, varint length and the bytes, which adds the string to
+ * the table of the record, or varint n repeating table entry n - 1. Frames of
+ * one function cost three bytes. Field values are a zigzag varint for
+ * cdk_EFieldType_INT, a varint for UINT, the length + 1 or 0 and the bytes
+ * for STR, and varint size, varint length and the bytes for BYTES.
+ */
+#define CDK_EWIRE_MAGIC 0xCE
+#define CDK_EWIRE_VERSION 1
+
+enum cdk_EWireFlag {
+  cdk_EWireFlag_MSG = 1,
+  cdk_EWireFlag_OMITTED = 2,
+  cdk_EWireFlag_CAUSES = 4,
+  cdk_EWireFlag_FIELDS = 8,
+  cdk_EWireFlag_SUPPRESSED = 16,
+};
+
+CDK_ERROR_API size_t cdk_error_encode(cdk_error_t err, size_t buf_size,
+                                      unsigned char *buf);
+
+#ifdef CDK_ERROR__DEFINE
+// Strings remembered per record, later strings are always sent in full.
+#define CDK_EWIRE__STRS 32
+
+struct cdk_EWire {
+  unsigned char *buf;
+  size_t size;
+  size_t len;
+  size_t strs_len;
+  const char *strs[CDK_EWIRE__STRS];
+};
+
+static inline void cdk_ewire__bytes(struct cdk_EWire *w, const void *data,
+                                    size_t len) {
+  if (len <= w->size && w->len <= w->size - len) {
+    memcpy(w->buf + w->len, data, len);
+  }
+  w->len += len;
+}
+
+static inline void cdk_ewire__varint(struct cdk_EWire *w, uint64_t value) {
+  unsigned char tmp[10];
+  size_t len = 0;
+
+  do {
+    tmp[len++] = (unsigned char)((value & 0x7f) | (value > 0x7f ? 0x80 : 0));
+    value >>= 7;
+  } while (value);
+  cdk_ewire__bytes(w, tmp, len);
+}
+
+static inline void cdk_ewire__zigzag(struct cdk_EWire *w, int64_t value) {
+  cdk_ewire__varint(w, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static inline void cdk_ewire__str(struct cdk_EWire *w, const char *str) {
+  size_t len = strlen(str);
+
+  for (size_t i = 0; i < w->strs_len; i++) {
+    if (w->strs[i] == str) {
+      cdk_ewire__varint(w, i + 1);
+      return;
+    }
+  }
+  if (w->strs_len < CDK_EWIRE__STRS) {
+    w->strs[w->strs_len++] = str;
+  }
+  cdk_ewire__varint(w, 0);
+  cdk_ewire__varint(w, len);
+  cdk_ewire__bytes(w, str, len);
+}
+
+/**
+ * Write `value` at `offset` as a varint padded to 4 bytes, so lengths can be
+ * filled in once the data they cover is written.
+ */
+static inline void cdk_ewire__patch(struct cdk_EWire *w, size_t offset,
+                                    uint32_t value) {
+  if (offset + 4 <= w->size) {
+    w->buf[offset] = (unsigned char)((value & 0x7f) | 0x80);
+    w->buf[offset + 1] = (unsigned char)((value >> 7 & 0x7f) | 0x80);
+    w->buf[offset + 2] = (unsigned char)((value >> 14 & 0x7f) | 0x80);
+    w->buf[offset + 3] = (unsigned char)(value >> 21 & 0x7f);
+  }
+}
+
+static inline uint8_t cdk_ewire__flags(cdk_error_t err) {
+  uint8_t flags = err->type != cdk_ErrorType_INT ? cdk_EWireFlag_MSG : 0;
+
+#ifdef CDK_ERROR_BTRACE_RING
+  flags |= err->eframes_omitted ? cdk_EWireFlag_OMITTED : 0;
+#endif
+#ifdef CDK_ERROR_CAUSE
+  flags |= err->ecauses_len ? cdk_EWireFlag_CAUSES : 0;
+#endif
+#ifdef CDK_ERROR_FIELDS
+  flags |= err->efields_len ? cdk_EWireFlag_FIELDS : 0;
+#endif
+#ifdef CDK_ERROR_SAMPLE
+  flags |= err->esuppressed ? cdk_EWireFlag_SUPPRESSED : 0;
+#endif
+  return flags;
+}
+
+/**
+ * Encode `err` to `buf` in one pass. Returns size of the record; if it is
+ * larger than `buf_size` the record did not fit and `buf` holds no valid
+ * record.
+ */
+CDK_ERROR_API size_t cdk_error_encode(cdk_error_t err, size_t buf_size,
+                                      unsigned char *buf) {
+  struct cdk_EWire w = {.buf = buf, .size = buf_size};
+  unsigned char head[2] = {CDK_EWIRE_MAGIC, CDK_EWIRE_VERSION};
+  uint8_t flags = cdk_ewire__flags(err);
+  size_t depth = cdk_error_depth(err), start;
+  uint32_t line = 0;
+
+  cdk_ewire__bytes(&w, head, sizeof(head));
+  start = w.len;
+  w.len += 4;
+  cdk_ewire__bytes(&w, &flags, 1);
+  cdk_ewire__varint(&w, cdk_error_code(err));
+
+  if (flags & cdk_EWireFlag_MSG) {
+    struct cdk_EDumpCursor cursor = {.stage = cdk_EDumpStage_MSG};
+    char scratch[CDK_EDUMP_SCRATCH];
+    const char *piece;
+    size_t piece_len, msg_start = w.len;
+
+    w.len += 4;
+    while (cursor.stage == cdk_EDumpStage_MSG &&
+           cdk_error__dump_piece(err, &cursor, scratch, &piece, &piece_len)) {
+      cdk_ewire__bytes(&w, piece, piece_len);
+    }
+    cdk_ewire__patch(&w, msg_start, (uint32_t)(w.len - msg_start - 4));
+  }
+
+  cdk_ewire__varint(&w, depth);
+#ifdef CDK_ERROR_BTRACE_RING
+  if (flags & cdk_EWireFlag_OMITTED) {
+    cdk_ewire__varint(&w, CDK_ERROR_BTRACE_PIN);
+    cdk_ewire__varint(&w, err->eframes_omitted);
+  }
+#endif
+  for (size_t i = 0; i < depth; i++) {
+    const struct cdk_EFrame *frame = cdk_error_frame(err, i);
+
+    if (!frame) {
+      continue;
+    }
+    cdk_ewire__str(&w, cdk_eframe_file(frame));
+    cdk_ewire__str(&w, cdk_eframe_func(frame));
+    cdk_ewire__zigzag(&w, (int64_t)cdk_eframe_line(frame) - line);
+    line = cdk_eframe_line(frame);
+  }
+
+#ifdef CDK_ERROR_CAUSE
+  if (flags & cdk_EWireFlag_CAUSES) {
+    cdk_ewire__varint(&w, err->ecauses_len);
+    for (size_t i = 0; i < err->ecauses_len; i++) {
+      const struct cdk_ECause *cause = &err->ecauses[i];
+      const char *msg = cause->msg;
+
+      if (!msg && cause->msg_off >= 0) {
+        msg = err->_ecause_buf + cause->msg_off;
+      }
+      cdk_ewire__varint(&w, cdk_ecause__code(cause));
+      cdk_ewire__varint(&w, cause->frames_end);
+      cdk_ewire__varint(&w, msg ? strlen(msg) + 1 : 0);
+      if (msg) {
+        cdk_ewire__bytes(&w, msg, strlen(msg));
+      }
+    }
+  }
+#endif
+
+#ifdef CDK_ERROR_FIELDS
+  if (flags & cdk_EWireFlag_FIELDS) {
+    cdk_ewire__varint(&w, err->efields_len);
+    for (size_t i = 0; i < err->efields_len; i++) {
+      const struct cdk_EField *field = &err->efields[i];
+
+      cdk_ewire__str(&w, field->key);
+      cdk_ewire__bytes(&w, &field->type, 1);
+      switch (field->type) {
+      case cdk_EFieldType_INT:
+        cdk_ewire__zigzag(&w, field->i64);
+        break;
+      case cdk_EFieldType_UINT:
+        cdk_ewire__varint(&w, field->u64);
+        break;
+      case cdk_EFieldType_STR:
+        cdk_ewire__varint(&w, field->str ? strlen(field->str) + 1 : 0);
+        if (field->str) {
+          cdk_ewire__bytes(&w, field->str, strlen(field->str));
+        }
+        break;
+      default:
+        cdk_ewire__varint(&w, field->size);
+        cdk_ewire__varint(&w, field->len);
+        cdk_ewire__bytes(&w, field->bytes, field->len);
+      }
+    }
+  }
+#endif
+
+#ifdef CDK_ERROR_SAMPLE
+  if (flags & cdk_EWireFlag_SUPPRESSED) {
+    cdk_ewire__varint(&w, err->esuppressed);
+  }
+#endif
+
+  if (start + 4 <= buf_size) {
+    uint32_t len = (uint32_t)(w.len - start - 4);
+    buf[start] = (unsigned char)len;
+    buf[start + 1] = (unsigned char)(len >> 8);
+    buf[start + 2] = (unsigned char)(len >> 16);
+    buf[start + 3] = (unsigned char)(len >> 24);
+  }
+
+  return w.len;
+}
+#endif
+
+/******************************************************************************
+ *                                 Async log                                  *
+ ******************************************************************************/
+/*
+ * Logging an error with cdk_edumps and write() puts formatting and a syscall
+ * on the thread that hit it. With `CDK_ERROR_LOG` the thread only copies a
+ * snapshot of the error into a bounded queue with cdk_elog_push; a writer
+ * thread started by cdk_elog_start restores queued errors, dumps them and
+ * writes the dumps to a descriptor in batches of up to `CDK_ELOG_BATCH` bytes.
+ *
+ * The queue is an array of slots with sequence numbers, pushing claims a slot
+ * with one CAS on `head`, so any number of threads push without a lock. When
+ * the queue is full cdk_ELogPolicy_DROP drops the pushed error and
+ * cdk_ELogPolicy_OVERWRITE drops the oldest queued one to make room. Slots
+ * hold `CDK_ELOG_SLOT` bytes, errors with a larger snapshot are dropped too.
+ * Messages of cdk_ErrorType_STR errors and string fields are kept as
+ * pointers, like in any snapshot, so they have to outlive the writer.
+ */
+#ifdef CDK_ERROR_LOG
+#if !defined(__unix__) && !defined(__APPLE__)
+#error "CDK_ERROR_LOG requires a POSIX target"
+#endif
+
+#ifndef CDK_ELOG_SLOT
+#define CDK_ELOG_SLOT CDK_ESNAPSHOT_MAX
+#endif
+
+#ifndef CDK_ELOG_BATCH
+#define CDK_ELOG_BATCH 16384
+#endif
+
+// Writer sleep when the queue is empty.
+#ifndef CDK_ELOG_IDLE_NS
+#define CDK_ELOG_IDLE_NS 1000000
+#endif
+
+enum cdk_ELogPolicy {
+  cdk_ELogPolicy_DROP,
+  cdk_ELogPolicy_OVERWRITE,
+};
+
+struct cdk_ELogSlot {
+  _Atomic uint64_t seq; // Position it is free for, position + 1 once filled
+  _Alignas(struct cdk_ESnapshot) unsigned char snap[CDK_ELOG_SLOT];
+};
+
+struct cdk_ELog {
+  // Producer side
+  _Alignas(64) _Atomic uint64_t head; // Next position to push to
+  _Atomic uint64_t dropped;           // Errors dropped for lack of room
+  // Writer side
+  _Alignas(64) _Atomic uint64_t tail; // Next position to write out
+  _Atomic uint64_t written;           // Errors written to `fd`
+  _Atomic int stop;
+  int fd;
+  enum cdk_ELogPolicy policy;
+  uint32_t capacity;         // Number of slots, a power of two
+  struct cdk_ELogSlot *slots; // Caller-provided storage
+  thrd_t thread;
+  struct cdk_Error err; // Error being written
+  char batch[CDK_ELOG_BATCH];
+};
+
+CDK_ERROR_API int cdk_elog_init(struct cdk_ELog *log, int fd,
+                                enum cdk_ELogPolicy policy, size_t capacity,
+                                struct cdk_ELogSlot *slots);
+CDK_ERROR_API int cdk_elog_push(struct cdk_ELog *log, cdk_error_t err);
+CDK_ERROR_API int cdk_elog_start(struct cdk_ELog *log);
+CDK_ERROR_API void cdk_elog_stop(struct cdk_ELog *log);
+
+#ifdef CDK_ERROR__DEFINE
+/**
+ * Set up `log` writing to `fd` over `capacity` slots at `slots`. Returns 0 on
+ * success or EINVAL if `capacity` is not a power of two below 2^31.
+ */
+CDK_ERROR_API int cdk_elog_init(struct cdk_ELog *log, int fd,
+                                enum cdk_ELogPolicy policy, size_t capacity,
+                                struct cdk_ELogSlot *slots) {
+  if (!capacity || capacity & (capacity - 1) || capacity > INT32_MAX) {
+    return EINVAL;
+  }
+
+  log->fd = fd;
+  log->policy = policy;
+  log->capacity = (uint32_t)capacity;
+  log->slots = slots;
+  for (uint32_t i = 0; i < log->capacity; i++) {
+    atomic_init(&slots[i].seq, i);
+  }
+  atomic_init(&log->head, 0);
+  atomic_init(&log->dropped, 0);
+  atomic_init(&log->tail, 0);
+  atomic_init(&log->written, 0);
+  atomic_init(&log->stop, 0);
+
+  return 0;
+}
+
+/**
+ * Claim the oldest filled slot of `log`, NULL if there is none. The slot is
+ * handed back with cdk_elog__free.
+ */
+static inline struct cdk_ELogSlot *cdk_elog__claim(struct cdk_ELog *log,
+                                                   uint64_t *pos) {
+  uint64_t tail = atomic_load_explicit(&log->tail, memory_order_relaxed);
+
+  for (;;) {
+    struct cdk_ELogSlot *slot = &log->slots[tail & (log->capacity - 1)];
+    uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    int64_t diff = (int64_t)(seq - (tail + 1));
+
+    if (diff < 0) {
+      return NULL;
+    }
+    if (diff == 0 && atomic_compare_exchange_weak_explicit(
+                         &log->tail, &tail, tail + 1, memory_order_relaxed,
+                         memory_order_relaxed)) {
+      *pos = tail;
+      return slot;
+    }
+    if (diff > 0) {
+      tail = atomic_load_explicit(&log->tail, memory_order_relaxed);
+    }
+  }
+}
+
+static inline void cdk_elog__free(struct cdk_ELog *log,
+                                  struct cdk_ELogSlot *slot, uint64_t pos) {
+  atomic_store_explicit(&slot->seq, pos + log->capacity,
+                        memory_order_release);
+}
+
+/**
+ * Queue snapshot of `err` for writing. Returns 0 on success or ENOBUFS if the
+ * error was dropped.
+ */
+CDK_ERROR_API int cdk_elog_push(struct cdk_ELog *log, cdk_error_t err) {
+  uint64_t head = atomic_load_explicit(&log->head, memory_order_relaxed);
+  struct cdk_ELogSlot *slot;
+  int evicted = 0;
+
+  for (;;) {
+    uint64_t seq, pos;
+    int64_t diff;
+
+    slot = &log->slots[head & (log->capacity - 1)];
+    seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    diff = (int64_t)(seq - head);
+
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&log->head, &head, head + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      struct cdk_ELogSlot *oldest;
+
+      // Full. Overwriting evicts one error, the slot it frees may still be
+      // taken by another producer.
+      if (log->policy == cdk_ELogPolicy_DROP || evicted ||
+          !(oldest = cdk_elog__claim(log, &pos))) {
+        atomic_fetch_add_explicit(&log->dropped, 1, memory_order_relaxed);
+        return ENOBUFS;
+      }
+      cdk_elog__free(log, oldest, pos);
+      atomic_fetch_add_explicit(&log->dropped, 1, memory_order_relaxed);
+      evicted = 1;
+      head = atomic_load_explicit(&log->head, memory_order_relaxed);
+    } else {
+      head = atomic_load_explicit(&log->head, memory_order_relaxed);
+    }
+  }
+
+#ifdef CDK_ERROR_COUNTERS
+  // Counted here, the copy dumped by the writer carries the mark.
+  cdk_ecounter__top(err);
+#endif
+  if (cdk_error_capture(err, sizeof(slot->snap),
+                        (struct cdk_ESnapshot *)slot->snap) >
+      sizeof(slot->snap)) {
+    // Keep the slot in order, the writer skips it.
+    ((struct cdk_ESnapshot *)slot->snap)->size = 0;
+  }
+  atomic_store_explicit(&slot->seq, head + 1, memory_order_release);
+
+  return 0;
+}
+
+/**
+ * Write `len` bytes of the batch of `log`, retrying partial writes. Bytes that
+ * cannot be written are lost.
+ */
+static inline void cdk_elog__flush(struct cdk_ELog *log, size_t len) {
+  const char *data = log->batch;
+
+  while (len) {
+    ssize_t written = write(log->fd, data, len);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    data += written;
+    len -= (size_t)written;
+  }
+}
+
+static inline int cdk_elog__main(void *arg) {
+  const struct timespec idle = {.tv_nsec = CDK_ELOG_IDLE_NS};
+  struct cdk_ELog *log = arg;
+  size_t len = 0;
+
+  for (;;) {
+    // Errors pushed before cdk_elog_stop are written before exiting.
+    int stop = atomic_load_explicit(&log->stop, memory_order_acquire);
+    struct cdk_ELogSlot *slot;
+    uint64_t pos;
+
+    while ((slot = cdk_elog__claim(log, &pos))) {
+      const struct cdk_ESnapshot *snap = (struct cdk_ESnapshot *)slot->snap;
+      struct cdk_EDumpCursor cursor = {0};
+      size_t n;
+
+      if (!snap->size) {
+        cdk_elog__free(log, slot, pos);
+        atomic_fetch_add_explicit(&log->dropped, 1, memory_order_relaxed);
+        continue;
+      }
+      cdk_error_restore(&log->err, snap);
+      cdk_elog__free(log, slot, pos);
+
+      while ((n = cdk_error_dumpr(&log->err, &cursor, sizeof(log->batch) - len,
+                                  log->batch + len))) {
+        len += n;
+        if (len == sizeof(log->batch)) {
+          cdk_elog__flush(log, len);
+          len = 0;
+        }
+      }
+      atomic_fetch_add_explicit(&log->written, 1, memory_order_relaxed);
+    }
+
+    if (len) {
+      cdk_elog__flush(log, len);
+      len = 0;
+    }
+    if (stop) {
+      return 0;
+    }
+    thrd_sleep(&idle, NULL);
+  }
+}
+
+/**
+ * Start the writer thread of `log`. Returns 0 on success or EAGAIN if the
+ * thread could not be created.
+ */
+CDK_ERROR_API int cdk_elog_start(struct cdk_ELog *log) {
+  return thrd_create(&log->thread, cdk_elog__main, log) == thrd_success
+             ? 0
+             : EAGAIN;
+}
+
+/**
+ * Write out everything pushed so far and stop the writer thread of `log`.
+ * Pushes racing with the stop may stay queued until the next start.
+ */
+CDK_ERROR_API void cdk_elog_stop(struct cdk_ELog *log) {
+  atomic_store_explicit(&log->stop, 1, memory_order_release);
+  thrd_join(log->thread, NULL);
+  atomic_store_explicit(&log->stop, 0, memory_order_relaxed);
+}
+#endif
+#endif
 
 /******************************************************************************
  *                                Errno API                                   *
  ******************************************************************************/
 #ifndef CDK_DISABLE_ERRNO_API
-_Thread_local extern cdk_error_t cdk_errno;
-_Thread_local extern struct cdk_Error cdk_hidden_errno;
+_Thread_local extern cdk_error_t cdk_errno CDK_ERROR_TLS;
+
+#ifdef CDK_ERROR_LAZY
+#define CDK_ERROR__HIDDEN cdk_elazy__get()
+#else
+_Thread_local extern struct cdk_Error cdk_hidden_errno CDK_ERROR_TLS;
+
+#define CDK_ERROR__HIDDEN (&cdk_hidden_errno)
+#endif
+
+/*
+ * Each errno macro takes the address of `cdk_hidden_errno` on its own, which
+ * in a shared object may be a call to __tls_get_addr, made again inside the
+ * raise and wrap functions the compiler specialized for that address.
+ * cdk_ebind() takes it once, at the top of an error branch or of a function
+ * handling errors in a loop; errno macros in its scope use the local copy,
+ * picked by its type. At file scope `cdk__ebound` names a function, and
+ * -Wshadow does not report a variable that hides a function. Accesses to
+ * `cdk_errno` itself are not affected. With CDK_ERROR_LAZY it loads
+ * `cdk_lazy_errno` once the same way.
+ */
+static inline void cdk__ebound(void) {}
+
+/**
+ * Return `err` with its value hidden from the optimizer. Otherwise constant
+ * propagation clones callees for the known address and each clone reaches
+ * the thread-local again.
+ */
+static inline struct cdk_Error *cdk_error__bind(struct cdk_Error *err) {
+#ifdef __GNUC__
+  __asm__("" : "+r"(err));
+  if (!err) {
+    __builtin_unreachable();
+  }
+#endif
+  return err;
+}
+
+#define cdk_ebind()                                                            \
+  struct cdk_Error *const cdk__ebound = cdk_error__bind(CDK_ERROR__HIDDEN)
+
+#ifdef __cplusplus
+extern "C++" {
+inline struct cdk_Error *cdk_error__bound(struct cdk_Error *err) { return err; }
+inline struct cdk_Error *cdk_error__bound(void (*)(void)) { return NULL; }
+}
+
+#define CDK_EHIDDEN                                                            \
+  (cdk_error__bound(cdk__ebound) ? cdk_error__bound(cdk__ebound)               \
+                                 : CDK_ERROR__HIDDEN)
+#else
+#define CDK_EHIDDEN                                                            \
+  _Generic(cdk__ebound,                                                        \
+      struct cdk_Error *: cdk__ebound,                                         \
+      default: CDK_ERROR__HIDDEN)
+#endif
+
+#define cdk_errnoi(code) cdk_errori(CDK_EHIDDEN, code)
 
-#define cdk_errnoi(code) cdk_errori(&cdk_hidden_errno, code)
+#define cdk_errnos(code, msg) cdk_errors(CDK_EHIDDEN, code, msg)
 
-#define cdk_errnos(code, msg) cdk_errors(&cdk_hidden_errno, code, msg)
+#define cdk_errnoi_sampled(code, rate)                                         \
+  cdk_errori_sampled(CDK_EHIDDEN, code, rate)
+
+#define cdk_errnos_sampled(code, msg, rate)                                    \
+  cdk_errors_sampled(CDK_EHIDDEN, code, msg, rate)
 
 #ifndef CDK_ERROR_OPTIMIZE
 #define cdk_errnof(code, fmt, ...)                                             \
-  cdk_errorf(&cdk_hidden_errno, code, fmt, ##__VA_ARGS__)
+  cdk_errorf(CDK_EHIDDEN, code, fmt, ##__VA_ARGS__)
+
+#define cdk_errnod(code, fmt, ...)                                             \
+  cdk_errord(CDK_EHIDDEN, code, fmt, ##__VA_ARGS__)
+
+#define cdk_errnof_sampled(code, rate, fmt, ...)                               \
+  cdk_errorf_sampled(CDK_EHIDDEN, code, rate, fmt, ##__VA_ARGS__)
+
+#define cdk_errnod_sampled(code, rate, fmt, ...)                               \
+  cdk_errord_sampled(CDK_EHIDDEN, code, rate, fmt, ##__VA_ARGS__)
 #endif
 
-#define cdk_ewrap() cdk_error_wrap(&cdk_hidden_errno)
+#define cdk_ewrap() cdk_error_wrap(CDK_EHIDDEN)
 
-#define cdk_ereturn(ret) cdk_error_return((ret), &cdk_hidden_errno)
+#define cdk_ereturn(ret) cdk_error_return((ret), CDK_EHIDDEN)
 
 #define cdk_edumps(buf_size, buf)                                              \
-  cdk_error_dumps(&cdk_hidden_errno, buf_size, buf)
+  cdk_error_dumps(CDK_EHIDDEN, buf_size, buf)
+
+#define cdk_emsg(buf_size, buf) cdk_error_msg(CDK_EHIDDEN, buf_size, buf)
+
+#define cdk_ecapture(buf_size, snap)                                           \
+  cdk_error_capture(CDK_EHIDDEN, buf_size, snap)
 
+#define cdk_erestore(snap)                                                     \
+  (cdk_errno = cdk_error_restore(CDK_EHIDDEN, (snap)))
+
+#define cdk_eencode(buf_size, buf)                                             \
+  cdk_error_encode(CDK_EHIDDEN, buf_size, buf)
+
+#ifdef CDK_ERROR_LOG
+#define cdk_elog(log) cdk_elog_push(log, CDK_EHIDDEN)
+#endif
+
+#ifdef CDK_ERROR_FIELDS
+#define cdk_efield(key, value) cdk_error_field(CDK_EHIDDEN, key, value)
+
+#define cdk_efield_bytes(key, data, size)                                      \
+  cdk_error_field_bytes(CDK_EHIDDEN, key, data, size)
+#endif
+
+#ifdef CDK_ERROR_CAUSE
+#define cdk_ewrapi(code) (cdk_errno = cdk_error_wrapi(CDK_EHIDDEN, code))
+
+#define cdk_ewraps(code, msg)                                                  \
+  (cdk_errno = cdk_error_wraps(CDK_EHIDDEN, code, msg))
+
+#ifndef CDK_ERROR_OPTIMIZE
+#define cdk_ewrapf(code, fmt, ...)                                             \
+  (cdk_errno = cdk_error_wrapf(CDK_EHIDDEN, code, fmt, ##__VA_ARGS__))
+#endif
+#endif
+
+#endif
+
+#ifdef __cplusplus
+}
 #endif
@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2025 Jakub Buczynski <KubaTaba1uga>
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef CDK_ERROR_HPP
+#define CDK_ERROR_HPP
+
+/******************************************************************************
+ C++20 binding of C Development Kit: Error.
+
+ Functions return `cdk::result<T>`, holding either a value or a pointer to a
+ struct cdk_Error. Errors are raised with cdk::fail into the thread's
+ `cdk_hidden_errno`, like the errno API does, so C and C++ layers of one
+ program pass the same errors to each other. Callsites come from
+ std::source_location and are resolved at compile time: a raise or a wrap
+ makes the same library call as the C macros, with constant arguments.
+
+ The C header builds as C++ only in library mode, so this header defines
+ `CDK_ERROR_LIBRARY` and the program links the `cdk_error` library, or a C
+ file with `CDK_ERROR_IMPLEMENTATION`, built with the same config macros.
+ Features keeping atomic state or per-callsite statics are C only.
+******************************************************************************/
+
+#ifndef CDK_ERROR_LIBRARY
+#define CDK_ERROR_LIBRARY
+#endif
+
+#if defined(CDK_ERROR_CALLSITE) || defined(CDK_ERROR_COUNTERS) ||             \
+    defined(CDK_ERROR_RECORDER) || defined(CDK_ERROR_STATS) ||                 \
+    defined(CDK_ERROR_POOL) || defined(CDK_ERROR_LOG) ||                       \
+    defined(CDK_ERROR_LAZY)
+#error "cdk_error.hpp does not support callsite descriptors nor atomic state"
+#endif
+
+#include "cdk_error.h"
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <source_location>
+#include <type_traits>
+#include <utility>
+
+namespace cdk {
+
+/******************************************************************************
+ *                                  Location                                  *
+ ******************************************************************************/
+/**
+ * Callsite of a raise or a wrap. Taken as a defaulted parameter, so it is the
+ * location of the caller; the file is cut to its base name like
+ * `__FILE_NAME__`. Functions are named by their signature, as given by
+ * std::source_location.
+ */
+struct location {
+  const char *file;
+  const char *func;
+  std::uint32_t line;
+
+  consteval location(
+      std::source_location loc = std::source_location::current()) noexcept
+      : file(base_name(loc.file_name())), func(loc.function_name()),
+        line(loc.line()) {}
+
+private:
+  static consteval const char *base_name(const char *path) noexcept {
+    const char *name = path;
+
+    for (; *path; path++) {
+      if (*path == '/' || *path == '\\') {
+        name = path + 1;
+      }
+    }
+    return name;
+  }
+};
+
+/******************************************************************************
+ *                                   Result                                   *
+ ******************************************************************************/
+/**
+ * Error on its way up, converts to a failed cdk::result of any type.
+ */
+class [[nodiscard]] failure {
+public:
+  explicit failure(cdk_error_t err) noexcept : err_(err) { assert(err); }
+
+  cdk_error_t error() const noexcept { return err_; }
+
+private:
+  cdk_error_t err_;
+};
+
+/**
+ * Add frame of `loc` to `err`, like cdk_error_wrap.
+ */
+inline failure wrap(cdk_error_t err, location loc = {}) noexcept {
+#ifndef CDK_ERROR_OPTIMIZE
+  cdk_error__wrap(err, loc.file, loc.func, static_cast<int>(loc.line));
+#else
+  (void)loc;
+#endif
+  return failure(err);
+}
+
+/**
+ * Value of type `T` or an error. Copyable and movable as far as `T` is, every
+ * operation is noexcept. Reading the value of a failed result, or the error
+ * of a successful one, is a precondition violation.
+ */
+template <class T> class [[nodiscard]] result {
+  static_assert(std::is_nothrow_move_constructible_v<T> &&
+                    std::is_nothrow_destructible_v<T>,
+                "cdk::result needs a noexcept movable type");
+
+public:
+  using value_type = T;
+
+  result(const T &value) noexcept(std::is_nothrow_copy_constructible_v<T>)
+    requires std::is_copy_constructible_v<T>
+      : err_(nullptr) {
+    std::construct_at(&value_, value);
+  }
+
+  result(T &&value) noexcept : err_(nullptr) {
+    std::construct_at(&value_, std::move(value));
+  }
+
+  template <class... Args>
+  explicit result(std::in_place_t, Args &&...args) noexcept(
+      std::is_nothrow_constructible_v<T, Args...>)
+      : err_(nullptr) {
+    std::construct_at(&value_, std::forward<Args>(args)...);
+  }
+
+  result(failure fail) noexcept : err_(fail.error()) {}
+
+  // Special members are trivial for trivial `T`, so such results are passed
+  // and returned in registers.
+  result(const result &)
+    requires std::is_trivially_copy_constructible_v<T>
+  = default;
+
+  result(const result &other) noexcept(
+      std::is_nothrow_copy_constructible_v<T>)
+    requires(std::is_copy_constructible_v<T> &&
+             !std::is_trivially_copy_constructible_v<T>)
+      : err_(other.err_) {
+    if (!err_) {
+      std::construct_at(&value_, other.value_);
+    }
+  }
+
+  result(result &&)
+    requires std::is_trivially_move_constructible_v<T>
+  = default;
+
+  result(result &&other) noexcept
+    requires(!std::is_trivially_move_constructible_v<T>)
+      : err_(other.err_) {
+    if (!err_) {
+      std::construct_at(&value_, std::move(other.value_));
+    }
+  }
+
+  result &operator=(const result &)
+    requires std::is_trivially_copyable_v<T>
+  = default;
+
+  result &operator=(const result &other) noexcept(
+      std::is_nothrow_copy_constructible_v<T>)
+    requires(std::is_copy_constructible_v<T> &&
+             !std::is_trivially_copyable_v<T>)
+  {
+    if (this != &other) {
+      reset();
+      err_ = other.err_;
+      if (!err_) {
+        std::construct_at(&value_, other.value_);
+      }
+    }
+    return *this;
+  }
+
+  result &operator=(result &&)
+    requires std::is_trivially_copyable_v<T>
+  = default;
+
+  result &operator=(result &&other) noexcept
+    requires(!std::is_trivially_copyable_v<T>)
+  {
+    if (this != &other) {
+      reset();
+      err_ = other.err_;
+      if (!err_) {
+        std::construct_at(&value_, std::move(other.value_));
+      }
+    }
+    return *this;
+  }
+
+  ~result()
+    requires std::is_trivially_destructible_v<T>
+  = default;
+
+  ~result() { reset(); }
+
+  bool has_value() const noexcept { return !err_; }
+  explicit operator bool() const noexcept { return !err_; }
+
+  T &value() & noexcept {
+    assert(!err_);
+    return value_;
+  }
+  const T &value() const & noexcept {
+    assert(!err_);
+    return value_;
+  }
+  T &&value() && noexcept {
+    assert(!err_);
+    return std::move(value_);
+  }
+
+  T &operator*() & noexcept { return value(); }
+  const T &operator*() const & noexcept { return value(); }
+  T &&operator*() && noexcept { return std::move(*this).value(); }
+  T *operator->() noexcept { return &value(); }
+  const T *operator->() const noexcept { return &value(); }
+
+  cdk_error_t error() const noexcept {
+    assert(err_);
+    return err_;
+  }
+
+  /**
+   * Add frame of the caller to the error and pass it up:
+   *
+   *   if (!r) {
+   *     return r.wrap();
+   *   }
+   */
+  failure wrap(location loc = {}) const noexcept {
+    return cdk::wrap(error(), loc);
+  }
+
+private:
+  void reset() noexcept {
+    if (!err_) {
+      value_.~T();
+    }
+  }
+
+  cdk_error_t err_; // NULL while holding a value
+  union {
+    T value_;
+  };
+};
+
+/**
+ * Success or an error.
+ */
+template <> class [[nodiscard]] result<void> {
+public:
+  using value_type = void;
+
+  result() noexcept : err_(nullptr) {}
+  result(failure fail) noexcept : err_(fail.error()) {}
+
+  bool has_value() const noexcept { return !err_; }
+  explicit operator bool() const noexcept { return !err_; }
+
+  void value() const noexcept { assert(!err_); }
+
+  cdk_error_t error() const noexcept {
+    assert(err_);
+    return err_;
+  }
+
+  failure wrap(location loc = {}) const noexcept {
+    return cdk::wrap(error(), loc);
+  }
+
+private:
+  cdk_error_t err_; // NULL on success
+};
+
+/******************************************************************************
+ *                                   Raising                                  *
+ ******************************************************************************/
+/**
+ * Fill `err` with integer error `code`, like cdk_errori.
+ */
+inline failure fail(cdk_error_t err, cdk_ecode_t code,
+                    location loc = {}) noexcept {
+  return failure(cdk_error_int(err, code, loc.file, loc.func,
+                               static_cast<int>(loc.line)));
+}
+
+/**
+ * Fill `err` with string error `code`, like cdk_errors. `msg` has to outlive
+ * the error.
+ */
+inline failure fail(cdk_error_t err, cdk_ecode_t code, const char *msg,
+                    location loc = {}) noexcept {
+  return failure(cdk_error_lstr(err, code, loc.file, loc.func,
+                                static_cast<int>(loc.line), msg));
+}
+
+#ifndef CDK_ERROR_OPTIMIZE
+/**
+ * Format string and its callsite, the format has to be a literal.
+ */
+struct format {
+  const char *fmt;
+  location loc;
+
+  consteval format(const char *fmt, location loc = {}) noexcept
+      : fmt(fmt), loc(loc) {}
+};
+
+/**
+ * Fill `err` with formatted error `code`, like cdk_errorf.
+ */
+template <class... Args>
+inline failure failf(cdk_error_t err, cdk_ecode_t code, format fmt,
+                     Args... args) noexcept {
+#ifdef CDK_ERROR_DEFER_FSTR
+  return failure(cdk_error_dfstr(err, code, fmt.loc.file, fmt.loc.func,
+                                 static_cast<int>(fmt.loc.line), fmt.fmt,
+                                 args...));
+#else
+  return failure(cdk_error_fstr(err, code, fmt.loc.file, fmt.loc.func,
+                                static_cast<int>(fmt.loc.line), fmt.fmt,
+                                args...));
+#endif
+}
+
+/**
+ * Fill `err` with deferred formatted error `code`, like cdk_errord.
+ */
+template <class... Args>
+inline failure faild(cdk_error_t err, cdk_ecode_t code, format fmt,
+                     Args... args) noexcept {
+  return failure(cdk_error_dfstr(err, code, fmt.loc.file, fmt.loc.func,
+                                 static_cast<int>(fmt.loc.line), fmt.fmt,
+                                 args...));
+}
+#endif
+
+#ifndef CDK_DISABLE_ERRNO_API
+/*
+ * Raising without an error raises into the thread's `cdk_hidden_errno` and
+ * points `cdk_errno` at it, like the errno API.
+ */
+inline failure fail(cdk_ecode_t code, location loc = {}) noexcept {
+  cdk_errno = fail(&cdk_hidden_errno, code, loc).error();
+  return failure(cdk_errno);
+}
+
+inline failure fail(cdk_ecode_t code, const char *msg,
+                    location loc = {}) noexcept {
+  cdk_errno = fail(&cdk_hidden_errno, code, msg, loc).error();
+  return failure(cdk_errno);
+}
+
+#ifndef CDK_ERROR_OPTIMIZE
+template <class... Args>
+inline failure failf(cdk_ecode_t code, format fmt, Args... args) noexcept {
+  cdk_errno = failf(&cdk_hidden_errno, code, fmt, args...).error();
+  return failure(cdk_errno);
+}
+
+template <class... Args>
+inline failure faild(cdk_ecode_t code, format fmt, Args... args) noexcept {
+  cdk_errno = faild(&cdk_hidden_errno, code, fmt, args...).error();
+  return failure(cdk_errno);
+}
+#endif
+
+/**
+ * Error a C layer left in `cdk_errno`, e.g. after it returned -1.
+ */
+inline failure last_error() noexcept { return failure(cdk_errno); }
+#endif
+
+} // namespace cdk
+
+#endif
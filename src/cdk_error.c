@@ -0,0 +1,12 @@
+/*
+ * Copyright (c) 2025 Jakub Buczynski <KubaTaba1uga>
+ * SPDX-License-Identifier: MIT
+ */
+/*
+ * Compiled-library build of cdk_error.h. Translation units using the library
+ * include the header with `CDK_ERROR_LIBRARY` defined and get declarations
+ * only; every raise, wrap and dump function is defined once, here. Global
+ * state such as `cdk_errno` or `cdk_erecorder` is defined by the program.
+ */
+#define CDK_ERROR_IMPLEMENTATION
+#include "cdk_error.h"
@@ -52,7 +52,7 @@ def install(c):
 
 
 @task
-def build(c, debug=False, tests=False, examples=False):
+def build(c, debug=False, tests=False, examples=False, benchmarks=False):
     """
     Configure and build the project.
 
@@ -76,6 +76,9 @@ def build(c, debug=False, tests=False, examples=False):
     if examples:
         setup_command = f"{setup_command} -Dexamples=true"
 
+    if benchmarks:
+        setup_command = f"{setup_command} -Dbenchmarks=true"
+
     _run_command(c, setup_command)
     _run_command(c, f"meson compile -v -C {BUILD_PATH}")
 
@@ -99,6 +102,22 @@ def test(c, name=None):
     _pr_info("Testing done")
 
 
+@task
+def bench(c):
+    """
+    Run benchmarks, results are written to build/bench/*.json.
+
+    Usage:
+        inv build --benchmarks
+        inv bench
+    """
+    _pr_info("Benchmarking...")
+
+    _run_command(c, f"meson test -C {BUILD_PATH} --benchmark --verbose")
+
+    _pr_info("Benchmarking done")
+
+
 @task
 def lint(c):
     patterns = [
@@ -0,0 +1,190 @@
+#include <dlfcn.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <threads.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+// Built with CDK_ERROR_BTRACE_FP=8, frame pointers and -rdynamic, so the
+// functions below have names in the native backtrace.
+#define NOINLINE __attribute__((noinline))
+
+static _Alignas(8) unsigned char snap_buf[CDK_ESNAPSHOT_MAX];
+static struct cdk_ESnapshot *snap = (struct cdk_ESnapshot *)snap_buf;
+
+static char out[4096];
+
+void setUp(void) { cdk_errno = NULL; }
+
+void tearDown(void) {}
+
+NOINLINE int fp_read_sector(void) {
+  cdk_errno = cdk_errnos(EIO, "Bad sector");
+  return -1;
+}
+
+// Forgets to wrap.
+NOINLINE int fp_read_block(void) {
+  if (fp_read_sector()) {
+    return -1;
+  }
+  return 0;
+}
+
+NOINLINE int fp_load_table(void) {
+  if (fp_read_block()) {
+    return cdk_ereturn(-1);
+  }
+  return 0;
+}
+
+NOINLINE int fp_recurse(int depth) {
+  if (depth == 0) {
+    return fp_read_sector();
+  }
+  if (fp_recurse(depth - 1)) {
+    return -1;
+  }
+  return 0;
+}
+
+static const char *pc_name(void *pc) {
+  Dl_info info;
+
+  if (!dladdr((char *)pc - 1, &info) || !info.dli_sname) {
+    return "";
+  }
+  return info.dli_sname;
+}
+
+static void on_signal(int sig) {
+  (void)sig;
+  fp_read_sector();
+}
+
+static int thread_main(void *arg) {
+  (void)arg;
+  fp_load_table();
+  return cdk_errno->epcs_len >= 3 &&
+         strcmp(pc_name(cdk_errno->epcs[2]), "fp_load_table") == 0;
+}
+
+void test_raise_stores_callers(void) {
+  fp_load_table();
+
+  TEST_ASSERT(cdk_errno->epcs_len >= 4);
+  TEST_ASSERT_EQUAL_STRING("fp_read_sector", pc_name(cdk_errno->epcs[0]));
+  TEST_ASSERT_EQUAL_STRING("fp_read_block", pc_name(cdk_errno->epcs[1]));
+  TEST_ASSERT_EQUAL_STRING("fp_load_table", pc_name(cdk_errno->epcs[2]));
+  TEST_ASSERT_EQUAL_STRING("test_raise_stores_callers",
+                           pc_name(cdk_errno->epcs[3]));
+}
+
+void test_manual_frames_are_kept(void) {
+  fp_load_table();
+
+  TEST_ASSERT_EQUAL(2, cdk_errno->eframes_len);
+  TEST_ASSERT_EQUAL_STRING("fp_read_sector",
+                           cdk_eframe_func(&cdk_errno->eframes[0]));
+  TEST_ASSERT_EQUAL_STRING("fp_load_table",
+                           cdk_eframe_func(&cdk_errno->eframes[1]));
+}
+
+void test_depth_is_bounded(void) {
+  fp_recurse(20);
+
+  TEST_ASSERT_EQUAL(CDK_ERROR_BTRACE_FP, cdk_errno->epcs_len);
+  for (int i = 1; i < CDK_ERROR_BTRACE_FP; i++) {
+    TEST_ASSERT_EQUAL_STRING("fp_recurse", pc_name(cdk_errno->epcs[i]));
+  }
+}
+
+void test_raise_on_thread_walks_its_stack(void) {
+  thrd_t thread;
+  int ok = 0;
+
+  TEST_ASSERT_EQUAL(thrd_success, thrd_create(&thread, thread_main, NULL));
+  thrd_join(thread, &ok);
+  TEST_ASSERT(ok);
+}
+
+void test_walk_stays_on_thread_stack(void) {
+  static _Alignas(16) char alt[65536];
+  stack_t ss = {.ss_sp = alt, .ss_size = sizeof(alt)}, old_ss;
+  struct sigaction sa = {.sa_handler = on_signal, .sa_flags = SA_ONSTACK};
+  struct sigaction old_sa;
+
+  TEST_ASSERT_EQUAL(0, sigaltstack(&ss, &old_ss));
+  TEST_ASSERT_EQUAL(0, sigaction(SIGUSR1, &sa, &old_sa));
+  raise(SIGUSR1);
+  sigaction(SIGUSR1, &old_sa, NULL);
+  sigaltstack(&old_ss, NULL);
+
+  // The handler ran on the alternate stack, frames are not followed there.
+  TEST_ASSERT_EQUAL(1, cdk_errno->epcs_len);
+  TEST_ASSERT_EQUAL_STRING("fp_read_sector", pc_name(cdk_errno->epcs[0]));
+}
+
+void test_every_raise_walks_again(void) {
+  fp_recurse(20);
+  fp_read_sector();
+
+  TEST_ASSERT(cdk_errno->epcs_len < CDK_ERROR_BTRACE_FP);
+  TEST_ASSERT_EQUAL_STRING("test_every_raise_walks_again",
+                           pc_name(cdk_errno->epcs[1]));
+}
+
+void test_dump_symbolizes_addresses(void) {
+  fp_load_table();
+
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  TEST_ASSERT_NOT_NULL(strstr(out, "------------------------\n Backtrace:\n"
+                                   "   [00] test_cdk_errno_btrace_fp.c:"
+                                   "fp_read_sector:"));
+  TEST_ASSERT_NOT_NULL(
+      strstr(out, "------------------------\n Native backtrace:\n   [00] "));
+  TEST_ASSERT_NOT_NULL(strstr(out, "\n   [01] "));
+#ifdef CDK_ERROR_BTRACE_FP_RAW
+  char line[64];
+
+  snprintf(line, sizeof(line), "   [00] [%p]\n", cdk_errno->epcs[0]);
+  TEST_ASSERT_NOT_NULL(strstr(out, line));
+  TEST_ASSERT_NULL(strstr(out, "(fp_read_sector+0x"));
+#else
+  TEST_ASSERT_NOT_NULL(strstr(out, "(fp_read_sector+0x"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "(fp_read_block+0x"));
+  TEST_ASSERT_NOT_NULL(strstr(out, ") [0x"));
+#endif
+}
+
+void test_dump_drains_native_frames_in_chunks(void) {
+  struct cdk_EDumpCursor cursor = {0};
+  static char drained[4096];
+  size_t len = 0, n;
+
+  fp_load_table();
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  while ((n = cdk_error_dumpr(cdk_errno, &cursor, 5, drained + len))) {
+    len += n;
+  }
+  drained[len] = '\0';
+  TEST_ASSERT_EQUAL_STRING(out, drained);
+}
+
+void test_snapshot_keeps_addresses(void) {
+  struct cdk_Error restored;
+
+  fp_load_table();
+  TEST_ASSERT(cdk_ecapture(sizeof(snap_buf), snap) <= sizeof(snap_buf));
+  cdk_error_restore(&restored, snap);
+
+  TEST_ASSERT_EQUAL(cdk_errno->epcs_len, restored.epcs_len);
+  TEST_ASSERT_EQUAL_MEMORY(cdk_errno->epcs, restored.epcs,
+                           restored.epcs_len * sizeof(void *));
+}
@@ -0,0 +1,83 @@
+#include <errno.h>
+#include <stdio.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+void test_frame_is_single_pointer(void) {
+  TEST_ASSERT_EQUAL(sizeof(void *), sizeof(struct cdk_EFrame));
+}
+
+static int raise_line;
+
+static int raise_einval(void) {
+  raise_line = __LINE__ + 1;
+  cdk_errno = cdk_errnoi(EINVAL);
+  return -1;
+}
+
+void test_callsite_backtrace(void) {
+  for (int i = 0; i < 2; i++) {
+    raise_einval();
+    int wrap_line = __LINE__ + 1;
+    cdk_ewrap();
+
+    TEST_ASSERT_EQUAL(EINVAL, cdk_errno->code);
+    TEST_ASSERT_EQUAL(2, cdk_errno->eframes_len);
+    TEST_ASSERT_EQUAL_STRING("test_cdk_errno_callsite.c",
+                             cdk_eframe_file(&cdk_errno->eframes[0]));
+    TEST_ASSERT_EQUAL_STRING("raise_einval",
+                             cdk_eframe_func(&cdk_errno->eframes[0]));
+    TEST_ASSERT_EQUAL(raise_line, cdk_eframe_line(&cdk_errno->eframes[0]));
+    TEST_ASSERT_EQUAL_STRING("test_callsite_backtrace",
+                             cdk_eframe_func(&cdk_errno->eframes[1]));
+    TEST_ASSERT_EQUAL(wrap_line, cdk_eframe_line(&cdk_errno->eframes[1]));
+  }
+}
+
+void test_callsite_is_shared_between_raises(void) {
+  const struct cdk_ECallsite *sites[2];
+
+  for (int i = 0; i < 2; i++) {
+    raise_einval();
+    sites[i] = cdk_errno->eframes[0].site;
+  }
+
+  TEST_ASSERT_EQUAL_PTR(sites[0], sites[1]);
+}
+
+void test_callsite_id(void) {
+#if defined(__ELF__)
+  raise_einval();
+  const struct cdk_ECallsite *origin = cdk_errno->eframes[0].site;
+  cdk_ewrap();
+  const struct cdk_ECallsite *wrap = cdk_errno->eframes[1].site;
+
+  TEST_ASSERT_NOT_EQUAL(cdk_ecallsite_id(origin), cdk_ecallsite_id(wrap));
+  TEST_ASSERT_EQUAL_PTR(origin, cdk_ecallsite_get(cdk_ecallsite_id(origin)));
+  TEST_ASSERT_EQUAL_PTR(wrap, cdk_ecallsite_get(cdk_ecallsite_id(wrap)));
+  TEST_ASSERT_NULL(cdk_ecallsite_get(UINT32_MAX));
+#endif
+}
+
+void test_callsite_dump(void) {
+  char buf[1024], expected[1024];
+  int line = __LINE__ + 1;
+  cdk_errno = cdk_errnos(ENOBUFS, "No room");
+
+  cdk_edumps(sizeof(buf), buf);
+  snprintf(expected, sizeof(expected),
+           "====== ERROR DUMP ======\n"
+           "Error code: 105\n"
+           "Error desc: No buffer space available\n"
+           "------------------------\n"
+           " Error msg: No room\n"
+           "------------------------\n"
+           " Backtrace:\n"
+           "   [00] test_cdk_errno_callsite.c:test_callsite_dump:%d\n",
+           line);
+  TEST_ASSERT_EQUAL_STRING(expected, buf);
+}
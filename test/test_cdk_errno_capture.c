@@ -0,0 +1,123 @@
+#include <errno.h>
+#include <string.h>
+#include <threads.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+static _Alignas(8) unsigned char snap_buf[CDK_ESNAPSHOT_MAX];
+static struct cdk_ESnapshot *snap = (struct cdk_ESnapshot *)snap_buf;
+
+static int raise_fstr(void) {
+  cdk_errno = cdk_errnof(ENOENT, "No file %s in %d", "a.txt", 42);
+  return -1;
+}
+
+static int raise_dfstr(void) {
+  cdk_errno = cdk_errnod(EINVAL, "Bad %s value %d", "foo", 7);
+  return -1;
+}
+
+static int raise_and_wrap(int (*raise)(void)) {
+  raise();
+  cdk_ewrap();
+  return cdk_ereturn(-1);
+}
+
+// Runs on a fresh thread, asserts stay on the test thread.
+static int resume(void *arg) {
+  char *out = arg;
+
+  if (cdk_errno) {
+    return 1;
+  }
+  cdk_erestore(snap);
+  cdk_ewrap();
+  cdk_edumps(1024, out);
+
+  return cdk_errno != &cdk_hidden_errno;
+}
+
+static void capture_and_resume(char *out) {
+  thrd_t thread;
+  int ret;
+
+  TEST_ASSERT(cdk_ecapture(CDK_ESNAPSHOT_MAX, snap) <= CDK_ESNAPSHOT_MAX);
+  TEST_ASSERT_EQUAL(thrd_success, thrd_create(&thread, resume, out));
+  thrd_join(thread, &ret);
+  TEST_ASSERT_EQUAL(0, ret);
+}
+
+void test_snapshot_keeps_only_used_part(void) {
+  size_t size;
+
+  raise_and_wrap(raise_fstr);
+  size = cdk_ecapture(CDK_ESNAPSHOT_MAX, snap);
+
+  TEST_ASSERT_EQUAL(size, snap->size);
+  TEST_ASSERT_EQUAL(strlen("No file a.txt in 42") + 1, snap->msg_len);
+  TEST_ASSERT(size < sizeof(struct cdk_Error) / 2);
+}
+
+void test_too_small_buffer_is_untouched(void) {
+  size_t size;
+
+  raise_and_wrap(raise_fstr);
+  memset(snap_buf, 0xAA, sizeof(snap_buf));
+
+  size = cdk_ecapture(8, snap);
+
+  TEST_ASSERT(size > 8);
+  TEST_ASSERT_EQUAL(0xAA, snap_buf[0]);
+  TEST_ASSERT_EQUAL(size, cdk_ecapture(size, snap));
+}
+
+void test_restored_fstr_keeps_growing(void) {
+  char out[1024];
+
+  raise_and_wrap(raise_fstr);
+  capture_and_resume(out);
+
+  TEST_ASSERT_NOT_NULL(strstr(out, "No file a.txt in 42"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "[02] test_cdk_errno_capture.c:raise_and"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "[03] test_cdk_errno_capture.c:resume"));
+
+  // The capturing thread still owns its own copy.
+  TEST_ASSERT_EQUAL(3, cdk_errno->eframes_len);
+}
+
+void test_restored_dfstr_formats_lazily(void) {
+  char out[1024];
+
+  raise_and_wrap(raise_dfstr);
+  capture_and_resume(out);
+
+  TEST_ASSERT_NOT_NULL(strstr(out, "Bad foo value 7"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "raise_dfstr"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "raise_and_wrap"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "resume"));
+}
+
+void test_restore_over_previous_error(void) {
+  char msg[64];
+
+  raise_fstr();
+  cdk_ecapture(CDK_ESNAPSHOT_MAX, snap);
+  raise_dfstr();
+  cdk_erestore(snap);
+
+  TEST_ASSERT_EQUAL(ENOENT, cdk_errno->code);
+  TEST_ASSERT_EQUAL(1, cdk_errno->eframes_len);
+  cdk_emsg(sizeof(msg), msg);
+  TEST_ASSERT_EQUAL_STRING("No file a.txt in 42", msg);
+}
+
+void test_size_query_without_buffer(void) {
+  raise_and_wrap(raise_dfstr);
+
+  TEST_ASSERT_EQUAL(cdk_ecapture(CDK_ESNAPSHOT_MAX, snap),
+                    cdk_ecapture(0, NULL));
+}
@@ -0,0 +1,156 @@
+#include <errno.h>
+#include <string.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+static char out[2048];
+
+void setUp(void) { cdk_errno = NULL; }
+
+void tearDown(void) {}
+
+static int open_config(void) {
+  cdk_errno = cdk_errnof(ENOENT, "No file %s", "app.conf");
+  return -1;
+}
+
+static int load_config(void) {
+  if (open_config()) {
+    cdk_ewrap();
+    cdk_ewraps(EINVAL, "Config not loaded");
+    return -1;
+  }
+  return 0;
+}
+
+static int start_service(void) {
+  if (load_config()) {
+    cdk_ewrapi(EIO);
+    return cdk_ereturn(-1);
+  }
+  return 0;
+}
+
+void test_translation_keeps_frames(void) {
+  TEST_ASSERT_EQUAL(-1, start_service());
+
+  TEST_ASSERT_EQUAL(EIO, cdk_errno->code);
+  TEST_ASSERT_EQUAL(cdk_ErrorType_INT, cdk_errno->type);
+  TEST_ASSERT_EQUAL(2, cdk_errno->ecauses_len);
+  TEST_ASSERT_EQUAL(5, cdk_errno->eframes_len);
+
+  TEST_ASSERT_EQUAL(ENOENT, cdk_errno->ecauses[0].code);
+  TEST_ASSERT_EQUAL(2, cdk_errno->ecauses[0].frames_end);
+  TEST_ASSERT_EQUAL(EINVAL, cdk_errno->ecauses[1].code);
+  TEST_ASSERT_EQUAL(3, cdk_errno->ecauses[1].frames_end);
+}
+
+void test_dump_prints_causes_newest_first(void) {
+  const char *eio, *einval, *enoent;
+
+  start_service();
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+
+  eio = strstr(out, "Error code: 5\n");
+  einval = strstr(out, "Caused by: 22 (Invalid argument)\n"
+                       " Error msg: Config not loaded\n"
+                       " Backtrace:\n"
+                       "   [00] test_cdk_errno_cause.c:load_config:");
+  enoent = strstr(out, "Caused by: 2 (No such file or directory)\n"
+                       " Error msg: No file app.conf\n"
+                       " Backtrace:\n"
+                       "   [00] test_cdk_errno_cause.c:open_config:");
+  TEST_ASSERT_NOT_NULL(eio);
+  TEST_ASSERT_NOT_NULL(einval);
+  TEST_ASSERT_NOT_NULL(enoent);
+  TEST_ASSERT(eio < einval && einval < enoent);
+
+  // Frames of the translated error start at its translation.
+  TEST_ASSERT_NOT_NULL(
+      strstr(out, " Backtrace:\n   [00] test_cdk_errno_cause.c:start_service"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "   [01] test_cdk_errno_cause.c:start_s"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "   [01] test_cdk_errno_cause.c:load_co"));
+}
+
+void test_dump_without_causes_is_unchanged(void) {
+  open_config();
+  cdk_ewrap();
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+
+  TEST_ASSERT_NULL(strstr(out, "Caused by"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "   [01] test_cdk_errno_cause.c:test_dump"));
+}
+
+void test_raise_clears_causes(void) {
+  start_service();
+  cdk_errno = cdk_errnoi(EAGAIN);
+
+  TEST_ASSERT_EQUAL(0, cdk_errno->ecauses_len);
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  TEST_ASSERT_NULL(strstr(out, "Caused by"));
+}
+
+void test_formatted_cause_outlives_new_message(void) {
+  cdk_errno = cdk_errnod(ENOENT, "Missing %s #%d", "block", 7);
+  cdk_ewrapf(EIO, "Read of %s failed", "disk0");
+
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  TEST_ASSERT_NOT_NULL(strstr(out, " Error msg: Read of disk0 failed\n"));
+  TEST_ASSERT_NOT_NULL(strstr(out, " Error msg: Missing block #7\n"));
+}
+
+void test_full_chain_keeps_root_and_newest(void) {
+  cdk_errno = cdk_errnos(ENOENT, "root");
+  for (int i = 0; i < CDK_ECAUSE_MAX + 3; i++) {
+    cdk_ewrapi((uint16_t)(100 + i));
+  }
+
+  TEST_ASSERT_EQUAL(CDK_ECAUSE_MAX, cdk_errno->ecauses_len);
+  TEST_ASSERT_EQUAL(100 + CDK_ECAUSE_MAX + 2, cdk_errno->code);
+  TEST_ASSERT_EQUAL(ENOENT, cdk_errno->ecauses[0].code);
+  TEST_ASSERT_EQUAL(1, cdk_errno->ecauses[0].frames_end);
+  TEST_ASSERT_EQUAL(100 + CDK_ECAUSE_MAX + 1,
+                    cdk_errno->ecauses[CDK_ECAUSE_MAX - 1].code);
+
+  // Every frame is still printed once.
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  TEST_ASSERT_NOT_NULL(strstr(out, " Error msg: root\n"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "Caused by: 2 ("));
+}
+
+void test_cause_buffer_overflow_drops_messages(void) {
+  char msg[CDK_ECAUSE_BUF];
+
+  memset(msg, 'x', sizeof(msg) - 1);
+  msg[sizeof(msg) - 1] = '\0';
+
+  cdk_errno = cdk_errnof(ENOENT, "%s", msg);
+  cdk_ewrapf(EINVAL, "second");
+  cdk_ewrapi(EIO);
+
+  TEST_ASSERT_EQUAL(CDK_ECAUSE_BUF, cdk_errno->_ecause_buf_len);
+  TEST_ASSERT_EQUAL(0, cdk_errno->ecauses[0].msg_off);
+  TEST_ASSERT_EQUAL(-1, cdk_errno->ecauses[1].msg_off);
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  TEST_ASSERT_NOT_NULL(strstr(out, "Caused by: 22 (Invalid argument)\n"
+                                   " Backtrace:\n"));
+}
+
+void test_dump_resumes_inside_causes(void) {
+  struct cdk_EDumpCursor cursor = {0};
+  char whole[2048];
+  size_t len = 0, n;
+
+  start_service();
+  cdk_edumps(sizeof(whole), whole);
+
+  while ((n = cdk_error_dumpr(cdk_errno, &cursor, 3, out + len))) {
+    len += n;
+  }
+  out[len] = '\0';
+  TEST_ASSERT_EQUAL_STRING(whole, out);
+}
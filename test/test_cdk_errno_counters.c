@@ -0,0 +1,178 @@
+#include <errno.h>
+#include <string.h>
+#include <threads.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+static int raise_einval(void) {
+  cdk_errno = cdk_errnoi(EINVAL);
+  return -1;
+}
+
+static int raise_enoent(void) {
+  cdk_errno = cdk_errnos(ENOENT, "No file");
+  return -1;
+}
+
+static int wrap_twice(void) {
+  raise_enoent();
+  cdk_ewrap();
+  return cdk_ereturn(-1);
+}
+
+static struct cdk_ECounterSnapshot *find(size_t len,
+                                         struct cdk_ECounterSnapshot *snaps,
+                                         const char *func) {
+  for (size_t i = 0; i < len; i++) {
+    if (strcmp(snaps[i].counter->func, func) == 0) {
+      return &snaps[i];
+    }
+  }
+  return NULL;
+}
+
+void test_counter_is_padded(void) {
+  TEST_ASSERT_EQUAL(0, sizeof(struct cdk_ECounter) % 64);
+  TEST_ASSERT_EQUAL(0, _Alignof(struct cdk_ECounter) % 64);
+}
+
+void test_counters_are_collected_by_linker(void) {
+  struct cdk_ECounterSnapshot snaps[16];
+  size_t len = cdk_ecounters_snapshot(16, snaps);
+
+  // One counter per raising macro in this file, the library adds none.
+  TEST_ASSERT_EQUAL(2, len);
+  TEST_ASSERT_NOT_NULL(find(len, snaps, "raise_einval"));
+  TEST_ASSERT_NOT_NULL(find(len, snaps, "raise_enoent"));
+}
+
+void test_counts_raises_wraps_and_top(void) {
+  struct cdk_ECounterSnapshot before[16], after[16];
+  struct cdk_ECounterSnapshot *b, *a;
+  char buf[512];
+  size_t len;
+
+  len = cdk_ecounters_snapshot(16, before);
+  for (int i = 0; i < 10; i++) {
+    wrap_twice();
+  }
+  cdk_edumps(sizeof(buf), buf);
+  cdk_ecounters_snapshot(16, after);
+
+  b = find(len, before, "raise_enoent");
+  a = find(len, after, "raise_enoent");
+  TEST_ASSERT_EQUAL(10, a->raised - b->raised);
+  TEST_ASSERT_EQUAL(10, a->wrapped[0] - b->wrapped[0]);
+  TEST_ASSERT_EQUAL(10, a->wrapped[1] - b->wrapped[1]);
+  TEST_ASSERT_EQUAL(0, a->wrapped[2] - b->wrapped[2]);
+  TEST_ASSERT_EQUAL(1, a->top - b->top);
+  TEST_ASSERT_EQUAL_STRING("test_cdk_errno_counters.c", a->counter->file);
+}
+
+void test_cursor_dump_counts_once(void) {
+  struct cdk_ECounterSnapshot before[16], after[16];
+  struct cdk_EDumpCursor cursor = {0};
+  char chunk[8];
+  size_t len;
+
+  raise_einval();
+  len = cdk_ecounters_snapshot(16, before);
+  while (cdk_error_dumpr(cdk_errno, &cursor, sizeof(chunk), chunk)) {
+  }
+  cdk_ecounters_snapshot(16, after);
+
+  TEST_ASSERT_EQUAL(1, find(len, after, "raise_einval")->top -
+                           find(len, before, "raise_einval")->top);
+}
+
+static int sink_discard(void *ctx, const char *piece, size_t len) {
+  (void)ctx, (void)piece, (void)len;
+  return 0;
+}
+
+void test_dumping_twice_counts_once(void) {
+  struct cdk_ECounterSnapshot before[16], after[16];
+  char buf[512];
+  size_t len;
+
+  raise_einval();
+  len = cdk_ecounters_snapshot(16, before);
+  cdk_edumps(sizeof(buf), buf);
+  cdk_edumps(sizeof(buf), buf);
+  cdk_error_dumpw(cdk_errno, sink_discard, NULL);
+  cdk_ecounters_snapshot(16, after);
+
+  TEST_ASSERT_EQUAL(1, find(len, after, "raise_einval")->top -
+                           find(len, before, "raise_einval")->top);
+
+  raise_einval();
+  cdk_edumps(sizeof(buf), buf);
+  cdk_ecounters_snapshot(16, after);
+  TEST_ASSERT_EQUAL(2, find(len, after, "raise_einval")->top -
+                           find(len, before, "raise_einval")->top);
+}
+
+void test_constructor_call_is_not_counted(void) {
+  struct cdk_ECounterSnapshot before[16], after[16];
+  struct cdk_Error garbage;
+  char buf[512];
+  size_t len;
+
+  raise_einval();
+  len = cdk_ecounters_snapshot(16, before);
+  for (int i = 0; i < 3; i++) {
+    cdk_error_int(cdk_errno, EIO, __FILE_NAME__, __func__, __LINE__);
+    cdk_ewrap();
+  }
+  cdk_edumps(sizeof(buf), buf);
+
+  // Left behind by an earlier user of the stack.
+  memset(&garbage, 0xa5, sizeof(garbage));
+  cdk_errno = cdk_error_int(&garbage, EIO, __FILE_NAME__, __func__, __LINE__);
+  cdk_ewrap();
+  cdk_edumps(sizeof(buf), buf);
+  cdk_ecounters_snapshot(16, after);
+
+  TEST_ASSERT_NULL(garbage._ecounter);
+  for (size_t i = 0; i < len; i++) {
+    TEST_ASSERT_EQUAL(before[i].raised, after[i].raised);
+    TEST_ASSERT_EQUAL(before[i].wrapped[0], after[i].wrapped[0]);
+    TEST_ASSERT_EQUAL(before[i].top, after[i].top);
+  }
+}
+
+static int storm(void *arg) {
+  (void)arg;
+  for (int i = 0; i < 1000; i++) {
+    raise_einval();
+  }
+  return 0;
+}
+
+void test_snapshot_is_sorted_by_count(void) {
+  struct cdk_ECounterSnapshot snaps[16];
+  thrd_t threads[4];
+  size_t len;
+
+  for (int i = 0; i < 4; i++) {
+    thrd_create(&threads[i], storm, NULL);
+  }
+  for (int i = 0; i < 4; i++) {
+    thrd_join(threads[i], NULL);
+  }
+
+  len = cdk_ecounters_snapshot(16, snaps);
+  TEST_ASSERT_EQUAL_STRING("raise_einval", snaps[0].counter->func);
+  TEST_ASSERT(snaps[0].raised >= 4000);
+  for (size_t i = 1; i < len; i++) {
+    TEST_ASSERT(snaps[i - 1].raised >= snaps[i].raised);
+  }
+
+  // A short array keeps only the hottest callsites.
+  TEST_ASSERT_EQUAL(len, cdk_ecounters_snapshot(1, snaps));
+  TEST_ASSERT_EQUAL_STRING("raise_einval", snaps[0].counter->func);
+}
@@ -0,0 +1,135 @@
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include "cdk_error.hpp"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {};
+
+static char out[2048];
+
+static cdk::result<int> parse_digit(char c) {
+  if (c < '0' || c > '9') {
+    return cdk::fail(EINVAL, "Not a digit");
+  }
+  return c - '0';
+}
+
+static cdk::result<int> parse_number(const char *text) {
+  int number = 0;
+
+  for (; *text; text++) {
+    auto digit = parse_digit(*text);
+    if (!digit) {
+      return digit.wrap();
+    }
+    number = number * 10 + *digit;
+  }
+  return number;
+}
+
+static cdk::result<std::unique_ptr<int>> load(const char *text) {
+  auto number = parse_number(text);
+  if (!number) {
+    return number.wrap();
+  }
+  return std::make_unique<int>(*number);
+}
+
+// C layer reporting errors through cdk_errno.
+static int c_read(int fd) {
+  if (fd < 0) {
+    cdk_errno = cdk_errnoi(EBADF);
+    return -1;
+  }
+  return 0;
+}
+
+static cdk::result<void> read_all(int fd) {
+  if (c_read(fd) < 0) {
+    return cdk::last_error();
+  }
+  return {};
+}
+
+extern "C" {
+
+void setUp(void) { cdk_errno = NULL; }
+
+void tearDown(void) {}
+
+void test_value_passes_through(void) {
+  auto number = parse_number("42");
+
+  TEST_ASSERT_TRUE(number.has_value());
+  TEST_ASSERT_EQUAL(42, *number);
+  TEST_ASSERT_NULL(cdk_errno);
+  // Returned in registers like a pair of a pointer and an int.
+  static_assert(std::is_trivially_copyable_v<decltype(number)>);
+}
+
+void test_error_collects_frames(void) {
+  auto number = parse_number("4x");
+
+  TEST_ASSERT_FALSE(number.has_value());
+  TEST_ASSERT_EQUAL_PTR(&cdk_hidden_errno, number.error());
+  TEST_ASSERT_EQUAL_PTR(cdk_errno, number.error());
+  TEST_ASSERT_EQUAL(EINVAL, number.error()->code);
+  TEST_ASSERT_EQUAL_STRING("Not a digit", number.error()->msg);
+  TEST_ASSERT_EQUAL(2, number.error()->eframes_len);
+
+  // Base name of the file, like __FILE_NAME__.
+  TEST_ASSERT_EQUAL_STRING("test_cdk_errno_cpp.cpp",
+                           number.error()->eframes[0].file);
+  TEST_ASSERT_NOT_NULL(strstr(number.error()->eframes[0].func, "parse_digit"));
+  TEST_ASSERT_EQUAL(17, number.error()->eframes[0].line);
+  TEST_ASSERT_NOT_NULL(
+      strstr(number.error()->eframes[1].func, "parse_number"));
+  TEST_ASSERT_EQUAL(28, number.error()->eframes[1].line);
+}
+
+void test_move_only_value(void) {
+  auto ok = load("7");
+  auto moved = std::move(ok);
+
+  TEST_ASSERT_TRUE(moved.has_value());
+  TEST_ASSERT_EQUAL(7, **moved);
+  static_assert(!std::is_copy_constructible_v<decltype(moved)>);
+  static_assert(std::is_nothrow_move_constructible_v<decltype(moved)>);
+
+  moved = load("?");
+  TEST_ASSERT_FALSE(moved.has_value());
+  TEST_ASSERT_EQUAL(3, moved.error()->eframes_len);
+}
+
+void test_c_error_is_taken_over(void) {
+  auto done = read_all(-1);
+
+  TEST_ASSERT_FALSE(done.has_value());
+  TEST_ASSERT_EQUAL(EBADF, done.error()->code);
+  TEST_ASSERT_TRUE(read_all(0).has_value());
+}
+
+void test_formatted_error_dumps(void) {
+  cdk::result<std::string> name = cdk::failf(ENOENT, "No %s #%d", "disk", 3);
+
+  TEST_ASSERT_FALSE(name.has_value());
+  TEST_ASSERT_EQUAL(0, cdk_error_dumps(name.error(), sizeof(out), out));
+  TEST_ASSERT_NOT_NULL(strstr(out, "Error code: 2\n"));
+  TEST_ASSERT_NOT_NULL(strstr(out, " Error msg: No disk #3\n"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "   [00] test_cdk_errno_cpp.cpp:"));
+}
+
+void test_explicit_storage(void) {
+  struct cdk_Error storage;
+  cdk::result<int> value = cdk::fail(&storage, EIO);
+
+  TEST_ASSERT_EQUAL_PTR(&storage, value.error());
+  TEST_ASSERT_EQUAL(cdk_ErrorType_INT, storage.type);
+  TEST_ASSERT_NULL(cdk_errno);
+}
+}
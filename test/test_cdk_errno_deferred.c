@@ -0,0 +1,170 @@
+#include <errno.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+#define ASSERT_DEFERRED_EQ(fmt, ...)                                           \
+  do {                                                                         \
+    struct cdk_Error base;                                                     \
+    char expected[512], got[512];                                              \
+    snprintf(expected, sizeof(expected), fmt, ##__VA_ARGS__);                  \
+    cdk_errord(&base, EINVAL, fmt, ##__VA_ARGS__);                             \
+    TEST_ASSERT_EQUAL(cdk_ErrorType_DFSTR, base.type);                         \
+    TEST_ASSERT_EQUAL(0, cdk_error_msg(&base, sizeof(got), got));              \
+    TEST_ASSERT_EQUAL_STRING(expected, got);                                   \
+  } while (0)
+
+void test_deferred_matches_snprintf(void) {
+  int value = 42;
+
+  ASSERT_DEFERRED_EQ("no arguments");
+  ASSERT_DEFERRED_EQ("int %d, neg %i, pct %%", 7, -13);
+  ASSERT_DEFERRED_EQ("width [%5d] [%-5d] [%05d] [%+d]", 1, 2, 3, 4);
+  ASSERT_DEFERRED_EQ("star [%*d] [%-*d] [%.*d]", 6, 9, 4, 8, 3, 7);
+  ASSERT_DEFERRED_EQ("unsigned %u %x %X %o %#x", 4000000000u, 255u, 255u, 8u,
+                     16u);
+  ASSERT_DEFERRED_EQ("lengths %hhd %hd %ld %lld %zu %jd", (signed char)-1,
+                     (short)-2, -3L, -4LL, (size_t)5, (intmax_t)-6);
+  ASSERT_DEFERRED_EQ("small %hhu %hu", 300, 70000);
+  ASSERT_DEFERRED_EQ("char %c%c", 'o', 'k');
+  ASSERT_DEFERRED_EQ("double %f %.2f %e %g", 1.5, 3.14159, 12345.678, 0.25);
+  ASSERT_DEFERRED_EQ("string [%s] [%8s] [%-8s] [%.3s]", "abc", "right", "left",
+                     "truncated");
+  ASSERT_DEFERRED_EQ("pointer %p", (void *)&value);
+}
+
+void test_deferred_wide_conversions(void) {
+  char name[CDK_ERROR_FSTR_MAX / 2];
+
+  memset(name, 'n', sizeof(name) - 1);
+  name[sizeof(name) - 1] = '\0';
+
+  ASSERT_DEFERRED_EQ("[%100d] [%-90u] [%0150x]", -7, 8u, 0xbeefu);
+  ASSERT_DEFERRED_EQ("[%.100d] [%+120.90d] [%#.70o]", 42, 3, 8u);
+  ASSERT_DEFERRED_EQ("[%*s] [%-*c] [%.*s]", 200, "r", 100, 'c', 100, name);
+  ASSERT_DEFERRED_EQ("[%130.3f] [%-110e]", 2.5, -1e10);
+}
+
+void test_deferred_large_and_negative_zero_doubles(void) {
+  struct cdk_Error base;
+  char got[64];
+
+  cdk_errord(&base, EINVAL, "%f %f", 1e20, -0.0);
+  TEST_ASSERT_EQUAL(0, cdk_error_msg(&base, sizeof(got), got));
+  TEST_ASSERT_EQUAL_STRING("100000000000000000000.000000 -0.000000", got);
+
+  ASSERT_DEFERRED_EQ("[%f] [%.0f] [%#.0f]", 1e18, 1e23, 123456789e30);
+  ASSERT_DEFERRED_EQ("[%f]", DBL_MAX);
+  ASSERT_DEFERRED_EQ("[%-330.3f]", -DBL_MAX);
+  ASSERT_DEFERRED_EQ("[%+f] [%e] [% g]", -0.0, -0.0, -0.0);
+}
+
+void test_deferred_padding_drains_in_chunks(void) {
+  struct cdk_EDumpCursor cursor = {0};
+  struct cdk_Error base;
+  char whole[2048], drained[2048];
+  size_t len = 0, n;
+
+  cdk_errord(&base, EINVAL, "[%300d] [%-250s] [%.200x] [%f]", 1, "s", 2u,
+             DBL_MAX);
+  TEST_ASSERT_EQUAL(0, cdk_error_dumps(&base, sizeof(whole), whole));
+  while ((n = cdk_error_dumpr(&base, &cursor, 7, drained + len))) {
+    len += n;
+  }
+  drained[len] = '\0';
+
+  TEST_ASSERT_EQUAL_STRING(whole, drained);
+}
+
+void test_deferred_copies_strings(void) {
+  struct cdk_Error base;
+  char name[16] = "/tmp/a.txt";
+  char got[64];
+
+  cdk_errord(&base, ENOENT, "cannot open %s", name);
+  strcpy(name, "overwritten");
+
+  cdk_error_msg(&base, sizeof(got), got);
+  TEST_ASSERT_EQUAL_STRING("cannot open /tmp/a.txt", got);
+}
+
+void test_deferred_arguments_overflow(void) {
+  struct cdk_Error base;
+  char got[CDK_ERROR_FSTR_MAX * 2];
+  char big[CDK_ERROR_FSTR_MAX * 2];
+
+  memset(big, 'x', sizeof(big) - 1);
+  big[sizeof(big) - 1] = '\0';
+
+  cdk_errord(&base, EINVAL, "%d [%s] %d", 1, big, 2);
+  TEST_ASSERT_EQUAL(0, cdk_error_msg(&base, sizeof(got), got));
+  TEST_ASSERT_EQUAL_STRING_LEN("1 [xxxx", got, 7);
+  TEST_ASSERT_LESS_THAN(CDK_ERROR_FSTR_MAX + 8, strlen(got));
+}
+
+void test_deferred_precision_bounds_string(void) {
+  struct cdk_Error base;
+  char *tag = malloc(4);
+  char got[64];
+
+  // Not NUL-terminated, the precision alone bounds the read.
+  memcpy(tag, "ABCD", 4);
+  cdk_errord(&base, EINVAL, "tag %.4s, %.2s", tag, tag);
+  free(tag);
+
+  TEST_ASSERT_EQUAL(0, cdk_error_msg(&base, sizeof(got), got));
+  TEST_ASSERT_EQUAL_STRING("tag ABCD, AB", got);
+}
+
+void test_msg_truncation(void) {
+  struct cdk_Error base;
+  char got[8];
+
+  cdk_errord(&base, EINVAL, "value=%d", 123456);
+  TEST_ASSERT_EQUAL(ENOBUFS, cdk_error_msg(&base, sizeof(got), got));
+  TEST_ASSERT_EQUAL_STRING("value=1", got);
+
+  cdk_errors(&base, EINVAL, "literal message");
+  TEST_ASSERT_EQUAL(ENOBUFS, cdk_error_msg(&base, sizeof(got), got));
+  TEST_ASSERT_EQUAL_STRING("literal", got);
+
+  cdk_errori(&base, EINVAL);
+  TEST_ASSERT_EQUAL(0, cdk_error_msg(&base, sizeof(got), got));
+  TEST_ASSERT_EQUAL_STRING("", got);
+}
+
+void test_deferred_dump(void) {
+  struct cdk_Error base;
+  char buf[1024], expected[1024];
+  int line = __LINE__ + 1;
+  cdk_errord(&base, EINVAL, "bad fd %d", 3);
+
+  snprintf(expected, sizeof(expected),
+           "====== ERROR DUMP ======\n"
+           "Error code: 22\n"
+           "Error desc: Invalid argument\n"
+           "------------------------\n"
+           " Error msg: bad fd 3\n"
+           "------------------------\n"
+           " Backtrace:\n"
+           "   [00] test_cdk_errno_deferred.c:test_deferred_dump:%d\n",
+           line);
+  TEST_ASSERT_EQUAL(0, cdk_error_dumps(&base, sizeof(buf), buf));
+  TEST_ASSERT_EQUAL_STRING(expected, buf);
+
+  TEST_ASSERT_EQUAL(ENOBUFS, cdk_error_dumps(&base, 100, buf));
+}
+
+void test_errorf_routing(void) {
+  struct cdk_Error base;
+
+  cdk_errorf(&base, EINVAL, "%d", 1);
+#ifdef CDK_ERROR_DEFER_FSTR
+  TEST_ASSERT_EQUAL(cdk_ErrorType_DFSTR, base.type);
+#else
+  TEST_ASSERT_EQUAL(cdk_ErrorType_FSTR, base.type);
+#endif
+}
@@ -0,0 +1,148 @@
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+#define NET_EDOMAIN 0x4e01
+#define NET_ERRORS(X)                                                          \
+  X(NET_TIMEOUT, "Peer did not answer in time")                                \
+  X(NET_PROTOCOL, "Peer broke the protocol")
+
+#define DB_EDOMAIN 0x4442
+#define DB_ERRORS(X)                                                           \
+  X(DB_LOCKED, "Table is locked")                                              \
+  X(DB_CORRUPT, "Page checksum mismatch")
+
+CDK_EDOMAIN_CODES(net, NET_EDOMAIN, NET_ERRORS);
+CDK_EDOMAIN_DEFINE(net, NET_EDOMAIN, NET_ERRORS);
+CDK_EDOMAIN_CODES(db, DB_EDOMAIN, DB_ERRORS);
+CDK_EDOMAIN_DEFINE(db, DB_EDOMAIN, DB_ERRORS);
+
+static char out[2048];
+
+void setUp(void) { cdk_errno = NULL; }
+
+void tearDown(void) {}
+
+static int connect_peer(void) {
+  cdk_errno = cdk_errnos(NET_TIMEOUT, "No answer from 10.0.0.1");
+  return -1;
+}
+
+static int sync_table(void) {
+  if (connect_peer()) {
+#ifdef CDK_ERROR_CAUSE
+    cdk_ewrapi(DB_LOCKED);
+#else
+    cdk_errno = cdk_errnoi(DB_LOCKED);
+#endif
+    return -1;
+  }
+  return 0;
+}
+
+void test_code_carries_domain(void) {
+  connect_peer();
+
+  TEST_ASSERT_EQUAL(1, cdk_errno->code);
+  TEST_ASSERT_EQUAL(NET_EDOMAIN, cdk_errno->domain);
+  TEST_ASSERT_EQUAL(NET_EDOMAIN, cdk_error_domain(cdk_errno));
+  TEST_ASSERT_EQUAL_UINT32(NET_TIMEOUT, cdk_error_code(cdk_errno));
+  TEST_ASSERT_EQUAL_UINT32(CDK_ECODE(NET_EDOMAIN, 1), NET_TIMEOUT);
+  TEST_ASSERT_EQUAL_UINT32(CDK_ECODE(NET_EDOMAIN, 2), NET_PROTOCOL);
+}
+
+void test_errno_codes_are_domain_zero(void) {
+  cdk_errno = cdk_errnoi(ENOENT);
+
+  TEST_ASSERT_EQUAL(ENOENT, cdk_errno->code);
+  TEST_ASSERT_EQUAL(0, cdk_error_domain(cdk_errno));
+  TEST_ASSERT_EQUAL(ENOENT, cdk_error_code(cdk_errno));
+  TEST_ASSERT_EQUAL_PTR(cdk_errno_desc(ENOENT), cdk_ecode_desc(ENOENT));
+}
+
+void test_same_value_in_two_domains(void) {
+  const struct cdk_ErrnoDesc *net = cdk_ecode_desc(NET_TIMEOUT);
+  const struct cdk_ErrnoDesc *db = cdk_ecode_desc(DB_LOCKED);
+
+  TEST_ASSERT_EQUAL(NET_TIMEOUT & 0xffff, DB_LOCKED & 0xffff);
+  TEST_ASSERT_EQUAL_STRING("NET_TIMEOUT", net->name);
+  TEST_ASSERT_EQUAL_STRING("Peer did not answer in time", net->desc);
+  TEST_ASSERT_EQUAL_STRING("DB_LOCKED", db->name);
+  TEST_ASSERT_EQUAL_STRING("Table is locked", db->desc);
+}
+
+void test_lookup_of_unknown_codes(void) {
+  TEST_ASSERT_EQUAL_STRING("net", cdk_edomain_get(NET_EDOMAIN)->name);
+  TEST_ASSERT_EQUAL(3, cdk_edomain_get(DB_EDOMAIN)->descs_len);
+  TEST_ASSERT_NULL(cdk_edomain_get(0x1234));
+  TEST_ASSERT_NULL(cdk_ecode_desc(CDK_ECODE(0x1234, 1)));
+  TEST_ASSERT_NULL(cdk_ecode_desc(CDK_ECODE(NET_EDOMAIN, 3)));
+  TEST_ASSERT_NULL(cdk_ecode_desc(CDK_ECODE(NET_EDOMAIN, 0xffff)));
+}
+
+void test_dump_prints_domain(void) {
+  connect_peer();
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+
+  TEST_ASSERT_NOT_NULL(strstr(out, "====== ERROR DUMP ======\n"
+                                   "Error code: 1\n"
+                                   "Error domain: net\n"
+                                   "Error desc: Peer did not answer in time\n"
+                                   "------------------------\n"
+                                   " Error msg: No answer from 10.0.0.1\n"));
+}
+
+void test_dump_of_errno_is_unchanged(void) {
+  cdk_errno = cdk_errnoi(ENOENT);
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+
+  TEST_ASSERT_NOT_NULL(strstr(out, "====== ERROR DUMP ======\n"
+                                   "Error code: 2\n"
+                                   "Error desc: No such file or directory\n"));
+  TEST_ASSERT_NULL(strstr(out, "Error domain"));
+}
+
+void test_dump_of_unknown_domain(void) {
+  cdk_errno = cdk_errnoi(CDK_ECODE(0x1234, 7));
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+
+  TEST_ASSERT_NOT_NULL(strstr(out, "Error code: 7\n"
+                                   "Error domain: 4660\n"
+                                   "Error desc: Unknown error 7\n"));
+}
+
+void test_translation_keeps_domains(void) {
+  sync_table();
+
+  TEST_ASSERT_EQUAL_UINT32(DB_LOCKED, cdk_error_code(cdk_errno));
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  TEST_ASSERT_NOT_NULL(strstr(out, "Error code: 1\n"
+                                   "Error domain: db\n"
+                                   "Error desc: Table is locked\n"));
+#ifdef CDK_ERROR_CAUSE
+  TEST_ASSERT_EQUAL(NET_EDOMAIN, cdk_errno->ecauses[0].domain);
+  TEST_ASSERT_NOT_NULL(
+      strstr(out, "Caused by: 1 (Peer did not answer in time)\n"));
+#endif
+}
+
+void test_record_keeps_domain(void) {
+  static unsigned char buf[1024];
+  const unsigned char *p = buf + 7;
+  uint32_t code = 0;
+
+  connect_peer();
+  TEST_ASSERT(cdk_eencode(sizeof(buf), buf) <= sizeof(buf));
+
+  // Varint after magic, version, size and flags.
+  for (int shift = 0; shift == 0 || p[-1] & 0x80; shift += 7) {
+    code |= (uint32_t)(*p++ & 0x7f) << shift;
+  }
+  TEST_ASSERT_EQUAL_UINT32(NET_TIMEOUT, code);
+}
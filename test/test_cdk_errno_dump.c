@@ -0,0 +1,167 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CDK_ERROR_BTRACE_MAX 32
+#include "cdk_error.h"
+#include "unity.h"
+
+static struct cdk_Error base;
+
+static void build_deep_error(void) {
+  cdk_errors(&base, ECONNREFUSED, "Peer is gone");
+  for (int i = 1; i < CDK_ERROR_BTRACE_MAX; i++) {
+    cdk_error_wrap(&base);
+  }
+}
+
+void test_errno_table_matches_strerror(void) {
+#ifdef __linux__
+  for (int code = 0; code < 134; code++) {
+    const struct cdk_ErrnoDesc *desc = cdk_errno_desc(code);
+    if (!desc) {
+      continue;
+    }
+    TEST_ASSERT_EQUAL_STRING(strerror(code), desc->desc);
+  }
+  TEST_ASSERT_EQUAL_STRING("ECONNREFUSED", cdk_errno_desc(ECONNREFUSED)->name);
+  TEST_ASSERT_EQUAL_STRING("EAGAIN", cdk_errno_desc(EWOULDBLOCK)->name);
+#ifdef CDK_ERRNO_POSIX
+  TEST_ASSERT_NULL(cdk_errno_desc(ENODATA));
+  TEST_ASSERT_NULL(cdk_errno_desc(ENOMEDIUM));
+#else
+  TEST_ASSERT_EQUAL_STRING("ENOMEDIUM", cdk_errno_desc(ENOMEDIUM)->name);
+#endif
+#endif
+  TEST_ASSERT_EQUAL_STRING("EOWNERDEAD", cdk_errno_desc(EOWNERDEAD)->name);
+  TEST_ASSERT_EQUAL_STRING("Broken pipe", cdk_errno_desc(EPIPE)->desc);
+  TEST_ASSERT_NULL(cdk_errno_desc(-1));
+  TEST_ASSERT_NULL(cdk_errno_desc(4000));
+}
+
+void test_cursor_rejects_empty_buffer(void) {
+  struct cdk_EDumpCursor cursor = {0};
+  char chunk[64], one = 'x';
+
+  build_deep_error();
+  TEST_ASSERT_EQUAL(CDK_EDUMP_EINVAL,
+                    cdk_error_dumpr(&base, &cursor, 0, chunk));
+  TEST_ASSERT_EQUAL(cdk_EDumpStage_HEADER, cursor.stage);
+  TEST_ASSERT_EQUAL(0, cursor.offset);
+  TEST_ASSERT(cdk_error_dumpr(&base, &cursor, sizeof(chunk), chunk) > 0);
+
+  TEST_ASSERT_EQUAL(ENOBUFS, cdk_error_dumps(&base, 1, &one));
+  TEST_ASSERT_EQUAL('\0', one);
+}
+
+void test_cursor_drains_with_small_buffer(void) {
+  char expected[4096], got[4096], chunk[64];
+  struct cdk_EDumpCursor cursor = {0};
+  size_t got_len = 0, len;
+
+  build_deep_error();
+  TEST_ASSERT_EQUAL(0, cdk_error_dumps(&base, sizeof(expected), expected));
+
+  while ((len = cdk_error_dumpr(&base, &cursor, sizeof(chunk), chunk))) {
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(chunk), len);
+    memcpy(got + got_len, chunk, len);
+    got_len += len;
+  }
+  got[got_len] = '\0';
+
+  TEST_ASSERT_EQUAL(cdk_EDumpStage_END, cursor.stage);
+  TEST_ASSERT_EQUAL_STRING(expected, got);
+}
+
+void test_cursor_drains_byte_by_byte(void) {
+  char expected[4096], got[4096];
+  struct cdk_EDumpCursor cursor = {0};
+  size_t got_len = 0;
+
+  cdk_errord(&base, EINVAL, "padded [%8s] [%-6d]", "str", 42);
+  cdk_error_wrap(&base);
+  cdk_error_dumps(&base, sizeof(expected), expected);
+
+  while (cdk_error_dumpr(&base, &cursor, 1, got + got_len)) {
+    got_len++;
+  }
+  got[got_len] = '\0';
+
+  TEST_ASSERT_EQUAL_STRING(expected, got);
+}
+
+void test_dumps_exact_fit(void) {
+  char expected[4096], got[4096];
+  size_t len;
+
+  cdk_errori(&base, EINVAL);
+  cdk_error_dumps(&base, sizeof(expected), expected);
+  len = strlen(expected);
+
+  TEST_ASSERT_EQUAL(0, cdk_error_dumps(&base, len + 1, got));
+  TEST_ASSERT_EQUAL_STRING(expected, got);
+
+  TEST_ASSERT_EQUAL(ENOBUFS, cdk_error_dumps(&base, len, got));
+  TEST_ASSERT_EQUAL(len - 1, strlen(got));
+}
+
+struct sink_buf {
+  char data[4096];
+  size_t len;
+  size_t calls;
+};
+
+static int collect(void *ctx, const char *data, size_t len) {
+  struct sink_buf *sink = ctx;
+  memcpy(sink->data + sink->len, data, len);
+  sink->len += len;
+  sink->calls++;
+  return 0;
+}
+
+static int refuse(void *ctx, const char *data, size_t len) {
+  (void)ctx;
+  (void)data;
+  (void)len;
+  return EPIPE;
+}
+
+void test_dump_to_sink(void) {
+  char expected[4096];
+  struct sink_buf sink = {0};
+
+  build_deep_error();
+  cdk_error_dumps(&base, sizeof(expected), expected);
+
+  TEST_ASSERT_EQUAL(0, cdk_error_dumpw(&base, collect, &sink));
+  sink.data[sink.len] = '\0';
+  TEST_ASSERT_EQUAL_STRING(expected, sink.data);
+  TEST_ASSERT_GREATER_THAN(1, sink.calls);
+
+  TEST_ASSERT_EQUAL(EPIPE, cdk_error_dumpw(&base, refuse, NULL));
+}
+
+void test_dump_to_fd(void) {
+  char expected[4096], got[4096];
+  ssize_t len;
+  int fds[2];
+
+  build_deep_error();
+  cdk_error_dumps(&base, sizeof(expected), expected);
+
+  TEST_ASSERT_EQUAL(0, pipe(fds));
+  errno = EINTR;
+  TEST_ASSERT_EQUAL(0, cdk_error_dumpfd(&base, fds[1]));
+  TEST_ASSERT_EQUAL(EINTR, errno);
+  close(fds[1]);
+
+  len = read(fds[0], got, sizeof(got) - 1);
+  close(fds[0]);
+  TEST_ASSERT_EQUAL(strlen(expected), len);
+  got[len] = '\0';
+  TEST_ASSERT_EQUAL_STRING(expected, got);
+
+  TEST_ASSERT_EQUAL(EBADF, cdk_error_dumpfd(&base, -1));
+}
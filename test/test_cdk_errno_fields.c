@@ -0,0 +1,125 @@
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+static char out[2048];
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static int read_at(int fd, uint64_t offset) {
+  cdk_errno = cdk_errnos(EIO, "Short read");
+  cdk_efield("fd", fd);
+  cdk_efield("offset", offset);
+  return -1;
+}
+
+static int fetch(const char *peer) {
+  if (read_at(7, 4096)) {
+    cdk_ewrap();
+    cdk_efield("peer", peer);
+    return -1;
+  }
+  return 0;
+}
+
+void test_fields_keep_types(void) {
+  fetch("10.0.0.1:443");
+
+  TEST_ASSERT_EQUAL(3, cdk_errno->efields_len);
+  TEST_ASSERT_EQUAL_STRING("fd", cdk_errno->efields[0].key);
+  TEST_ASSERT_EQUAL(cdk_EFieldType_INT, cdk_errno->efields[0].type);
+  TEST_ASSERT_EQUAL(7, cdk_errno->efields[0].i64);
+  TEST_ASSERT_EQUAL(cdk_EFieldType_UINT, cdk_errno->efields[1].type);
+  TEST_ASSERT_EQUAL(4096, cdk_errno->efields[1].u64);
+  TEST_ASSERT_EQUAL(cdk_EFieldType_STR, cdk_errno->efields[2].type);
+  TEST_ASSERT_EQUAL_STRING("10.0.0.1:443", cdk_errno->efields[2].str);
+}
+
+void test_dump_prints_fields(void) {
+  fetch("10.0.0.1:443");
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+
+  TEST_ASSERT_NOT_NULL(strstr(out, " Error msg: Short read\n"
+                                   "------------------------\n"
+                                   " Fields:\n"
+                                   "   fd=7\n"
+                                   "   offset=4096\n"
+                                   "   peer=10.0.0.1:443\n"
+                                   "------------------------\n"
+                                   " Backtrace:\n"));
+}
+
+void test_int_error_fields_and_extremes(void) {
+  cdk_errno = cdk_errnoi(ERANGE);
+  cdk_efield("min", INT64_MIN);
+  cdk_efield("max", UINT64_MAX);
+  cdk_efield("name", (const char *)NULL);
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+
+  TEST_ASSERT_NOT_NULL(strstr(out, "Error desc: Numerical result out of range\n"
+                                   "------------------------\n"
+                                   " Fields:\n"
+                                   "   min=-9223372036854775808\n"
+                                   "   max=18446744073709551615\n"
+                                   "   name=(null)\n"));
+}
+
+void test_bytes_are_copied_and_cut(void) {
+  unsigned char key[CDK_EFIELD_BYTES + 4];
+  unsigned char id[2] = {0xde, 0xad};
+
+  memset(key, 0xab, sizeof(key));
+  cdk_errno = cdk_errnoi(EPERM);
+  cdk_efield_bytes("id", id, sizeof(id));
+  cdk_efield_bytes("key", key, sizeof(key));
+  id[0] = 0;
+
+  TEST_ASSERT_EQUAL(CDK_EFIELD_BYTES, cdk_errno->efields[1].len);
+  TEST_ASSERT_EQUAL(sizeof(key), cdk_errno->efields[1].size);
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  TEST_ASSERT_NOT_NULL(strstr(out, "   id=dead\n   key=abababab"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "abab...\n"));
+}
+
+void test_extra_fields_are_dropped(void) {
+  cdk_errno = cdk_errnoi(EINVAL);
+  for (int i = 0; i < CDK_EFIELDS_MAX + 2; i++) {
+    cdk_efield("i", i);
+  }
+
+  TEST_ASSERT_EQUAL(CDK_EFIELDS_MAX, cdk_errno->efields_len);
+  TEST_ASSERT_EQUAL(CDK_EFIELDS_MAX - 1,
+                    cdk_errno->efields[CDK_EFIELDS_MAX - 1].i64);
+}
+
+void test_raise_clears_fields(void) {
+  fetch("peer");
+  cdk_errno = cdk_errnoi(EAGAIN);
+
+  TEST_ASSERT_EQUAL(0, cdk_errno->efields_len);
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  TEST_ASSERT_NULL(strstr(out, "Fields"));
+}
+
+void test_dump_resumes_inside_fields(void) {
+  struct cdk_EDumpCursor cursor = {0};
+  char whole[2048];
+  size_t len = 0, n;
+
+  fetch("10.0.0.1:443");
+  cdk_edumps(sizeof(whole), whole);
+
+  while ((n = cdk_error_dumpr(cdk_errno, &cursor, 5, out + len))) {
+    len += n;
+  }
+  out[len] = '\0';
+  TEST_ASSERT_EQUAL_STRING(whole, out);
+}
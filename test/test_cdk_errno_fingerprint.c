@@ -0,0 +1,72 @@
+#include <errno.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+static int raise_code(int code) {
+  cdk_errno = cdk_errnoi(code);
+  return -1;
+}
+
+static int path_a(int code) {
+  raise_code(code);
+  return cdk_ereturn(-1);
+}
+
+static int path_b(int code) {
+  raise_code(code);
+  return cdk_ereturn(-1);
+}
+
+static uint64_t fingerprint(int (*path)(int), int code) {
+  path(code);
+  return cdk_errno->efingerprint;
+}
+
+void test_same_path_same_fingerprint(void) {
+  TEST_ASSERT_EQUAL_UINT64(fingerprint(path_a, EINVAL),
+                           fingerprint(path_a, EINVAL));
+}
+
+void test_path_and_code_change_fingerprint(void) {
+  uint64_t a = fingerprint(path_a, EINVAL);
+
+  TEST_ASSERT_NOT_EQUAL_UINT64(a, fingerprint(path_b, EINVAL));
+  TEST_ASSERT_NOT_EQUAL_UINT64(a, fingerprint(path_a, EIO));
+}
+
+void test_wrap_extends_fingerprint(void) {
+  uint64_t origin, wrapped;
+
+  raise_code(EINVAL);
+  origin = cdk_errno->efingerprint;
+  cdk_ewrap();
+  wrapped = cdk_errno->efingerprint;
+
+  TEST_ASSERT_NOT_EQUAL_UINT64(origin, wrapped);
+
+  // Constructor resets the fingerprint of a reused error.
+  raise_code(EINVAL);
+  TEST_ASSERT_EQUAL_UINT64(origin, cdk_errno->efingerprint);
+}
+
+void test_frames_past_btrace_max_count(void) {
+  uint64_t fingerprints[2];
+
+  for (int i = 0; i < 2; i++) {
+    raise_code(EINVAL);
+    for (int j = 0; j < CDK_ERROR_BTRACE_MAX; j++) {
+      cdk_ewrap();
+    }
+    if (i) {
+      cdk_ewrap();
+    }
+    TEST_ASSERT_EQUAL(CDK_ERROR_BTRACE_MAX, cdk_errno->eframes_len);
+    fingerprints[i] = cdk_errno->efingerprint;
+  }
+
+  TEST_ASSERT_NOT_EQUAL_UINT64(fingerprints[0], fingerprints[1]);
+}
@@ -0,0 +1,116 @@
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <threads.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+_Thread_local struct cdk_EMsgSpill cdk_emsg_spill = {0};
+
+// Built with CDK_ERROR_FSTR_INLINE=32.
+#define LONG_MSG "Block 42 of disk0 not found after 3 retries"
+
+static _Alignas(8) unsigned char snap_buf[CDK_ESNAPSHOT_MAX];
+static struct cdk_ESnapshot *snap = (struct cdk_ESnapshot *)snap_buf;
+
+static char out[2048];
+
+void setUp(void) { cdk_errno = NULL; }
+
+void tearDown(void) {}
+
+static int read_block(void) {
+  cdk_errno = cdk_errnof(ENOENT, "Block %d of %s not found after %d retries",
+                         42, "disk0", 3);
+  return -1;
+}
+
+void test_header_fits_first_cacheline(void) {
+  TEST_ASSERT_EQUAL(1, sizeof(cdk_hidden_errno.type));
+  TEST_ASSERT_EQUAL(1, sizeof(cdk_hidden_errno.eframes_len));
+  TEST_ASSERT(offsetof(struct cdk_Error, code) < 8);
+  TEST_ASSERT(offsetof(struct cdk_Error, eframes) + sizeof(struct cdk_EFrame) <=
+              64);
+  TEST_ASSERT_EQUAL(CDK_ERROR_FSTR_INLINE, sizeof(cdk_hidden_errno._msg_buf));
+}
+
+void test_short_message_stays_inline(void) {
+  cdk_errno = cdk_errnof(EIO, "Read of %s failed", "sda");
+
+  TEST_ASSERT_EQUAL_PTR(cdk_errno->_msg_buf, cdk_errno->msg);
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  TEST_ASSERT_NOT_NULL(strstr(out, " Error msg: Read of sda failed\n"));
+}
+
+void test_long_message_spills(void) {
+  read_block();
+
+  TEST_ASSERT_EQUAL_PTR(cdk_emsg_spill.buf, cdk_errno->msg);
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  TEST_ASSERT_NOT_NULL(strstr(out, " Error msg: " LONG_MSG "\n"));
+  TEST_ASSERT_EQUAL(0, cdk_emsg(sizeof(out), out));
+  TEST_ASSERT_EQUAL_STRING(LONG_MSG, out);
+}
+
+void test_overwritten_spill_reads_prefix(void) {
+  struct cdk_Error first;
+
+  cdk_errorf(&first, ENOENT, "%s", LONG_MSG);
+  read_block();
+
+  TEST_ASSERT_EQUAL(0, cdk_error_msg(&first, sizeof(out), out));
+  TEST_ASSERT_EQUAL(CDK_ERROR_FSTR_INLINE - 1, strlen(out));
+  TEST_ASSERT_EQUAL(0, strncmp(LONG_MSG, out, strlen(out)));
+  TEST_ASSERT_EQUAL(0, cdk_emsg(sizeof(out), out));
+  TEST_ASSERT_EQUAL_STRING(LONG_MSG, out);
+}
+
+static int raise_on_thread(void *arg) {
+  cdk_errorf(arg, ENOENT, "%s", LONG_MSG);
+  return 0;
+}
+
+void test_spill_of_other_thread_reads_prefix(void) {
+  struct cdk_Error err;
+  thrd_t thread;
+
+  read_block();
+  TEST_ASSERT_EQUAL(thrd_success, thrd_create(&thread, raise_on_thread, &err));
+  TEST_ASSERT_EQUAL(thrd_success, thrd_join(thread, NULL));
+
+  TEST_ASSERT_EQUAL(0, cdk_error_msg(&err, sizeof(out), out));
+  TEST_ASSERT_EQUAL(CDK_ERROR_FSTR_INLINE - 1, strlen(out));
+  TEST_ASSERT_EQUAL(0, strncmp(LONG_MSG, out, strlen(out)));
+}
+
+void test_snapshot_keeps_spilled_message(void) {
+  struct cdk_Error target;
+  size_t size;
+
+  read_block();
+  size = cdk_ecapture(sizeof(snap_buf), snap);
+  TEST_ASSERT(size <= sizeof(snap_buf));
+  TEST_ASSERT_EQUAL(sizeof(LONG_MSG), snap->msg_len);
+
+  cdk_errno = cdk_errnof(EIO, "%s", "Something else entirely, long enough");
+  cdk_error_restore(&target, snap);
+
+  TEST_ASSERT_EQUAL(0, cdk_error_msg(&target, sizeof(out), out));
+  TEST_ASSERT_EQUAL_STRING(LONG_MSG, out);
+}
+
+void test_cause_copies_spilled_message(void) {
+#ifdef CDK_ERROR_CAUSE
+  read_block();
+  cdk_ewrapf(EIO, "Read of %s failed with a long enough message", "disk0");
+
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  TEST_ASSERT_NOT_NULL(strstr(out, " Error msg: " LONG_MSG "\n"));
+  TEST_ASSERT_NOT_NULL(
+      strstr(out, " Error msg: Read of disk0 failed with a long enough "
+                  "message\n"));
+#endif
+}
@@ -0,0 +1,194 @@
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <threads.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+struct cdk_ELazy cdk_elazy = {0};
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error *cdk_lazy_errno = NULL;
+
+#define CAPACITY 4
+
+static struct cdk_EPoolSlot slots[CAPACITY];
+
+// Threads raise, report and wait for the test to let them exit.
+struct Worker {
+  thrd_t thread;
+  int raise;
+  struct cdk_Error *before; // cdk_lazy_errno before the first errno macro
+  struct cdk_Error *err;    // Error the macros wrote to
+  char dump[1024];
+};
+
+static mtx_t lock;
+static cnd_t cond;
+static int started, release;
+
+void setUp(void) {
+  cdk_elazy_init(CAPACITY, slots);
+  atomic_store(&cdk_elazy.overflow, 0);
+  started = release = 0;
+  mtx_init(&lock, mtx_plain);
+  cnd_init(&cond);
+}
+
+void tearDown(void) {
+  cnd_destroy(&cond);
+  mtx_destroy(&lock);
+}
+
+static int open_file(void) {
+  cdk_errno = cdk_errnos(ENOENT, "No such file");
+  return -1;
+}
+
+static int load(void) {
+  if (open_file()) {
+    return cdk_ereturn(-1);
+  }
+  return 0;
+}
+
+static int work(void *arg) {
+  struct Worker *worker = arg;
+
+  worker->before = cdk_lazy_errno;
+  if (worker->raise) {
+    load();
+    worker->err = cdk_errno;
+    cdk_edumps(sizeof(worker->dump), worker->dump);
+  }
+
+  mtx_lock(&lock);
+  started++;
+  cnd_broadcast(&cond);
+  while (!release) {
+    cnd_wait(&cond, &lock);
+  }
+  mtx_unlock(&lock);
+  return 0;
+}
+
+static void run(struct Worker *workers, int len) {
+  for (int i = 0; i < len; i++) {
+    thrd_create(&workers[i].thread, work, &workers[i]);
+  }
+  mtx_lock(&lock);
+  while (started < len) {
+    cnd_wait(&cond, &lock);
+  }
+  mtx_unlock(&lock);
+}
+
+static void finish(struct Worker *workers, int len) {
+  mtx_lock(&lock);
+  release = 1;
+  cnd_broadcast(&cond);
+  mtx_unlock(&lock);
+  for (int i = 0; i < len; i++) {
+    thrd_join(workers[i].thread, NULL);
+  }
+}
+
+static int in_pool(const struct cdk_Error *err) {
+  for (int i = 0; i < CAPACITY; i++) {
+    if (err == &slots[i].err) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Every slot is free again once no thread holds an error.
+static void assert_pool_free(void) {
+  cdk_epool_handle_t handles[CAPACITY];
+
+  for (int i = 0; i < CAPACITY; i++) {
+    handles[i] = cdk_epool_acquire(&cdk_elazy.pool);
+    TEST_ASSERT(handles[i] != 0);
+  }
+  TEST_ASSERT_EQUAL(0, cdk_epool_acquire(&cdk_elazy.pool));
+  for (int i = 0; i < CAPACITY; i++) {
+    TEST_ASSERT_EQUAL(0, cdk_epool_release(&cdk_elazy.pool, handles[i]));
+  }
+}
+
+void test_thread_without_errors_takes_nothing(void) {
+  struct Worker workers[2] = {0};
+
+  run(workers, 2);
+  TEST_ASSERT_NULL(workers[0].before);
+  TEST_ASSERT_NULL(workers[0].err);
+  finish(workers, 2);
+
+  assert_pool_free();
+}
+
+void test_first_error_takes_from_pool(void) {
+  struct Worker workers[2] = {{.raise = 1}, {.raise = 1}};
+
+  run(workers, 2);
+  for (int i = 0; i < 2; i++) {
+    TEST_ASSERT_NULL(workers[i].before);
+    TEST_ASSERT_TRUE(in_pool(workers[i].err));
+    TEST_ASSERT_EQUAL(ENOENT, workers[i].err->code);
+    TEST_ASSERT_EQUAL(2, workers[i].err->eframes_len);
+    TEST_ASSERT_NOT_NULL(
+        strstr(workers[i].dump, "   [01] test_cdk_errno_lazy.c:load:"));
+  }
+  TEST_ASSERT(workers[0].err != workers[1].err);
+  finish(workers, 2);
+
+  TEST_ASSERT_EQUAL(0, atomic_load(&cdk_elazy.overflow));
+  assert_pool_free();
+}
+
+void test_exhausted_pool_allocates(void) {
+  struct Worker workers[CAPACITY + 2];
+  int pooled = 0;
+
+  memset(workers, 0, sizeof(workers));
+  for (int i = 0; i < CAPACITY + 2; i++) {
+    workers[i].raise = 1;
+  }
+
+  run(workers, CAPACITY + 2);
+  for (int i = 0; i < CAPACITY + 2; i++) {
+    TEST_ASSERT_NOT_NULL(workers[i].err);
+    TEST_ASSERT_EQUAL(ENOENT, workers[i].err->code);
+    pooled += in_pool(workers[i].err);
+  }
+  TEST_ASSERT_EQUAL(CAPACITY, pooled);
+  TEST_ASSERT_EQUAL(2, atomic_load(&cdk_elazy.overflow));
+  finish(workers, CAPACITY + 2);
+
+  assert_pool_free();
+}
+
+static int bound(void *arg) {
+  struct cdk_Error **err = arg;
+
+  if (open_file()) {
+    cdk_ebind();
+    cdk_ewrap();
+    *err = cdk_lazy_errno;
+    return (int)cdk_errno->eframes_len;
+  }
+  return 0;
+}
+
+void test_bound_macros_use_lazy_error(void) {
+  struct cdk_Error *err = NULL;
+  thrd_t thread;
+  int frames = 0;
+
+  thrd_create(&thread, bound, &err);
+  thrd_join(thread, &frames);
+
+  TEST_ASSERT_TRUE(in_pool(err));
+  TEST_ASSERT_EQUAL(2, frames);
+  assert_pool_free();
+}
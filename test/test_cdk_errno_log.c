@@ -0,0 +1,193 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+#define CAPACITY 8
+#define THREADS 4
+#define PER_THREAD 1000
+
+static struct cdk_ELogSlot slots[CAPACITY];
+static struct cdk_ELog log;
+static char path[] = "/tmp/test_cdk_errno_log_XXXXXX";
+static char out[65536];
+static int fd;
+
+void setUp(void) {
+  strcpy(path + sizeof(path) - 7, "XXXXXX");
+  fd = mkstemp(path);
+  TEST_ASSERT(fd >= 0);
+  unlink(path);
+}
+
+void tearDown(void) { close(fd); }
+
+// Read back everything written to the log file.
+static void read_out(void) {
+  ssize_t len = pread(fd, out, sizeof(out) - 1, 0);
+
+  TEST_ASSERT(len >= 0);
+  out[len] = '\0';
+}
+
+static size_t count(const char *needle) {
+  size_t n = 0;
+
+  for (const char *p = out; (p = strstr(p, needle)); p++) {
+    n++;
+  }
+  return n;
+}
+
+static int read_block(int block) {
+  cdk_errno = cdk_errnof(EIO, "Read of block %d failed", block);
+  return -1;
+}
+
+static int mount_fs(int block) {
+  if (read_block(block)) {
+    return cdk_ereturn(-1);
+  }
+  return 0;
+}
+
+void test_pushed_errors_are_written(void) {
+  char dump[1024];
+
+  TEST_ASSERT_EQUAL(0, cdk_elog_init(&log, fd, cdk_ELogPolicy_DROP, CAPACITY,
+                                     slots));
+  TEST_ASSERT_EQUAL(0, cdk_elog_start(&log));
+
+  mount_fs(1);
+  TEST_ASSERT_EQUAL(0, cdk_elog(&log));
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(dump), dump));
+  cdk_errno = cdk_errnos(ENOENT, "No superblock");
+  TEST_ASSERT_EQUAL(0, cdk_elog(&log));
+
+  cdk_elog_stop(&log);
+  TEST_ASSERT_EQUAL(2, atomic_load(&log.written));
+  TEST_ASSERT_EQUAL(0, atomic_load(&log.dropped));
+
+  read_out();
+  TEST_ASSERT_EQUAL_STRING_LEN(dump, out, strlen(dump));
+  TEST_ASSERT_NOT_NULL(strstr(out + strlen(dump), "Error msg: No superblock"));
+}
+
+#ifdef CDK_ERROR_COUNTERS
+static uint64_t read_block_top(void) {
+  struct cdk_ECounterSnapshot snaps[16];
+  size_t len = cdk_ecounters_snapshot(16, snaps);
+
+  for (size_t i = 0; i < len; i++) {
+    if (strcmp(snaps[i].counter->func, "read_block") == 0) {
+      return snaps[i].top;
+    }
+  }
+  return 0;
+}
+#endif
+
+void test_logged_and_dumped_error_counts_once(void) {
+#ifdef CDK_ERROR_COUNTERS
+  uint64_t top = read_block_top();
+  char dump[1024];
+
+  cdk_elog_init(&log, fd, cdk_ELogPolicy_DROP, CAPACITY, slots);
+  cdk_elog_start(&log);
+
+  read_block(1);
+  TEST_ASSERT_EQUAL(0, cdk_elog(&log));
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(dump), dump));
+  read_block(2);
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(dump), dump));
+  TEST_ASSERT_EQUAL(0, cdk_elog(&log));
+
+  cdk_elog_stop(&log);
+  TEST_ASSERT_EQUAL(2, atomic_load(&log.written));
+  TEST_ASSERT_EQUAL(2, read_block_top() - top);
+#endif
+}
+
+void test_full_queue_drops_new_errors(void) {
+  cdk_elog_init(&log, fd, cdk_ELogPolicy_DROP, CAPACITY, slots);
+
+  for (int i = 0; i < CAPACITY + 3; i++) {
+    read_block(i);
+    TEST_ASSERT_EQUAL(i < CAPACITY ? 0 : ENOBUFS, cdk_elog(&log));
+  }
+  TEST_ASSERT_EQUAL(3, atomic_load(&log.dropped));
+
+  cdk_elog_start(&log);
+  cdk_elog_stop(&log);
+  read_out();
+  TEST_ASSERT_EQUAL(CAPACITY, count("====== ERROR DUMP"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "Read of block 0 failed"));
+  TEST_ASSERT_NULL(strstr(out, "Read of block 8 failed"));
+}
+
+void test_full_queue_overwrites_oldest(void) {
+  cdk_elog_init(&log, fd, cdk_ELogPolicy_OVERWRITE, CAPACITY, slots);
+
+  for (int i = 0; i < CAPACITY + 3; i++) {
+    read_block(i);
+    TEST_ASSERT_EQUAL(0, cdk_elog(&log));
+  }
+  TEST_ASSERT_EQUAL(3, atomic_load(&log.dropped));
+
+  cdk_elog_start(&log);
+  cdk_elog_stop(&log);
+  read_out();
+  TEST_ASSERT_EQUAL(CAPACITY, count("====== ERROR DUMP"));
+  TEST_ASSERT_NULL(strstr(out, "Read of block 2 failed"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "Read of block 3 failed"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "Read of block 10 failed"));
+}
+
+void test_invalid_capacity(void) {
+  TEST_ASSERT_EQUAL(EINVAL,
+                    cdk_elog_init(&log, fd, cdk_ELogPolicy_DROP, 6, slots));
+  TEST_ASSERT_EQUAL(EINVAL,
+                    cdk_elog_init(&log, fd, cdk_ELogPolicy_DROP, 0, slots));
+}
+
+static void raise_again(void) { cdk_errno = cdk_errnoi(EAGAIN); }
+
+static int producer_main(void *arg) {
+  (void)arg;
+  for (int i = 0; i < PER_THREAD; i++) {
+    raise_again();
+    cdk_elog(&log);
+  }
+  return 0;
+}
+
+void test_concurrent_producers(void) {
+  thrd_t threads[THREADS];
+  char dump[1024];
+
+  raise_again();
+  cdk_edumps(sizeof(dump), dump);
+
+  cdk_elog_init(&log, fd, cdk_ELogPolicy_OVERWRITE, CAPACITY, slots);
+  cdk_elog_start(&log);
+  for (int t = 0; t < THREADS; t++) {
+    thrd_create(&threads[t], producer_main, NULL);
+  }
+  for (int t = 0; t < THREADS; t++) {
+    thrd_join(threads[t], NULL);
+  }
+  cdk_elog_stop(&log);
+
+  // Every error is either written whole or counted as dropped.
+  TEST_ASSERT_EQUAL(THREADS * PER_THREAD, atomic_load(&log.written) +
+                                              atomic_load(&log.dropped));
+  TEST_ASSERT_EQUAL(atomic_load(&log.written) * strlen(dump),
+                    lseek(fd, 0, SEEK_END));
+}
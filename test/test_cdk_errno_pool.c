@@ -0,0 +1,123 @@
+#include <errno.h>
+#include <string.h>
+#include <threads.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+#define CAPACITY 8
+
+static struct cdk_EPoolSlot slots[CAPACITY];
+static struct cdk_EPool pool;
+
+void setUp(void) { cdk_epool_init(&pool, CAPACITY, slots); }
+
+void tearDown(void) {}
+
+static int fail_connection(cdk_error_t err, int fd) {
+  cdk_errors(err, ECONNRESET, "Connection reset by peer");
+  (void)fd;
+  return cdk_error_return(-1, err);
+}
+
+void test_acquire_until_exhausted(void) {
+  cdk_epool_handle_t handles[CAPACITY];
+
+  for (int i = 0; i < CAPACITY; i++) {
+    handles[i] = cdk_epool_acquire(&pool);
+    TEST_ASSERT(handles[i] != 0);
+    TEST_ASSERT_NOT_NULL(cdk_epool_get(&pool, handles[i]));
+    for (int j = 0; j < i; j++) {
+      TEST_ASSERT(cdk_epool_get(&pool, handles[i]) !=
+                  cdk_epool_get(&pool, handles[j]));
+    }
+  }
+  TEST_ASSERT_EQUAL(0, cdk_epool_acquire(&pool));
+
+  TEST_ASSERT_EQUAL(0, cdk_epool_release(&pool, handles[3]));
+  TEST_ASSERT(cdk_epool_acquire(&pool) != 0);
+}
+
+void test_stale_handle_is_rejected(void) {
+  cdk_epool_handle_t handle = cdk_epool_acquire(&pool), reused;
+
+  TEST_ASSERT_EQUAL(0, cdk_epool_release(&pool, handle));
+  TEST_ASSERT_NULL(cdk_epool_get(&pool, handle));
+  TEST_ASSERT_EQUAL(EINVAL, cdk_epool_release(&pool, handle));
+
+  // Slot is reused under a new generation.
+  reused = cdk_epool_acquire(&pool);
+  TEST_ASSERT_EQUAL((uint32_t)handle, (uint32_t)reused);
+  TEST_ASSERT(handle != reused);
+  TEST_ASSERT_NULL(cdk_epool_get(&pool, handle));
+  TEST_ASSERT_NOT_NULL(cdk_epool_get(&pool, reused));
+}
+
+void test_invalid_handles(void) {
+  TEST_ASSERT_NULL(cdk_epool_get(&pool, 0));
+  TEST_ASSERT_NULL(cdk_epool_get(&pool, (uint64_t)1 << 32 | CAPACITY));
+  TEST_ASSERT_EQUAL(EINVAL, cdk_epool_release(&pool, 0));
+}
+
+void test_generic_api_on_pooled_error(void) {
+  cdk_epool_handle_t handle = cdk_epool_acquire(&pool);
+  cdk_error_t err = cdk_epool_get(&pool, handle);
+  char buf[512];
+
+  TEST_ASSERT_EQUAL(-1, fail_connection(err, 7));
+  cdk_error_wrap(err);
+
+  TEST_ASSERT_EQUAL(ECONNRESET, err->code);
+  TEST_ASSERT_EQUAL(3, err->eframes_len);
+  TEST_ASSERT_EQUAL(0, cdk_error_dumps(err, sizeof(buf), buf));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "Connection reset by peer"));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "fail_connection"));
+
+  // Thread's own errno slot is not touched.
+  TEST_ASSERT_NULL(cdk_errno);
+}
+
+static int churn(void *arg) {
+  int id = (int)(intptr_t)arg;
+
+  for (int i = 0; i < 20000; i++) {
+    cdk_epool_handle_t handle = cdk_epool_acquire(&pool);
+    cdk_error_t err;
+
+    if (!handle) {
+      continue;
+    }
+    err = cdk_epool_get(&pool, handle);
+    cdk_errori(err, (uint16_t)id);
+    thrd_yield();
+    // Nobody else got this slot while we held it.
+    if (err->code != id || cdk_epool_release(&pool, handle)) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+void test_concurrent_acquire_release(void) {
+  thrd_t threads[12];
+  int ret;
+
+  for (int i = 0; i < 12; i++) {
+    TEST_ASSERT_EQUAL(thrd_success, thrd_create(&threads[i], churn,
+                                                (void *)(intptr_t)(i + 1)));
+  }
+  for (int i = 0; i < 12; i++) {
+    thrd_join(threads[i], &ret);
+    TEST_ASSERT_EQUAL(0, ret);
+  }
+
+  // Every slot made it back to the free list.
+  for (int i = 0; i < CAPACITY; i++) {
+    TEST_ASSERT(cdk_epool_acquire(&pool) != 0);
+  }
+  TEST_ASSERT_EQUAL(0, cdk_epool_acquire(&pool));
+}
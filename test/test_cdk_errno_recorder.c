@@ -0,0 +1,187 @@
+#include <errno.h>
+#include <threads.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+struct cdk_ERecorder cdk_erecorder = {0};
+_Thread_local struct cdk_ERing *cdk_ering = NULL;
+
+#define RECORDS_MAX 256
+
+struct Collected {
+  size_t len;
+  struct {
+    uint32_t thread;
+    uint64_t index;
+    int open;
+    struct cdk_ERecord record;
+  } items[RECORDS_MAX];
+};
+
+static struct Collected collected;
+
+static void collect(void *ctx, uint32_t thread, uint64_t index, int open,
+                    const struct cdk_ERecord *record) {
+  struct Collected *c = ctx;
+  if (c->len < RECORDS_MAX) {
+    c->items[c->len].thread = thread;
+    c->items[c->len].index = index;
+    c->items[c->len].open = open;
+    c->items[c->len].record = *record;
+    c->len++;
+  }
+}
+
+static size_t drain(void) {
+  collected.len = 0;
+  return cdk_erecorder_drain(&cdk_erecorder, collect, &collected);
+}
+
+static int raise_code(int code) {
+  cdk_errno = cdk_errnoi(code);
+  return -1;
+}
+
+static int raise_and_wrap(int code) {
+  raise_code(code);
+  cdk_ewrap();
+  return -1;
+}
+
+void setUp(void) { drain(); }
+
+void tearDown(void) {}
+
+void test_raise_is_recorded(void) {
+  raise_code(EINVAL);
+
+  TEST_ASSERT_EQUAL(1, drain());
+  TEST_ASSERT_EQUAL(1, collected.items[0].open);
+  TEST_ASSERT_EQUAL(EINVAL, collected.items[0].record.code);
+  TEST_ASSERT_EQUAL(1, collected.items[0].record.sites_len);
+  TEST_ASSERT_EQUAL_PTR(
+      cdk_errno->eframes[0].site,
+      cdk_ecallsite_get(collected.items[0].record.sites[0]));
+
+  // Unchanged open record is not delivered twice.
+  TEST_ASSERT_EQUAL(0, drain());
+}
+
+void test_wrap_extends_record(void) {
+  raise_and_wrap(ENOENT);
+
+  TEST_ASSERT_EQUAL(1, drain());
+  TEST_ASSERT_EQUAL(2, collected.items[0].record.sites_len);
+  for (size_t i = 0; i < 2; i++) {
+    TEST_ASSERT_EQUAL_PTR(
+        cdk_errno->eframes[i].site,
+        cdk_ecallsite_get(collected.items[0].record.sites[i]));
+  }
+
+  // Growing open record is delivered again.
+  cdk_ewrap();
+  TEST_ASSERT_EQUAL(1, drain());
+  TEST_ASSERT_EQUAL(3, collected.items[0].record.sites_len);
+}
+
+void test_records_keep_order(void) {
+  uint64_t first;
+
+  raise_code(EPERM);
+  raise_code(EIO);
+  raise_and_wrap(EAGAIN);
+
+  TEST_ASSERT_EQUAL(3, drain());
+  first = collected.items[0].index;
+  TEST_ASSERT_EQUAL(EPERM, collected.items[0].record.code);
+  TEST_ASSERT_EQUAL(EIO, collected.items[1].record.code);
+  TEST_ASSERT_EQUAL(EAGAIN, collected.items[2].record.code);
+  for (size_t i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL(first + i, collected.items[i].index);
+    TEST_ASSERT_EQUAL(i == 2, collected.items[i].open);
+  }
+  TEST_ASSERT(collected.items[0].record.timestamp <=
+              collected.items[2].record.timestamp);
+}
+
+void test_overflow_counts_dropped(void) {
+  struct cdk_ERing *ring = cdk_ering;
+  uint64_t dropped = ring->dropped;
+
+  for (int i = 0; i < CDK_ERECORDER_RING + 10; i++) {
+    raise_code(EINVAL);
+  }
+
+  TEST_ASSERT_EQUAL(CDK_ERECORDER_RING, drain());
+  TEST_ASSERT_EQUAL(dropped + 10, ring->dropped);
+}
+
+void test_wrap_of_overwritten_record_is_ignored(void) {
+  struct cdk_Error old;
+
+  raise_code(EINVAL);
+  old = *cdk_errno;
+  for (int i = 0; i < CDK_ERECORDER_RING; i++) {
+    raise_code(EIO);
+  }
+  drain();
+
+  cdk_error_wrap(&old);
+  TEST_ASSERT_EQUAL(0, drain());
+}
+
+static int thread_main(void *arg) {
+  int code = (int)(intptr_t)arg;
+
+  for (int i = 0; i < 4; i++) {
+    raise_and_wrap(code);
+  }
+
+  return 0;
+}
+
+void test_threads_have_own_rings(void) {
+  thrd_t threads[4];
+  size_t per_code[4] = {0};
+  uint32_t ring_of[4];
+
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_EQUAL(thrd_success, thrd_create(&threads[i], thread_main,
+                                                (void *)(intptr_t)(i + 1)));
+  }
+  for (int i = 0; i < 4; i++) {
+    thrd_join(threads[i], NULL);
+  }
+
+  TEST_ASSERT_EQUAL(16, drain());
+  for (size_t i = 0; i < collected.len; i++) {
+    int code = collected.items[i].record.code;
+    TEST_ASSERT(code >= 1 && code <= 4);
+    TEST_ASSERT_EQUAL(2, collected.items[i].record.sites_len);
+    if (per_code[code - 1]++ == 0) {
+      ring_of[code - 1] = collected.items[i].thread;
+    }
+    TEST_ASSERT_EQUAL(ring_of[code - 1], collected.items[i].thread);
+  }
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_EQUAL(4, per_code[i]);
+  }
+}
+
+void test_ring_is_released_at_thread_exit(void) {
+  thrd_t thread;
+
+  for (int i = 0; i < CDK_ERECORDER_THREADS + 4; i++) {
+    TEST_ASSERT_EQUAL(thrd_success, thrd_create(&thread, thread_main,
+                                                (void *)(intptr_t)1));
+    thrd_join(thread, NULL);
+  }
+
+  TEST_ASSERT(drain() > 0);
+  for (size_t i = 0; i < collected.len; i++) {
+    TEST_ASSERT(collected.items[i].thread < 3);
+  }
+}
@@ -0,0 +1,136 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+// Built with CDK_ERROR_BTRACE_MAX=6 and CDK_ERROR_BTRACE_PIN=2.
+#define RING (CDK_ERROR_BTRACE_MAX - CDK_ERROR_BTRACE_PIN)
+
+static char out[4096];
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static int parse_expr(int depth) {
+  if (depth == 0) {
+    cdk_errno = cdk_errnos(EINVAL, "Unexpected token");
+    return -1;
+  }
+  if (parse_expr(depth - 1)) {
+    return cdk_ereturn(-1);
+  }
+  return 0;
+}
+
+static int parse_document(int depth) {
+  if (parse_expr(depth)) {
+    return cdk_ereturn(-1);
+  }
+  return 0;
+}
+
+void test_short_trace_is_not_affected(void) {
+  parse_document(2);
+
+  TEST_ASSERT_EQUAL(4, cdk_errno->eframes_len);
+  TEST_ASSERT_EQUAL(0, cdk_errno->eframes_omitted);
+  TEST_ASSERT_EQUAL(4, cdk_error_depth(cdk_errno));
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  TEST_ASSERT_NULL(strstr(out, "omitted"));
+}
+
+void test_deep_trace_keeps_origin_and_entry(void) {
+  const struct cdk_EFrame *frame;
+
+  // Origin, 20 recursion levels and the entry point.
+  parse_document(20);
+
+  TEST_ASSERT_EQUAL(CDK_ERROR_BTRACE_MAX, cdk_errno->eframes_len);
+  TEST_ASSERT_EQUAL(22 - CDK_ERROR_BTRACE_MAX, cdk_errno->eframes_omitted);
+  TEST_ASSERT_EQUAL(22, cdk_error_depth(cdk_errno));
+
+  frame = cdk_error_frame(cdk_errno, 0);
+  TEST_ASSERT_NOT_NULL(frame);
+  TEST_ASSERT_EQUAL_STRING("parse_expr", cdk_eframe_func(frame));
+  TEST_ASSERT_NULL(cdk_error_frame(cdk_errno, CDK_ERROR_BTRACE_PIN));
+  TEST_ASSERT_NULL(cdk_error_frame(cdk_errno, 22 - RING - 1));
+  TEST_ASSERT_NOT_NULL(cdk_error_frame(cdk_errno, 22 - RING));
+  TEST_ASSERT_NULL(cdk_error_frame(cdk_errno, 22));
+
+  frame = cdk_error_frame(cdk_errno, 21);
+  TEST_ASSERT_NOT_NULL(frame);
+  TEST_ASSERT_EQUAL_STRING("parse_document", cdk_eframe_func(frame));
+}
+
+void test_dump_counts_omitted_frames(void) {
+  char line[64];
+
+  parse_document(20);
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+
+  TEST_ASSERT_NOT_NULL(strstr(out, "   [00] test_cdk_errno_ring.c:parse_expr"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "   [01] test_cdk_errno_ring.c:parse_expr"));
+  snprintf(line, sizeof(line), "\n   ... %d frames omitted\n   [%02d] ",
+           22 - CDK_ERROR_BTRACE_MAX, 22 - RING);
+  TEST_ASSERT_NOT_NULL(strstr(out, line));
+  TEST_ASSERT_NOT_NULL(
+      strstr(out, "   [21] test_cdk_errno_ring.c:parse_document"));
+  TEST_ASSERT_NULL(strstr(out, "[22]"));
+}
+
+void test_raise_resets_ring(void) {
+  parse_document(20);
+  cdk_errno = cdk_errnoi(EAGAIN);
+
+  TEST_ASSERT_EQUAL(1, cdk_errno->eframes_len);
+  TEST_ASSERT_EQUAL(0, cdk_errno->eframes_omitted);
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  TEST_ASSERT_NULL(strstr(out, "omitted"));
+}
+
+static int load(void) {
+  if (parse_document(10)) {
+#ifdef CDK_ERROR_CAUSE
+    cdk_ewrapi(EIO);
+#else
+    cdk_ewrap();
+#endif
+    for (int i = 0; i < 3; i++) {
+      cdk_ewrap();
+    }
+    return -1;
+  }
+  return 0;
+}
+
+void test_outer_frames_stay_in_ring(void) {
+  const char *omitted;
+
+  load();
+
+  TEST_ASSERT_EQUAL(16, cdk_error_depth(cdk_errno));
+  TEST_ASSERT_EQUAL(0, cdk_edumps(sizeof(out), out));
+  omitted = strstr(out, "   [01] test_cdk_errno_ring.c:parse_expr:");
+  TEST_ASSERT_NOT_NULL(omitted);
+  omitted = strstr(omitted, "\n   ... 10 frames omitted\n");
+  TEST_ASSERT_NOT_NULL(omitted);
+
+#ifdef CDK_ERROR_CAUSE
+  // Frames since the translation are the error's own, the cause keeps the
+  // pinned frames and the omitted ones.
+  TEST_ASSERT_EQUAL(12, cdk_errno->ecauses[0].frames_end);
+  TEST_ASSERT_NOT_NULL(strstr(out, " Backtrace:\n"
+                                   "   [00] test_cdk_errno_ring.c:load:"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "   [03] test_cdk_errno_ring.c:load:"));
+  TEST_ASSERT_EQUAL_STRING("\n   ... 10 frames omitted\n", omitted);
+#else
+  TEST_ASSERT_NOT_NULL(strstr(omitted, "   [12] test_cdk_errno_ring.c:load:"));
+  TEST_ASSERT_NOT_NULL(strstr(omitted, "   [15] test_cdk_errno_ring.c:load:"));
+#endif
+}
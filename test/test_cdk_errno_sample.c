@@ -0,0 +1,136 @@
+#include <errno.h>
+#include <threads.h>
+
+#define CDK_ERROR_SAMPLE_RATE(code) ((code) == ECONNREFUSED ? 4 : 1)
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+static int connect_refused(void) {
+  cdk_errno = cdk_errnoi(ECONNREFUSED);
+  return -1;
+}
+
+static int connect_wrapped(void) {
+  connect_refused();
+  return cdk_ereturn(-1);
+}
+
+static int read_failed(void) {
+  cdk_errno = cdk_errnos(EIO, "Read failed");
+  return -1;
+}
+
+static int read_failed_sampled(void) {
+  cdk_errno = cdk_errnos_sampled(EIO, "Read failed", 2);
+  return -1;
+}
+
+void test_rate_per_code(void) {
+  for (uint32_t i = 0; i < 12; i++) {
+    connect_wrapped();
+    cdk_ewrap();
+
+    if (i % 4 == 0) {
+      TEST_ASSERT_EQUAL(3, cdk_errno->eframes_len);
+      TEST_ASSERT_EQUAL(i ? 3 : 0, cdk_errno->esuppressed);
+    } else {
+      TEST_ASSERT_EQUAL(1, cdk_errno->eframes_len);
+      TEST_ASSERT_EQUAL(i % 4, cdk_errno->esuppressed);
+      TEST_ASSERT_EQUAL_STRING("connect_refused",
+                               cdk_eframe_func(&cdk_errno->eframes[0]));
+    }
+    TEST_ASSERT_EQUAL(ECONNREFUSED, cdk_errno->code);
+  }
+}
+
+void test_other_codes_are_not_sampled(void) {
+  for (int i = 0; i < 4; i++) {
+    read_failed();
+    cdk_ewrap();
+    TEST_ASSERT_EQUAL(2, cdk_errno->eframes_len);
+    TEST_ASSERT_EQUAL(0, cdk_errno->esuppressed);
+  }
+}
+
+void test_rate_per_callsite(void) {
+  size_t lens[4];
+
+  for (int i = 0; i < 4; i++) {
+    read_failed_sampled();
+    cdk_ewrap();
+    lens[i] = cdk_errno->eframes_len;
+  }
+
+  TEST_ASSERT_EQUAL(2, lens[0]);
+  TEST_ASSERT_EQUAL(1, lens[1]);
+  TEST_ASSERT_EQUAL(2, lens[2]);
+  TEST_ASSERT_EQUAL(1, lens[3]);
+}
+
+void test_dump_reports_suppressed(void) {
+  char buf[512];
+
+  // Start from a full trace, then suppress three.
+  while (connect_refused(), !cdk_errno->_enotrace ||
+                                cdk_errno->esuppressed != 3) {
+  }
+  connect_refused();
+  TEST_ASSERT_EQUAL(0, cdk_errno->_enotrace);
+
+  cdk_edumps(sizeof(buf), buf);
+  TEST_ASSERT_NOT_NULL(strstr(buf, "connect_refused:12\n"
+                                   "Suppressed: 3 traces\n"));
+
+  read_failed();
+  cdk_edumps(sizeof(buf), buf);
+  TEST_ASSERT_NULL(strstr(buf, "Suppressed"));
+}
+
+static int first_trace(void *arg) {
+  (void)arg;
+  connect_wrapped();
+  return (int)cdk_errno->eframes_len;
+}
+
+void test_sampling_is_per_thread(void) {
+  thrd_t thread;
+  int len;
+
+  connect_refused();
+  if (!cdk_errno->_enotrace) {
+    connect_refused();
+  }
+  TEST_ASSERT_EQUAL(1, cdk_errno->_enotrace);
+
+  thrd_create(&thread, first_trace, NULL);
+  thrd_join(thread, &len);
+  TEST_ASSERT_EQUAL(2, len);
+}
+
+void test_untraced_wraps_are_counted(void) {
+#ifdef CDK_ERROR_COUNTERS
+  const struct cdk_ECounter *counter;
+  uint64_t raised, wrapped[3];
+
+  connect_refused();
+  counter = cdk_errno->_ecounter;
+  raised = atomic_load(&counter->raised);
+  for (int i = 0; i < 3; i++) {
+    wrapped[i] = atomic_load(&counter->wrapped[i]);
+  }
+
+  // Three out of four of these are not traced.
+  for (int i = 0; i < 8; i++) {
+    connect_wrapped();
+    cdk_ewrap();
+  }
+
+  TEST_ASSERT_EQUAL(8, atomic_load(&counter->raised) - raised);
+  TEST_ASSERT_EQUAL(8, atomic_load(&counter->wrapped[0]) - wrapped[0]);
+  TEST_ASSERT_EQUAL(8, atomic_load(&counter->wrapped[1]) - wrapped[1]);
+  TEST_ASSERT_EQUAL(0, atomic_load(&counter->wrapped[2]) - wrapped[2]);
+#endif
+}
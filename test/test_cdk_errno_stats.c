@@ -0,0 +1,166 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <threads.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+struct cdk_EStats *cdk_estats = NULL;
+
+static char path[] = "/tmp/test_cdk_errno_stats_XXXXXX";
+static struct cdk_EStats *reader;
+
+void setUp(void) {
+  int fd = mkstemp(path);
+  TEST_ASSERT(fd >= 0);
+  close(fd);
+
+  TEST_ASSERT_EQUAL(0, cdk_estats_open(path));
+
+  // Attach like an outside reader would.
+  fd = open(path, O_RDONLY);
+  TEST_ASSERT(fd >= 0);
+  reader = mmap(NULL, sizeof(*reader), PROT_READ, MAP_SHARED, fd, 0);
+  TEST_ASSERT(reader != MAP_FAILED);
+  close(fd);
+}
+
+void tearDown(void) {
+  munmap(reader, sizeof(*reader));
+  cdk_estats_close();
+  unlink(path);
+  memcpy(path + sizeof(path) - 7, "XXXXXX", 6);
+}
+
+static int raise_einval(void) {
+  cdk_errno = cdk_errnoi(EINVAL);
+  return -1;
+}
+
+static int raise_big_code(void) {
+  cdk_errno = cdk_errnos(60000, "Big code");
+  return -1;
+}
+
+static int wrap_einval(void) {
+  raise_einval();
+  return cdk_ereturn(-1);
+}
+
+static struct cdk_EStatsSite *find_site(const char *func) {
+  for (size_t i = 0; i < CDK_ESTATS_SITES; i++) {
+    if (reader->sites[i].seq == 2 &&
+        strcmp(reader->sites[i].origin.func, func) == 0) {
+      return &reader->sites[i];
+    }
+  }
+  return NULL;
+}
+
+void test_header(void) {
+  struct stat st;
+
+  TEST_ASSERT_EQUAL_MEMORY(CDK_ESTATS_MAGIC, reader->header.magic, 8);
+  TEST_ASSERT_EQUAL(CDK_ESTATS_VERSION, reader->header.version);
+  TEST_ASSERT_EQUAL(getpid(), reader->header.pid);
+  TEST_ASSERT_EQUAL(CDK_ESTATS_SITES, reader->header.sites_len);
+  TEST_ASSERT_EQUAL(offsetof(struct cdk_EStats, traces),
+                    reader->header.traces_off);
+  TEST_ASSERT_EQUAL(0, stat(path, &st));
+  TEST_ASSERT_EQUAL(reader->header.size, st.st_size);
+}
+
+void test_codes_and_sites(void) {
+  struct cdk_EStatsSite *site;
+
+  for (int i = 0; i < 5; i++) {
+    raise_einval();
+  }
+  raise_big_code();
+
+  TEST_ASSERT_EQUAL(5, reader->codes[EINVAL]);
+  TEST_ASSERT_EQUAL(1, reader->header.other_codes);
+
+  site = find_site("raise_einval");
+  TEST_ASSERT_NOT_NULL(site);
+  TEST_ASSERT_EQUAL(5, site->count);
+  TEST_ASSERT_EQUAL(EINVAL, site->code);
+  TEST_ASSERT_EQUAL_STRING("test_cdk_errno_stats.c", site->origin.file);
+  TEST_ASSERT_EQUAL(cdk_eframe_line(&cdk_errno->eframes[0]) - 5,
+                    site->origin.line);
+  TEST_ASSERT_EQUAL(1, find_site("raise_big_code")->count);
+}
+
+void test_recent_traces(void) {
+  struct cdk_EStatsTrace *trace;
+
+  wrap_einval();
+  cdk_ewrap();
+
+  TEST_ASSERT_EQUAL(1, reader->header.traces_head);
+  trace = &reader->traces[0];
+  TEST_ASSERT_EQUAL(2, trace->seq);
+  TEST_ASSERT(trace->timestamp > 0);
+  TEST_ASSERT_EQUAL(EINVAL, trace->code);
+  TEST_ASSERT_EQUAL(3, trace->frames_len);
+  TEST_ASSERT_EQUAL_STRING("raise_einval", trace->frames[0].func);
+  TEST_ASSERT_EQUAL_STRING("wrap_einval", trace->frames[1].func);
+  TEST_ASSERT_EQUAL_STRING("test_recent_traces", trace->frames[2].func);
+}
+
+void test_site_and_trace_keep_domain(void) {
+#ifdef CDK_ERROR_DOMAINS
+  cdk_ecode_t code = CDK_ECODE(0x4e01, EINVAL);
+
+  cdk_errno = cdk_errnoi(code);
+
+  TEST_ASSERT_EQUAL(0, reader->codes[EINVAL]);
+  TEST_ASSERT_EQUAL(1, reader->header.other_codes);
+  TEST_ASSERT_EQUAL_UINT32(code, find_site(__func__)->code);
+  TEST_ASSERT_EQUAL_UINT32(code, reader->traces[0].code);
+#endif
+}
+
+void test_overwritten_trace_is_not_extended(void) {
+  struct cdk_Error old;
+
+  raise_einval();
+  old = *cdk_errno;
+  for (int i = 0; i < CDK_ESTATS_TRACES; i++) {
+    raise_big_code();
+  }
+  cdk_error_wrap(&old);
+
+  TEST_ASSERT_EQUAL(1, reader->traces[0].frames_len);
+  TEST_ASSERT_EQUAL(60000, reader->traces[0].code);
+}
+
+static int storm(void *arg) {
+  (void)arg;
+  for (int i = 0; i < 10000; i++) {
+    wrap_einval();
+  }
+  return 0;
+}
+
+void test_threads(void) {
+  thrd_t threads[4];
+
+  for (int i = 0; i < 4; i++) {
+    thrd_create(&threads[i], storm, NULL);
+  }
+  for (int i = 0; i < 4; i++) {
+    thrd_join(threads[i], NULL);
+  }
+
+  TEST_ASSERT_EQUAL(40000, reader->codes[EINVAL]);
+  TEST_ASSERT_EQUAL(40000, find_site("raise_einval")->count);
+  for (size_t i = 0; i < CDK_ESTATS_TRACES; i++) {
+    TEST_ASSERT_EQUAL(0, reader->traces[i].seq & 1);
+    TEST_ASSERT_EQUAL(2, reader->traces[i].frames_len);
+  }
+}
@@ -0,0 +1,62 @@
+#include <errno.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+// Built with -Wshadow: cdk_ebind() must not warn in user code.
+_Thread_local cdk_error_t cdk_errno CDK_ERROR_TLS = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno CDK_ERROR_TLS = {0};
+
+void setUp(void) { cdk_errno = NULL; }
+
+void tearDown(void) {}
+
+static int read_sector(void) {
+  cdk_errno = cdk_errnos(EIO, "Bad sector");
+  return -1;
+}
+
+static int read_block(void) {
+  if (read_sector()) {
+    cdk_ebind();
+    cdk_ewrap();
+    return cdk_ereturn(-1);
+  }
+  return 0;
+}
+
+static int read_bound(void) {
+  cdk_ebind();
+
+  cdk_errno = cdk_errnoi(ENOENT);
+  return cdk_ereturn(-1);
+}
+
+void test_bound_macros_use_hidden_errno(void) {
+  TEST_ASSERT_EQUAL(-1, read_block());
+
+  TEST_ASSERT_EQUAL_PTR(&cdk_hidden_errno, cdk_errno);
+  TEST_ASSERT_EQUAL(EIO, cdk_errno->code);
+  TEST_ASSERT_EQUAL(3, cdk_errno->eframes_len);
+  TEST_ASSERT_EQUAL_STRING("read_sector", cdk_errno->eframes[0].func);
+  TEST_ASSERT_EQUAL_STRING("read_block", cdk_errno->eframes[1].func);
+  TEST_ASSERT_EQUAL_STRING("read_block", cdk_errno->eframes[2].func);
+}
+
+void test_bound_raise(void) {
+  TEST_ASSERT_EQUAL(-1, read_bound());
+
+  TEST_ASSERT_EQUAL_PTR(&cdk_hidden_errno, cdk_errno);
+  TEST_ASSERT_EQUAL(ENOENT, cdk_errno->code);
+  TEST_ASSERT_EQUAL(2, cdk_errno->eframes_len);
+}
+
+void test_unbound_macros_after_bound_scope(void) {
+  read_block();
+  cdk_errno = cdk_errnoi(EINVAL);
+  cdk_ewrap();
+
+  TEST_ASSERT_EQUAL_PTR(&cdk_hidden_errno, cdk_errno);
+  TEST_ASSERT_EQUAL(EINVAL, cdk_errno->code);
+  TEST_ASSERT_EQUAL(2, cdk_errno->eframes_len);
+}
@@ -0,0 +1,122 @@
+#include <errno.h>
+#include <string.h>
+
+#include "cdk_error.h"
+#include "unity.h"
+
+_Thread_local cdk_error_t cdk_errno = NULL;
+_Thread_local struct cdk_Error cdk_hidden_errno = {0};
+
+static unsigned char buf[1024];
+
+void setUp(void) { memset(buf, 0xAA, sizeof(buf)); }
+
+void tearDown(void) {}
+
+static int raise_int_line;
+
+static int raise_int(void) {
+  raise_int_line = __LINE__ + 1;
+  cdk_errno = cdk_errnoi(ENOENT);
+  return -1;
+}
+
+static int raise_str(void) {
+  cdk_errno = cdk_errnos(EINVAL, "Bad header");
+  return -1;
+}
+
+static int wrap_times(int (*raise)(void), int times) {
+  raise();
+  for (int i = 0; i < times; i++) {
+    cdk_ewrap();
+  }
+  return -1;
+}
+
+static size_t read_varint(const unsigned char **p) {
+  size_t value = 0, shift = 0;
+
+  do {
+    value |= (size_t)(**p & 0x7f) << shift;
+    shift += 7;
+  } while (*(*p)++ & 0x80);
+
+  return value;
+}
+
+void test_int_record_layout(void) {
+  const unsigned char *p = buf + 6;
+  size_t size;
+
+  raise_int();
+  size = cdk_eencode(sizeof(buf), buf);
+
+  TEST_ASSERT_EQUAL(CDK_EWIRE_MAGIC, buf[0]);
+  TEST_ASSERT_EQUAL(CDK_EWIRE_VERSION, buf[1]);
+  TEST_ASSERT_EQUAL(size - 6, buf[2] | buf[3] << 8 | buf[4] << 16 |
+                                  (size_t)buf[5] << 24);
+
+  TEST_ASSERT_EQUAL(0, *p++);
+  TEST_ASSERT_EQUAL(ENOENT, read_varint(&p));
+  TEST_ASSERT_EQUAL(1, read_varint(&p));
+
+  // New strings: file and function, then zigzag line.
+  TEST_ASSERT_EQUAL(0, read_varint(&p));
+  TEST_ASSERT_EQUAL(strlen("test_cdk_errno_wire.c"), read_varint(&p));
+  TEST_ASSERT_EQUAL_MEMORY("test_cdk_errno_wire.c", p, 21);
+  p += 21;
+  TEST_ASSERT_EQUAL(0, read_varint(&p));
+  TEST_ASSERT_EQUAL(strlen("raise_int"), read_varint(&p));
+  p += strlen("raise_int");
+  TEST_ASSERT_EQUAL(raise_int_line * 2, read_varint(&p));
+  TEST_ASSERT_EQUAL(size, (size_t)(p - buf));
+  TEST_ASSERT_EQUAL(0xAA, buf[size]);
+}
+
+void test_message_is_carried(void) {
+  const unsigned char *p = buf + 6;
+
+  raise_str();
+  cdk_eencode(sizeof(buf), buf);
+
+  TEST_ASSERT_EQUAL(cdk_EWireFlag_MSG, *p++);
+  TEST_ASSERT_EQUAL(EINVAL, read_varint(&p));
+  TEST_ASSERT_EQUAL(strlen("Bad header"), read_varint(&p));
+  TEST_ASSERT_EQUAL_MEMORY("Bad header", p, strlen("Bad header"));
+}
+
+void test_repeated_frames_are_interned(void) {
+  size_t one, five;
+
+  wrap_times(raise_int, 1);
+  one = cdk_eencode(sizeof(buf), buf);
+  wrap_times(raise_int, 5);
+  five = cdk_eencode(sizeof(buf), buf);
+
+  // File and function repeat by table index, the line repeats as delta 0.
+  TEST_ASSERT_EQUAL(one + 4 * 3, five);
+}
+
+void test_small_buffer_reports_size(void) {
+  size_t size;
+
+  wrap_times(raise_str, 3);
+  size = cdk_eencode(sizeof(buf), buf);
+  memset(buf, 0xAA, sizeof(buf));
+  TEST_ASSERT_EQUAL(size, cdk_eencode(size / 2, buf));
+  TEST_ASSERT_EQUAL(0xAA, buf[size / 2]);
+  TEST_ASSERT_EQUAL(size, cdk_eencode(0, NULL));
+  TEST_ASSERT_EQUAL(size, cdk_eencode(size, buf));
+}
+
+void test_deferred_message_is_formatted(void) {
+  const unsigned char *p = buf + 7;
+
+  cdk_errno = cdk_errnod(EIO, "Read %d of %s", 42, "disk0");
+  cdk_eencode(sizeof(buf), buf);
+
+  TEST_ASSERT_EQUAL(EIO, read_varint(&p));
+  TEST_ASSERT_EQUAL(strlen("Read 42 of disk0"), read_varint(&p));
+  TEST_ASSERT_EQUAL_MEMORY("Read 42 of disk0", p, strlen("Read 42 of disk0"));
+}
@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+import argparse
+import errno
+import os
+import re
+import struct
+import sys
+
+MAGIC = 0xCE
+VERSION = 1
+
+# enum cdk_EWireFlag and enum cdk_EFieldType from include/cdk_error.h.
+FLAG_MSG = 1
+FLAG_OMITTED = 2
+FLAG_CAUSES = 4
+FLAG_FIELDS = 8
+FLAG_SUPPRESSED = 16
+
+FIELD_INT = 0
+FIELD_UINT = 1
+FIELD_STR = 2
+
+SEPARATOR = "------------------------\n"
+
+HEADER_PATH = os.path.join(
+    os.path.dirname(os.path.dirname(os.path.abspath(__file__))),
+    "include",
+    "cdk_error.h",
+)
+
+
+def load_descs(path):
+    """Read errno descriptions of CDK_ERRNO_LIST, the table dumps use."""
+    descs = {0: "Success"}
+    try:
+        with open(path) as fp:
+            source = fp.read()
+    except OSError:
+        return descs
+
+    for name, desc in re.findall(r'X\((E[A-Z0-9]+), "([^"]*)"\)', source):
+        code = getattr(errno, name, None)
+        if code is not None:
+            descs.setdefault(code, desc)
+    return descs
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.off = 0
+
+    def bytes(self, n):
+        if self.off + n > len(self.data):
+            raise ValueError("record is truncated")
+        out = self.data[self.off : self.off + n]
+        self.off += n
+        return out
+
+    def u8(self):
+        return self.bytes(1)[0]
+
+    def varint(self):
+        value = shift = 0
+        while True:
+            byte = self.u8()
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value
+
+    def zigzag(self):
+        value = self.varint()
+        return (value >> 1) ^ -(value & 1)
+
+    def text(self, n):
+        return self.bytes(n).decode(errors="replace")
+
+
+class Record:
+    def __init__(self, body):
+        r = Reader(body)
+        strs = []
+
+        def string():
+            ref = r.varint()
+            if ref:
+                return strs[ref - 1]
+            strs.append(r.text(r.varint()))
+            return strs[-1]
+
+        flags = r.u8()
+        self.code = r.varint()
+        self.msg = r.text(r.varint()) if flags & FLAG_MSG else None
+
+        self.depth = r.varint()
+        self.gap = self.omitted = 0
+        if flags & FLAG_OMITTED:
+            self.gap = r.varint()
+            self.omitted = r.varint()
+
+        self.frames = []
+        line = 0
+        for _ in range(self.depth - self.omitted):
+            file = string()
+            func = string()
+            line += r.zigzag()
+            self.frames.append("%s:%s:%u" % (file, func, line))
+
+        self.causes = []
+        if flags & FLAG_CAUSES:
+            for _ in range(r.varint()):
+                code = r.varint()
+                end = r.varint()
+                msg_len = r.varint()
+                msg = r.text(msg_len - 1) if msg_len else None
+                self.causes.append((code, end, msg))
+
+        self.fields = []
+        if flags & FLAG_FIELDS:
+            for _ in range(r.varint()):
+                key = string()
+                kind = r.u8()
+                if kind == FIELD_INT:
+                    value = str(r.zigzag())
+                elif kind == FIELD_UINT:
+                    value = str(r.varint())
+                elif kind == FIELD_STR:
+                    str_len = r.varint()
+                    value = r.text(str_len - 1) if str_len else "(null)"
+                else:
+                    size = r.varint()
+                    value = r.bytes(r.varint()).hex()
+                    if size > len(value) // 2:
+                        value += "..."
+                self.fields.append((key, value))
+
+        self.suppressed = r.varint() if flags & FLAG_SUPPRESSED else 0
+
+    def segment(self, i):
+        """Frame range of cause `i`, or of the error itself past the last."""
+        start = self.causes[i - 1][1] if i else 0
+        end = self.causes[i][1] if i < len(self.causes) else self.depth
+        return start, end
+
+    def render_frames(self, start, end, out):
+        gap_end = self.gap + self.omitted
+        i = start
+        while i < end:
+            if self.omitted and self.gap <= i < gap_end:
+                stop = min(end, gap_end)
+                out.append("   ... %u frames omitted\n" % (stop - i))
+                i = stop
+                continue
+            frame = self.frames[i if i < self.gap else i - self.omitted]
+            out.append("   [%02u] %s\n" % (i - start, frame))
+            i += 1
+
+    def render(self, descs):
+        # Codes of CDK_ERROR_DOMAINS carry the domain above the low 16 bits,
+        # only the errno domain has descriptions here.
+        domain, value = self.code >> 16, self.code & 0xFFFF
+        out = ["====== ERROR DUMP ======\n", "Error code: %u\n" % value]
+        if domain:
+            out.append("Error domain: %u\n" % domain)
+        out.append(
+            "Error desc: %s\n" % descs.get(self.code, "Unknown error %u" % value)
+        )
+        if self.msg is not None:
+            out.append(SEPARATOR + " Error msg: %s\n" % self.msg)
+        if self.fields:
+            out.append(SEPARATOR + " Fields:\n")
+            out.extend("   %s=%s\n" % field for field in self.fields)
+
+        out.append(SEPARATOR + " Backtrace:\n")
+        self.render_frames(*self.segment(len(self.causes)), out)
+        for i in reversed(range(len(self.causes))):
+            code, _, msg = self.causes[i]
+            out.append(
+                SEPARATOR
+                + " Caused by: %u (%s)\n"
+                % (code & 0xFFFF, descs.get(code, "Unknown error"))
+            )
+            if msg is not None:
+                out.append(" Error msg: %s\n" % msg)
+            out.append(" Backtrace:\n")
+            self.render_frames(*self.segment(i), out)
+
+        if self.suppressed:
+            out.append("Suppressed: %u traces\n" % self.suppressed)
+        return "".join(out)
+
+
+def records(data):
+    off = 0
+    while off < len(data):
+        if len(data) - off < 6:
+            raise ValueError("truncated record at offset %u" % off)
+        magic, version, length = struct.unpack_from("<BBI", data, off)
+        if magic != MAGIC:
+            raise ValueError("bad magic at offset %u" % off)
+        if version != VERSION:
+            raise ValueError("unsupported version %u at offset %u" % (version, off))
+        off += 6
+        yield Record(data[off : off + length])
+        off += length
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Decode errors encoded with cdk_error_encode into dumps."
+    )
+
+    parser.add_argument(
+        "path",
+        help="File with concatenated records, - for stdin",
+        nargs="?",
+        default="-",
+    )
+    parser.add_argument(
+        "--header",
+        help="cdk_error.h with errno descriptions",
+        default=HEADER_PATH,
+    )
+
+    args = parser.parse_args()
+
+    try:
+        if args.path == "-":
+            data = sys.stdin.buffer.read()
+        else:
+            with open(args.path, "rb") as fp:
+                data = fp.read()
+        descs = load_descs(args.header)
+        for record in records(data):
+            sys.stdout.write(record.render(descs))
+    except (OSError, ValueError, IndexError) as e:
+        print(e, file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+import argparse
+import mmap
+import os
+import struct
+import sys
+import time
+
+MAGIC = b"CDKESTAT"
+VERSION = 1
+
+# Layouts of struct cdk_EStatsHeader, cdk_EStatsFrame, cdk_EStatsSite and
+# cdk_EStatsTrace from include/cdk_error.h.
+HEADER = struct.Struct("=8sIIIIIIQQQQQQQ")
+FRAME = struct.Struct("=II32s32s")
+SITE = struct.Struct("=QQQII")
+TRACE = struct.Struct("=QQII")
+
+
+def name(raw):
+    return raw.split(b"\0", 1)[0].decode(errors="replace")
+
+
+def frame(buf, off):
+    line, _, file, func = FRAME.unpack_from(buf, off)
+    return "%s:%s:%u" % (name(file), name(func), line)
+
+
+class Stats:
+    def __init__(self, path):
+        with open(path, "rb") as fp:
+            self.buf = mmap.mmap(fp.fileno(), 0, access=mmap.ACCESS_READ)
+
+        (
+            magic,
+            version,
+            self.pid,
+            self.codes_len,
+            self.sites_len,
+            self.traces_len,
+            self.frames_len,
+            self.codes_off,
+            self.sites_off,
+            self.traces_off,
+            size,
+            *_,
+        ) = HEADER.unpack_from(self.buf, 0)
+
+        if magic != MAGIC:
+            raise ValueError("%s is not a cdk_error stats file" % path)
+        if version != VERSION:
+            raise ValueError("unsupported stats version %u" % version)
+        if size > len(self.buf):
+            raise ValueError("%s is truncated" % path)
+
+        self.site_size = SITE.size + FRAME.size
+        self.trace_size = TRACE.size + FRAME.size * self.frames_len
+
+    def totals(self):
+        return HEADER.unpack_from(self.buf, 0)[11:]
+
+    def codes(self):
+        return struct.unpack_from("=%uQ" % self.codes_len, self.buf, self.codes_off)
+
+    def sites(self):
+        """Return (count, code, origin) of every published site."""
+        out = []
+        for i in range(self.sites_len):
+            off = self.sites_off + i * self.site_size
+            for _ in range(8):
+                seq, key, count, code, _ = SITE.unpack_from(self.buf, off)
+                if not key or seq & 1:
+                    break
+                origin = frame(self.buf, off + SITE.size)
+                if struct.unpack_from("=Q", self.buf, off)[0] == seq:
+                    out.append((count, code, origin))
+                    break
+        return out
+
+    def traces(self):
+        """Return (index, timestamp, code, frames) of readable traces."""
+        out = []
+        for i in range(self.traces_len):
+            off = self.traces_off + i * self.trace_size
+            seq, timestamp, code, frames_len = TRACE.unpack_from(self.buf, off)
+            if not seq or seq & 1:
+                continue
+            frames = [
+                frame(self.buf, off + TRACE.size + f * FRAME.size)
+                for f in range(min(frames_len, self.frames_len))
+            ]
+            if struct.unpack_from("=Q", self.buf, off)[0] == seq:
+                out.append((seq // 2 - 1, timestamp, code, frames))
+        out.sort(reverse=True)
+        return out
+
+
+def code_name(code):
+    if code >> 16:
+        # Code of an error domain, see CDK_ECODE.
+        return "domain 0x%04x code %u" % (code >> 16, code & 0xFFFF)
+    try:
+        return os.strerror(code) if code < 4096 else str(code)
+    except ValueError:
+        return str(code)
+
+
+def render(stats, prev, interval, args):
+    other_codes, sites_full, traces_head = stats.totals()
+    codes = stats.codes()
+    raised = sum(codes) + other_codes
+    sites = stats.sites()
+    lines = []
+
+    lines.append(
+        "pid %u  raised %u  other codes %u  sites full %u"
+        % (stats.pid, raised, other_codes, sites_full)
+    )
+    top_codes = sorted(
+        ((count, code) for code, count in enumerate(codes) if count),
+        reverse=True,
+    )
+    lines.append(
+        "top codes: "
+        + ", ".join("%s %u" % (code_name(code), count) for count, code in top_codes[:5])
+    )
+    lines.append("")
+    lines.append("%10s %10s  %-24s %s" % ("COUNT", "RATE/s", "LAST CODE", "ORIGIN"))
+
+    sites.sort(reverse=True)
+    for count, code, origin in sites[: args.sites]:
+        rate = (count - prev.get(origin, count)) / interval if interval else 0
+        lines.append(
+            "%10u %10.0f  %-24s %s" % (count, rate, code_name(code)[:24], origin)
+        )
+        prev[origin] = count
+
+    lines.append("")
+    lines.append("Recent traces:")
+    now = time.time_ns()
+    for index, timestamp, code, frames in stats.traces()[: args.traces]:
+        age = (now - timestamp) / 1e9 if timestamp else 0
+        name = code_name(code) if code >> 16 else "%u (%s)" % (code, code_name(code))
+        lines.append("  #%u  %.1fs ago  %s" % (index, age, name))
+        for i, f in enumerate(frames):
+            lines.append("    [%02u] %s" % (i, f))
+
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Show top error sites and recent traces of a running process."
+    )
+
+    parser.add_argument(
+        "path",
+        help="Stats file created with cdk_estats_open",
+    )
+    parser.add_argument(
+        "-d",
+        "--delay",
+        help="Refresh interval in seconds",
+        type=float,
+        default=1.0,
+    )
+    parser.add_argument(
+        "-n",
+        "--sites",
+        help="Number of error sites to show",
+        type=int,
+        default=20,
+    )
+    parser.add_argument(
+        "-t",
+        "--traces",
+        help="Number of recent traces to show",
+        type=int,
+        default=5,
+    )
+    parser.add_argument(
+        "--once",
+        help="Print once and exit",
+        action="store_true",
+    )
+
+    args = parser.parse_args()
+
+    try:
+        stats = Stats(args.path)
+    except (OSError, ValueError) as e:
+        print(e, file=sys.stderr)
+        sys.exit(1)
+
+    prev = {}
+    if args.once:
+        print(render(stats, prev, 0, args))
+        return
+
+    try:
+        interval = 0
+        while True:
+            out = render(stats, prev, interval, args)
+            sys.stdout.write("\033[H\033[2J" + out + "\n")
+            sys.stdout.flush()
+            time.sleep(args.delay)
+            interval = args.delay
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+import argparse
+import re
+import subprocess
+import sys
+
+# GCC splits functions into the hot body and `<name>.cold` parts placed in
+# .text.unlikely, clang uses `<name>.cold.<n>`.
+COLD = re.compile(r"^(?P<name>.+?)\.cold(\.\d+)?$")
+TEXT = "tTwW"
+
+
+def symbols(path, nm):
+    """Return {function: [hot, cold]} sizes of functions defined in `path`."""
+    out = subprocess.run(
+        [nm, "-S", "--defined-only", path],
+        check=True,
+        capture_output=True,
+        text=True,
+    ).stdout
+    funcs = {}
+
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) != 4 or parts[2] not in TEXT:
+            continue
+        size, name = int(parts[1], 16), parts[3]
+        m = COLD.match(name)
+        if m:
+            funcs.setdefault(m.group("name"), [0, 0])[1] += size
+        else:
+            funcs.setdefault(name, [0, 0])[0] += size
+
+    return funcs
+
+
+def sections(path, size):
+    """Return {section: size} of text sections, split only in objects."""
+    out = subprocess.run(
+        [size, "-A", path], check=True, capture_output=True, text=True
+    ).stdout
+    result = {}
+
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[0].startswith(".text"):
+            section = ".text.unlikely" if "unlikely" in parts[0] else ".text"
+            result[section] = result.get(section, 0) + int(parts[1])
+
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compare hot and cold (outlined) code size of functions."
+    )
+
+    parser.add_argument(
+        "files",
+        help="Object files or executables, compared side by side",
+        nargs="+",
+    )
+    parser.add_argument(
+        "-f",
+        "--filter",
+        help="Only show functions matching this regex",
+        default=None,
+    )
+    parser.add_argument(
+        "--nm",
+        help="nm executable",
+        default="nm",
+    )
+    parser.add_argument(
+        "--size",
+        help="size executable",
+        default="size",
+    )
+
+    args = parser.parse_args()
+
+    try:
+        reports = [symbols(f, args.nm) for f in args.files]
+        totals = [sections(f, args.size) for f in args.files]
+    except (OSError, subprocess.CalledProcessError) as e:
+        print(e, file=sys.stderr)
+        sys.exit(1)
+
+    names = sorted(set().union(*reports))
+    if args.filter:
+        names = [n for n in names if re.search(args.filter, n)]
+
+    print("\n".join("#%u %s" % (i, f) for i, f in enumerate(args.files)))
+
+    width = max([len(n) for n in names] + [20])
+    header = "%-*s" % (width, "FUNCTION")
+    for i in range(len(args.files)):
+        header += " | %8s %8s" % ("#%u HOT" % i, "COLD")
+    print(header)
+
+    for name in names:
+        line = "%-*s" % (width, name)
+        for report in reports:
+            hot, cold = report.get(name, [0, 0])
+            line += " | %8u %8u" % (hot, cold)
+        print(line)
+
+    line = "%-*s" % (width, "TOTAL")
+    for report in reports:
+        hot = sum(r[0] for n, r in report.items() if n in names)
+        cold = sum(r[1] for n, r in report.items() if n in names)
+        line += " | %8u %8u" % (hot, cold)
+    print(line)
+
+    line = "%-*s" % (width, ".text/.text.unlikely")
+    for total in totals:
+        line += " | %8u %8u" % (total.get(".text", 0), total.get(".text.unlikely", 0))
+    print(line)
+
+
+if __name__ == "__main__":
+    main()